@@ -0,0 +1,131 @@
+#ifndef MODEL_LOAD_ARENA_H
+#define MODEL_LOAD_ARENA_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// monotonic bump allocator. memory is only given back by reset() or rewind(), blocks are kept for reuse.
+class Arena {
+public:
+  struct Marker {
+    size_t block;
+    size_t offset;
+  };
+
+  explicit Arena(size_t block_size = 1 << 20)
+    : blocks(), block_size(block_size), current(0), offset(0), allocations(0), system_allocations(0) {}
+  ~Arena() {
+    for (auto& b : blocks) {
+      std::free(b.data);
+    }
+  }
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* allocate(size_t size, size_t align) {
+    allocations++;
+    while (current < blocks.size()) {
+      Block& b = blocks[current];
+      size_t aligned = (offset + align - 1) & ~(align - 1);
+      if (aligned + size <= b.size) {
+        offset = aligned + size;
+        return b.data + aligned;
+      }
+      current++;
+      offset = 0;
+    }
+
+    // no reusable block is large enough, grab a new one
+    Block b;
+    b.size = size + align > block_size ? size + align : block_size;
+    b.data = static_cast<char*>(std::malloc(b.size));
+    if (!b.data) {
+      throw std::bad_alloc();
+    }
+    system_allocations++;
+    blocks.push_back(b);
+    current = blocks.size() - 1;
+    size_t aligned = (reinterpret_cast<size_t>(b.data) + align - 1) & ~(align - 1);
+    offset = aligned - reinterpret_cast<size_t>(b.data) + size;
+    return b.data + (offset - size);
+  }
+
+  Marker mark() const { return {current, offset}; }
+  void rewind(const Marker& m) { current = m.block; offset = m.offset; }
+  void reset() { current = 0; offset = 0; }
+
+  size_t capacity() const {
+    size_t total = 0;
+    for (auto& b : blocks) total += b.size;
+    return total;
+  }
+  size_t allocation_count() const { return allocations; }
+  size_t system_allocation_count() const { return system_allocations; }
+
+private:
+  struct Block {
+    char* data;
+    size_t size;
+  };
+
+  std::vector<Block> blocks;
+  size_t block_size;
+  size_t current;
+  size_t offset;
+  size_t allocations;
+  size_t system_allocations;
+};
+
+// rewinds the arena to where it was when the scope was entered
+class ArenaScope {
+public:
+  explicit ArenaScope(Arena* arena) : arena(arena), marker() {
+    if (arena) marker = arena->mark();
+  }
+  ~ArenaScope() {
+    if (arena) arena->rewind(marker);
+  }
+  ArenaScope(const ArenaScope&) = delete;
+  ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+  Arena* arena;
+  Arena::Marker marker;
+};
+
+// stl allocator over an Arena. without an arena it falls back to the global heap,
+// so containers using it behave like plain std containers by default.
+template <typename T>
+struct ArenaAllocator {
+  typedef T value_type;
+
+  ArenaAllocator() noexcept : arena(nullptr) {}
+  explicit ArenaAllocator(Arena* arena) noexcept : arena(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+  T* allocate(size_t n) {
+    if (arena) {
+      return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t) noexcept {
+    if (!arena) {
+      ::operator delete(p);
+    }
+  }
+
+  Arena* arena;
+};
+
+template <typename T, typename U>
+inline bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena == b.arena; }
+
+template <typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena != b.arena; }
+
+#endif //MODEL_LOAD_ARENA_H
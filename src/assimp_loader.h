@@ -5,20 +5,69 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include "common.h"
+#include "thread_pool.h"
 
-bool load_model(const std::string& filename, std::vector<mesh*>& out_mesh);
+const unsigned int default_post_process = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+Assimp::Importer& thread_importer();
+bool load_model(const std::string& filename, std::vector<mesh*>& out_mesh, unsigned int post_process = default_post_process);
 void process_node(aiNode* node, const aiScene* scene, std::vector<mesh*>& meshes);
 mesh* process_mesh(aiMesh* ai_mesh, const aiScene* scene);
 std::vector<texture> load_texture(aiMaterial *mat, aiTextureType type, const std::string& typeName);
 
-bool load_model(const std::string& filename, std::vector<mesh*>& out_mesh) {
-  Assimp::Importer importer;
-  const aiScene* scene = importer.ReadFile(filename, aiProcess_Triangulate | aiProcess_FlipUVs);
+// one aiMesh reference inside a flat_model. indices already point into flat_model::vertices.
+struct flat_mesh_range {
+  std::string name;
+  uint32_t vertex_offset;
+  uint32_t vertex_count;
+  uint32_t index_offset;
+  uint32_t index_count;
+  uint32_t material_index;
+};
+
+// whole scene in two contiguous arrays, owned by value
+struct flat_model {
+  std::vector<vertex> vertices;
+  std::vector<uint32_t> indices;
+  std::vector<flat_mesh_range> meshes;
+  std::vector<std::vector<texture>> material_textures; // indexed by flat_mesh_range::material_index
+};
+
+bool load_model_flat(const std::string& filename, flat_model& out, unsigned int post_process = default_post_process);
+
+// a node reference to a shared mesh, placed in world space
+struct flat_instance {
+  uint32_t mesh; // index into flat_scene::model.meshes
+  mat4 world;
+  std::string node_name;
+};
+
+// every aiMesh converted once, plus one instance per node reference
+struct flat_scene {
+  flat_model model;
+  std::vector<flat_instance> instances;
+  float read_ms; // assimp ReadFile including post processing
+  float convert_ms; // our flattening and copy
+};
+
+bool load_scene_flat(const std::string& filename, flat_scene& out, ThreadPool& pool, unsigned int post_process = default_post_process);
+
+// one importer per thread, kept alive across loads so its setup cost is paid once per batch
+Assimp::Importer& thread_importer() {
+  static thread_local Assimp::Importer importer;
+  return importer;
+}
+
+bool load_model(const std::string& filename, std::vector<mesh*>& out_mesh, unsigned int post_process) {
+  Assimp::Importer& importer = thread_importer();
+  const aiScene* scene = importer.ReadFile(filename, post_process);
 
   if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+    importer.FreeScene();
     return false;
   }
   process_node(scene->mRootNode, scene, out_mesh);
+  importer.FreeScene();
   return true;
 }
 
@@ -67,7 +116,7 @@ mesh* process_mesh(aiMesh* ai_mesh, const aiScene* scene) {
   }
 
   // process indices
-  new_mesh->indices.reserve(ai_mesh->mNumFaces);
+  new_mesh->indices.reserve(ai_mesh->mNumFaces * 3);
   for (int i = 0; i < ai_mesh->mNumFaces; i++) {
     aiFace face = ai_mesh->mFaces[i];
     for (int j = 0; j < face.mNumIndices; j++) {
@@ -102,4 +151,199 @@ std::vector<texture> load_texture(aiMaterial *mat, aiTextureType type, const std
   return textures;
 }
 
+void collect_meshes(const aiNode* node, std::vector<unsigned int>& mesh_refs) {
+  // same order as process_node, without recursion
+  std::vector<const aiNode*> stack(1, node);
+  while (!stack.empty()) {
+    const aiNode* n = stack.back();
+    stack.pop_back();
+    mesh_refs.insert(mesh_refs.end(), n->mMeshes, n->mMeshes + n->mNumMeshes);
+    for (unsigned int i = n->mNumChildren; i > 0; i--) {
+      stack.push_back(n->mChildren[i - 1]);
+    }
+  }
+}
+
+void copy_mesh_flat(const aiMesh* ai_mesh, vertex* dst_vertices, uint32_t* dst_indices, uint32_t base_vertex) {
+  const unsigned int count = ai_mesh->mNumVertices;
+
+  // one tight loop per attribute stream, the presence checks are hoisted out
+  const aiVector3D* positions = ai_mesh->mVertices;
+  for (unsigned int i = 0; i < count; i++) {
+    dst_vertices[i].pos = vec3(positions[i].x, positions[i].y, positions[i].z);
+  }
+  if (ai_mesh->mNormals) {
+    const aiVector3D* normals = ai_mesh->mNormals;
+    for (unsigned int i = 0; i < count; i++) {
+      dst_vertices[i].normal = vec3(normals[i].x, normals[i].y, normals[i].z);
+    }
+  }
+  if (ai_mesh->mTextureCoords[0]) {
+    const aiVector3D* uvs = ai_mesh->mTextureCoords[0];
+    for (unsigned int i = 0; i < count; i++) {
+      dst_vertices[i].tex_coords = vec2(uvs[i].x, uvs[i].y);
+    }
+  }
+
+  const aiFace* faces = ai_mesh->mFaces;
+  if (ai_mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
+    for (unsigned int i = 0; i < ai_mesh->mNumFaces; i++) {
+      const unsigned int* idx = faces[i].mIndices;
+      dst_indices[i * 3 + 0] = base_vertex + idx[0];
+      dst_indices[i * 3 + 1] = base_vertex + idx[1];
+      dst_indices[i * 3 + 2] = base_vertex + idx[2];
+    }
+  } else {
+    for (unsigned int i = 0; i < ai_mesh->mNumFaces; i++) {
+      for (unsigned int j = 0; j < faces[i].mNumIndices; j++) {
+        *dst_indices++ = base_vertex + faces[i].mIndices[j];
+      }
+    }
+  }
+}
+
+uint32_t count_mesh_indices(const aiMesh* ai_mesh) {
+  if (ai_mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
+    return ai_mesh->mNumFaces * 3;
+  }
+  uint32_t count = 0;
+  for (unsigned int i = 0; i < ai_mesh->mNumFaces; i++) {
+    count += ai_mesh->mFaces[i].mNumIndices;
+  }
+  return count;
+}
+
+void load_material_textures(const aiScene* scene, flat_model& out) {
+  out.material_textures.resize(scene->mNumMaterials);
+  for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+    std::vector<texture>& textures = out.material_textures[i];
+    textures = load_texture(scene->mMaterials[i], aiTextureType_DIFFUSE, "texture_diffuse");
+    std::vector<texture> specular_maps = load_texture(scene->mMaterials[i], aiTextureType_SPECULAR, "texture_specular");
+    textures.insert(textures.end(), specular_maps.begin(), specular_maps.end());
+  }
+}
+
+// flat variant of load_model: sizes one vertex and one index array for the whole scene from the
+// aiMesh counts, then bulk copies every stream. nothing is heap allocated per mesh.
+bool load_model_flat(const std::string& filename, flat_model& out, unsigned int post_process) {
+  Assimp::Importer& importer = thread_importer();
+  const aiScene* scene = importer.ReadFile(filename, post_process);
+
+  if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+    importer.FreeScene();
+    return false;
+  }
+
+  std::vector<unsigned int> mesh_refs;
+  collect_meshes(scene->mRootNode, mesh_refs);
+
+  out.meshes.resize(mesh_refs.size());
+  size_t vertex_total = 0, index_total = 0;
+  for (size_t i = 0; i < mesh_refs.size(); i++) {
+    const aiMesh* ai_mesh = scene->mMeshes[mesh_refs[i]];
+    flat_mesh_range& range = out.meshes[i];
+    range.name = ai_mesh->mName.C_Str();
+    range.vertex_offset = static_cast<uint32_t>(vertex_total);
+    range.vertex_count = ai_mesh->mNumVertices;
+    range.index_offset = static_cast<uint32_t>(index_total);
+    range.index_count = count_mesh_indices(ai_mesh);
+    range.material_index = ai_mesh->mMaterialIndex;
+    vertex_total += range.vertex_count;
+    index_total += range.index_count;
+  }
+
+  out.vertices.clear();
+  out.vertices.resize(vertex_total);
+  out.indices.resize(index_total);
+  for (size_t i = 0; i < mesh_refs.size(); i++) {
+    const flat_mesh_range& range = out.meshes[i];
+    copy_mesh_flat(scene->mMeshes[mesh_refs[i]], out.vertices.data() + range.vertex_offset,
+                   out.indices.data() + range.index_offset, range.vertex_offset);
+  }
+
+  load_material_textures(scene, out);
+
+  importer.FreeScene();
+  return true;
+}
+
+mat4 to_mat4(const aiMatrix4x4& t) {
+  // aiMatrix4x4 is row major with the translation in a4, b4, c4
+  mat4 r;
+  r.m[0] = t.a1; r.m[4] = t.a2; r.m[8] = t.a3; r.m[12] = t.a4;
+  r.m[1] = t.b1; r.m[5] = t.b2; r.m[9] = t.b3; r.m[13] = t.b4;
+  r.m[2] = t.c1; r.m[6] = t.c2; r.m[10] = t.c3; r.m[14] = t.c4;
+  r.m[3] = t.d1; r.m[7] = t.d2; r.m[11] = t.d3; r.m[15] = t.d4;
+  return r;
+}
+
+// Flattens the node graph into world space instances that share mesh data, and converts the
+// meshes in parallel on the pool. ReadFile and conversion are timed separately.
+bool load_scene_flat(const std::string& filename, flat_scene& out, ThreadPool& pool, unsigned int post_process) {
+  StopWatch watch;
+  watch.start();
+  Assimp::Importer& importer = thread_importer();
+  const aiScene* scene = importer.ReadFile(filename, post_process);
+  watch.stop();
+  out.read_ms = watch.milli();
+
+  if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+    importer.FreeScene();
+    return false;
+  }
+
+  watch.start();
+  // world matrices, parents before children
+  out.instances.clear();
+  std::vector<std::pair<const aiNode*, mat4>> stack(1, std::make_pair(scene->mRootNode, to_mat4(scene->mRootNode->mTransformation)));
+  while (!stack.empty()) {
+    const aiNode* node = stack.back().first;
+    mat4 world = stack.back().second;
+    stack.pop_back();
+    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+      flat_instance instance;
+      instance.mesh = node->mMeshes[i];
+      instance.world = world;
+      instance.node_name = node->mName.C_Str();
+      out.instances.emplace_back(std::move(instance));
+    }
+    for (unsigned int i = node->mNumChildren; i > 0; i--) {
+      const aiNode* child = node->mChildren[i - 1];
+      stack.emplace_back(child, world * to_mat4(child->mTransformation));
+    }
+  }
+
+  // offsets are a cheap serial prefix sum, the copies run in parallel
+  flat_model& model = out.model;
+  model.meshes.resize(scene->mNumMeshes);
+  size_t vertex_total = 0, index_total = 0;
+  for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+    const aiMesh* ai_mesh = scene->mMeshes[i];
+    flat_mesh_range& range = model.meshes[i];
+    range.name = ai_mesh->mName.C_Str();
+    range.vertex_offset = static_cast<uint32_t>(vertex_total);
+    range.vertex_count = ai_mesh->mNumVertices;
+    range.index_offset = static_cast<uint32_t>(index_total);
+    range.index_count = count_mesh_indices(ai_mesh);
+    range.material_index = ai_mesh->mMaterialIndex;
+    vertex_total += range.vertex_count;
+    index_total += range.index_count;
+  }
+  model.vertices.clear();
+  model.vertices.resize(vertex_total);
+  model.indices.resize(index_total);
+  pool.parallel_for(scene->mNumMeshes, [&model, scene](size_t i) {
+    const flat_mesh_range& range = model.meshes[i];
+    copy_mesh_flat(scene->mMeshes[i], model.vertices.data() + range.vertex_offset,
+                   model.indices.data() + range.index_offset, range.vertex_offset);
+  });
+
+  load_material_textures(scene, model);
+  watch.stop();
+  out.convert_ms = watch.milli();
+
+  importer.FreeScene();
+  return true;
+}
+
 #endif //MODEL_LOAD_ASSIMP_LOADER_H
@@ -0,0 +1,428 @@
+#ifndef MODEL_LOAD_BATCH_READER_H
+#define MODEL_LOAD_BATCH_READER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include "obj_loader.h"
+#include "thread_pool.h"
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+#ifdef OBJ_LOADER_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+namespace obj_loader {
+  enum class IoBackend {
+    AUTO,     // io_uring when built with OBJ_LOADER_IO_URING and the kernel allows it, pread otherwise
+    IO_URING, // same as AUTO, the reads fall back to pread when the ring cannot be set up
+    PREAD,    // one blocking open/pread per file on the pool workers
+  };
+
+#ifdef OBJ_LOADER_IO_URING
+  // Minimal io_uring over the raw syscalls, so there is no liburing dependency. Reads land in a pool of
+  // registered buffers (IORING_OP_READ_FIXED) and are copied out as they complete; if registering fails,
+  // e.g. under a low RLIMIT_MEMLOCK, the same buffers are used with plain reads.
+  class UringReader {
+  public:
+    explicit UringReader(unsigned int depth = 32, size_t chunk_size = 128 * 1024)
+      : ring_fd(-1), sq_ptr(nullptr), cq_ptr(nullptr), sq_size(0), cq_size(0), sqes(nullptr), sqe_count(0),
+        sq_head(nullptr), sq_tail(nullptr), sq_mask(nullptr), sq_array(nullptr), cq_head(nullptr), cq_tail(nullptr), cq_mask(nullptr),
+        cqes(nullptr), buffers(), chunk_size(chunk_size), fixed(false) {
+      io_uring_params params;
+      memset(&params, 0, sizeof(params));
+      ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+      if (ring_fd < 0) {
+        return;
+      }
+      sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+      cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+      const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+      if (single_mmap) {
+        sq_size = cq_size = std::max(sq_size, cq_size);
+      }
+      sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+      cq_ptr = single_mmap ? sq_ptr : mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+      sqe_count = params.sq_entries;
+      void* sqe_ptr = mmap(nullptr, sqe_count * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+      if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqe_ptr == MAP_FAILED) {
+        if (sqe_ptr != MAP_FAILED) munmap(sqe_ptr, sqe_count * sizeof(io_uring_sqe));
+        sqe_count = 0;
+        release();
+        return;
+      }
+      sqes = static_cast<io_uring_sqe*>(sqe_ptr);
+      char* sq = static_cast<char*>(sq_ptr);
+      char* cq = static_cast<char*>(cq_ptr);
+      sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+      sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+      sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+      sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+      cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+      cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+      cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+      cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+      // one block, left uninitialized: registering pins it anyway
+      buffers.reset(new char[sqe_count * chunk_size]);
+      std::vector<iovec> iov(sqe_count);
+      for (size_t i = 0; i < iov.size(); i++) {
+        iov[i].iov_base = buffer(static_cast<unsigned>(i));
+        iov[i].iov_len = chunk_size;
+      }
+      fixed = syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, iov.data(), static_cast<unsigned>(iov.size())) == 0;
+    }
+
+    ~UringReader() { release(); }
+
+    UringReader(const UringReader&) = delete;
+    UringReader& operator=(const UringReader&) = delete;
+
+    bool is_open() const { return sqes != nullptr; }
+    bool registered() const { return fixed; }
+
+    // reads every path into files, paths that fail to open or read are left out. opens go through the ring too.
+    bool read(const std::vector<std::string>& paths, PreloadedFiles& files) {
+      if (!is_open()) {
+        return false;
+      }
+      std::vector<int> fds(paths.size(), -1);
+      bool ok = openAll(paths, fds);
+
+      // one request per chunk of every file, issued as buffers free up
+      struct Chunk {
+        size_t file;
+        size_t offset;
+        size_t length;
+      };
+      std::deque<Chunk> pending;
+      std::vector<std::vector<char>*> targets(paths.size(), nullptr);
+      std::vector<char> failed(paths.size(), 0);
+      for (size_t i = 0; i < paths.size(); i++) {
+        struct stat st;
+        if (fds[i] < 0 || fstat(fds[i], &st) != 0) {
+          failed[i] = 1;
+          continue;
+        }
+        std::vector<char>& data = files[paths[i]];
+        data.resize(static_cast<size_t>(st.st_size));
+        targets[i] = &data;
+        for (size_t offset = 0; offset < data.size(); offset += chunk_size) {
+          Chunk chunk = {i, offset, std::min(chunk_size, data.size() - offset)};
+          pending.push_back(chunk);
+        }
+      }
+
+      std::vector<Chunk> in_flight(sqe_count);
+      std::vector<unsigned> free_slots;
+      for (unsigned i = 0; i < sqe_count; i++) free_slots.push_back(i);
+      size_t active = 0;
+      while (!pending.empty() || active > 0) {
+        unsigned queued = 0;
+        while (!pending.empty() && !free_slots.empty()) {
+          unsigned slot = free_slots.back();
+          free_slots.pop_back();
+          Chunk chunk = pending.front();
+          pending.pop_front();
+          in_flight[slot] = chunk;
+          io_uring_sqe* sqe = nextSqe();
+          sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+          sqe->fd = fds[chunk.file];
+          sqe->addr = reinterpret_cast<uint64_t>(buffer(slot));
+          sqe->len = static_cast<uint32_t>(chunk.length);
+          sqe->off = chunk.offset;
+          sqe->buf_index = fixed ? static_cast<uint16_t>(slot) : 0;
+          sqe->user_data = slot;
+          queued++;
+        }
+        active += queued;
+        if (!enter(queued, 1)) {
+          ok = false;
+          break;
+        }
+        reap([&](uint64_t user_data, int res) {
+          unsigned slot = static_cast<unsigned>(user_data);
+          const Chunk& chunk = in_flight[slot];
+          if (res > 0 && targets[chunk.file]) {
+            memcpy(targets[chunk.file]->data() + chunk.offset, buffer(slot), static_cast<size_t>(res));
+            if (static_cast<size_t>(res) < chunk.length) {
+              // short read, ask again for the rest
+              Chunk rest = {chunk.file, chunk.offset + res, chunk.length - res};
+              pending.push_front(rest);
+            }
+          } else if (res != -EAGAIN && res != -EINTR) {
+            failed[chunk.file] = 1; // error, or the file shrank while reading
+          } else {
+            pending.push_front(chunk);
+          }
+          free_slots.push_back(slot);
+          active--;
+        });
+      }
+
+      for (size_t i = 0; i < paths.size(); i++) {
+        if (fds[i] >= 0) close(fds[i]);
+        if (failed[i]) {
+          files.erase(paths[i]);
+        }
+      }
+      return ok;
+    }
+
+  private:
+    char* buffer(unsigned slot) const { return buffers.get() + slot * chunk_size; }
+
+    // IORING_OP_OPENAT for every path, a kernel without it (before 5.6) falls back to open(2)
+    bool openAll(const std::vector<std::string>& paths, std::vector<int>& fds) {
+      size_t next = 0;
+      size_t active = 0;
+      while (next < paths.size() || active > 0) {
+        unsigned queued = 0;
+        while (next < paths.size() && active + queued < sqe_count) {
+          io_uring_sqe* sqe = nextSqe();
+          sqe->opcode = IORING_OP_OPENAT;
+          sqe->fd = AT_FDCWD;
+          sqe->addr = reinterpret_cast<uint64_t>(paths[next].c_str());
+          sqe->open_flags = O_RDONLY | O_CLOEXEC;
+          sqe->user_data = next;
+          next++;
+          queued++;
+        }
+        active += queued;
+        if (!enter(queued, 1)) {
+          return false;
+        }
+        reap([&](uint64_t user_data, int res) {
+          size_t i = static_cast<size_t>(user_data);
+          fds[i] = res >= 0 ? res : (res == -EINVAL || res == -EOPNOTSUPP ? ::open(paths[i].c_str(), O_RDONLY | O_CLOEXEC) : -1);
+          active--;
+        });
+      }
+      return true;
+    }
+
+    io_uring_sqe* nextSqe() {
+      unsigned tail = *sq_tail; // only this thread writes the tail
+      unsigned index = tail & *sq_mask;
+      io_uring_sqe* sqe = &sqes[index];
+      memset(sqe, 0, sizeof(*sqe));
+      sq_array[index] = index;
+      __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+      return sqe;
+    }
+
+    bool enter(unsigned submit, unsigned wait) {
+      for (;;) {
+        long ret = syscall(__NR_io_uring_enter, ring_fd, submit, wait, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret >= 0) return true;
+        if (errno != EINTR) return false;
+      }
+    }
+
+    template <typename F>
+    void reap(const F& fn) {
+      unsigned head = *cq_head;
+      while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+        const io_uring_cqe& cqe = cqes[head & *cq_mask];
+        fn(cqe.user_data, cqe.res);
+        head++;
+      }
+      __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    void release() {
+      if (fixed) {
+        syscall(__NR_io_uring_register, ring_fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+        fixed = false;
+      }
+      if (sqes) munmap(sqes, sqe_count * sizeof(io_uring_sqe));
+      if (cq_ptr && cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+      if (sq_ptr && sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_size);
+      if (ring_fd >= 0) close(ring_fd);
+      sqes = nullptr;
+      sq_ptr = cq_ptr = nullptr;
+      ring_fd = -1;
+    }
+
+    int ring_fd;
+    void* sq_ptr;
+    void* cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    io_uring_sqe* sqes;
+    unsigned sqe_count;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    io_uring_cqe* cqes;
+    std::unique_ptr<char[]> buffers; // one chunk per submission queue entry, so a free slot always has an sqe
+    size_t chunk_size;
+    bool fixed;
+  };
+#endif
+
+  // whole file with blocking reads, on whichever thread calls it
+  inline bool readWholeFile(const std::string& path, std::vector<char>& data) {
+#ifdef __linux__
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      return false;
+    }
+    data.resize(static_cast<size_t>(st.st_size));
+    size_t done = 0;
+    while (done < data.size()) {
+      ssize_t n = pread(fd, data.data() + done, data.size() - done, static_cast<off_t>(done));
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      done += static_cast<size_t>(n);
+    }
+    close(fd);
+    return done == data.size();
+#else
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) {
+      return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    return true;
+#endif
+  }
+
+  // Reads batches of whole files. The ring (and its pinned buffers) is set up once per reader,
+  // so keep one around for a loading session rather than one per batch.
+  class BatchReader {
+  public:
+    explicit BatchReader(ThreadPool* pool = nullptr, IoBackend backend = IoBackend::AUTO) : pool(pool), mode(IoBackend::PREAD) {
+#ifdef OBJ_LOADER_IO_URING
+      if (backend != IoBackend::PREAD) {
+        ring.reset(new UringReader());
+        if (ring->is_open()) {
+          mode = IoBackend::IO_URING;
+        } else {
+          ring.reset();
+        }
+      }
+#else
+      (void)backend;
+#endif
+    }
+
+    // IO_URING or PREAD, whichever this reader ended up with
+    IoBackend backend() const { return mode; }
+
+    // reads every path into files, paths that fail are left out
+    void read(const std::vector<std::string>& paths, PreloadedFiles& files) {
+      OBJ_LOADER_TRACE_SCOPE("batch read");
+#ifdef OBJ_LOADER_IO_URING
+      if (ring && ring->read(paths, files)) {
+        return;
+      }
+      // the ring gave up mid batch: drop whatever it filled, a path the fallback cannot read must not stay half read
+      for (const std::string& path : paths) {
+        files.erase(path);
+      }
+#endif
+      std::vector<std::vector<char>> data(paths.size());
+      std::vector<char> ok(paths.size(), 0);
+      auto read_one = [&](size_t i) { ok[i] = readWholeFile(paths[i], data[i]); };
+      if (pool) {
+        pool->parallel_for(paths.size(), read_one);
+      } else {
+        for (size_t i = 0; i < paths.size(); i++) read_one(i);
+      }
+      for (size_t i = 0; i < paths.size(); i++) {
+        if (ok[i]) files[paths[i]].swap(data[i]);
+      }
+    }
+
+  private:
+    ThreadPool* pool;
+    IoBackend mode;
+#ifdef OBJ_LOADER_IO_URING
+    std::unique_ptr<UringReader> ring;
+#endif
+  };
+
+  // mtl paths named by the `mtllib` statements of an obj in memory, resolved the way loadObj does
+  inline void mtlLibraries(const std::vector<char>& obj, const std::string& base_dir, std::vector<std::string>& paths) {
+    const char* p = obj.data();
+    const char* end = p + obj.size();
+    std::string line;
+    while (p < end) {
+      const char* nl = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+      const char* line_end = nl ? nl : end;
+      const char* token = p;
+      while (token < line_end && is_space(*token)) token++;
+      if (line_end - token > 7 && 0 == strncmp(token, "mtllib", 6) && is_space(token[6])) {
+        line.assign(token + 7, line_end);
+        const char* t = line.c_str();
+        std::vector<std::string> names;
+        split(names, " ", &t);
+        for (const std::string& name : names) {
+          std::string path = base_dir + name;
+          if (std::find(paths.begin(), paths.end(), path) == paths.end()) paths.emplace_back(path);
+        }
+      }
+      p = line_end + 1;
+    }
+  }
+
+  // Loads a batch of obj files: all obj bytes are read first in one batch, then the mtl files their
+  // mtllib statements name in a second, and only then is everything parsed from memory (on the pool).
+  // loaded[i] tells whether paths[i] made it into scenes[i]. returns true when every file loaded.
+  // compressed files are not read ahead, they keep streaming through the decoder thread.
+  inline bool loadObjBatch(const std::vector<std::string>& paths, std::vector<Scene>& scenes, std::vector<bool>& loaded,
+                           ParseOption parse_option, BatchReader& reader, ThreadPool* pool = nullptr) {
+    std::vector<std::string> plain;
+    for (const std::string& path : paths) {
+      if (compressionOf(path) == Compression::NONE) plain.emplace_back(path);
+    }
+    PreloadedFiles files;
+    reader.read(plain, files);
+
+    std::vector<std::string> libraries;
+    for (const std::string& path : plain) {
+      auto it = files.find(path);
+      if (it != files.end()) {
+        mtlLibraries(it->second, splitDelims(path, "\\/").first, libraries);
+      }
+    }
+    reader.read(libraries, files);
+
+    scenes.assign(paths.size(), Scene());
+    std::vector<char> ok(paths.size(), 0);
+    auto parse_one = [&](size_t i) {
+      ok[i] = loadObj(paths[i], scenes[i], parse_option, nullptr, nullptr, nullptr, &files);
+    };
+    if (pool) {
+      pool->parallel_for(paths.size(), parse_one);
+    } else {
+      for (size_t i = 0; i < paths.size(); i++) parse_one(i);
+    }
+    loaded.assign(ok.begin(), ok.end());
+    return std::find(ok.begin(), ok.end(), 0) == ok.end();
+  }
+}
+
+#endif //MODEL_LOAD_BATCH_READER_H
@@ -0,0 +1,458 @@
+#ifndef MODEL_LOAD_BVH_H
+#define MODEL_LOAD_BVH_H
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "obj_loader.h"
+#include "thread_pool.h"
+
+namespace obj_loader {
+  // 32 bytes. children are allocated as a pair, so a node visit touches both siblings in one place.
+  struct BvhNode {
+    float min[3];
+    uint32_t first; // leaf: first triangle, inner node: left child, the right child is first + 1
+    float max[3];
+    uint32_t count; // triangles of a leaf, 0 for inner nodes
+    bool is_leaf() const { return count > 0; }
+  };
+
+  // a triangle in leaf order, kept as one corner and two edges for the intersection test
+  struct BvhTriangle {
+    vec3 v0, e1, e2;
+    uint32_t mesh;
+    uint32_t index; // triangle of the mesh, its corners are indices[3 * index + 0..2]
+  };
+
+  struct BvhHit {
+    BvhHit() : t(FLT_MAX), u(0.f), v(0.f), mesh(UINT32_MAX), triangle(UINT32_MAX) {}
+    float t; // distance along the ray in units of its direction
+    float u, v; // barycentrics of the second and third corner
+    uint32_t mesh;
+    uint32_t triangle;
+  };
+
+  namespace bvh_detail {
+    struct Box {
+      Box() : lo(FLT_MAX), hi(-FLT_MAX) {}
+      void grow(const vec3& p) {
+        lo.x = std::min(lo.x, p.x); lo.y = std::min(lo.y, p.y); lo.z = std::min(lo.z, p.z);
+        hi.x = std::max(hi.x, p.x); hi.y = std::max(hi.y, p.y); hi.z = std::max(hi.z, p.z);
+      }
+      void grow(const Box& b) {
+        if (b.lo.x > b.hi.x) return; // empty
+        grow(b.lo);
+        grow(b.hi);
+      }
+      float area() const {
+        if (lo.x > hi.x) return 0.f;
+        float dx = hi.x - lo.x, dy = hi.y - lo.y, dz = hi.z - lo.z;
+        return 2.f * (dx * dy + dy * dz + dz * dx);
+      }
+      vec3 lo, hi;
+    };
+
+    struct Primitive {
+      Box box;
+      vec3 centroid;
+    };
+
+    struct Bin {
+      Bin() : box(), count(0) {}
+      Box box;
+      uint32_t count;
+    };
+
+    static const int bin_count = 16;
+    static const uint32_t max_leaf_size = 8;
+    static const int max_sah_depth = 64; // deeper nodes split at the median, which bounds the traversal stack
+    static const uint32_t parallel_subtree = 4096; // smaller subtrees are built on the current thread
+    static const uint32_t parallel_pass = 64 * 1024; // larger nodes bin and bound their range in chunks
+
+    inline float axis(const vec3& v, int a) { return a == 0 ? v.x : (a == 1 ? v.y : v.z); }
+    inline vec3 sub(const vec3& a, const vec3& b) { return vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+    inline vec3 cross(const vec3& a, const vec3& b) { return vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+    inline float dot(const vec3& a, const vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+  }
+
+  // Bounding volume hierarchy over the triangles of a scene, built top down with binned SAH splits.
+  // Nodes live in one array in pair order, leaves refer to ranges of a triangle array in the same order.
+  // Queries are const and may run from any number of threads.
+  class Bvh {
+  public:
+    Bvh() : node_list(), triangle_list() {}
+
+    // indices of every mesh are read as a triangle list, so load the scene with ParseOption::TRIANGULATE.
+    // meshes loaded into a packed VertexBuffer have no vertices of their own and are skipped.
+    // with a pool, subtrees and the passes over large nodes run in parallel.
+    bool build(const Scene& scene, ThreadPool* pool = nullptr) {
+      using namespace bvh_detail;
+      OBJ_LOADER_TRACE_SCOPE("bvh build");
+      node_list.clear();
+      triangle_list.clear();
+      std::vector<BvhTriangle> source;
+      for (size_t m = 0; m < scene.meshes.size(); m++) {
+        const Mesh& mesh = scene.meshes[m];
+        if (mesh.vertices.empty()) {
+          continue;
+        }
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+          const vec3& a = mesh.vertices[mesh.indices[i]].position;
+          BvhTriangle tri;
+          tri.v0 = a;
+          tri.e1 = sub(mesh.vertices[mesh.indices[i + 1]].position, a);
+          tri.e2 = sub(mesh.vertices[mesh.indices[i + 2]].position, a);
+          tri.mesh = static_cast<uint32_t>(m);
+          tri.index = static_cast<uint32_t>(i / 3);
+          source.emplace_back(tri);
+        }
+      }
+      if (source.empty()) {
+        return false;
+      }
+
+      const uint32_t count = static_cast<uint32_t>(source.size());
+      std::vector<Primitive> prims(count);
+      std::vector<uint32_t> order(count);
+      auto bound = [&](size_t i) {
+        const BvhTriangle& tri = source[i];
+        Primitive& p = prims[i];
+        p.box = Box();
+        p.box.grow(tri.v0);
+        p.box.grow(vec3(tri.v0.x + tri.e1.x, tri.v0.y + tri.e1.y, tri.v0.z + tri.e1.z));
+        p.box.grow(vec3(tri.v0.x + tri.e2.x, tri.v0.y + tri.e2.y, tri.v0.z + tri.e2.z));
+        p.centroid = vec3((p.box.lo.x + p.box.hi.x) * 0.5f, (p.box.lo.y + p.box.hi.y) * 0.5f, (p.box.lo.z + p.box.hi.z) * 0.5f);
+        order[i] = static_cast<uint32_t>(i);
+      };
+      if (pool) {
+        pool->parallel_for((count + parallel_pass - 1) / parallel_pass, [&](size_t chunk) {
+          size_t end = std::min<size_t>(count, (chunk + 1) * parallel_pass);
+          for (size_t i = chunk * parallel_pass; i < end; i++) bound(i);
+        });
+      } else {
+        for (size_t i = 0; i < count; i++) bound(i);
+      }
+
+      // a binary tree over n leaves has at most 2n - 1 nodes
+      node_list.resize(2 * static_cast<size_t>(count));
+      Builder builder(prims, order, node_list, pool);
+      builder.split(0, 0, count, 0);
+      node_list.resize(builder.node_count.load());
+      node_list.shrink_to_fit();
+
+      triangle_list.resize(count);
+      for (uint32_t i = 0; i < count; i++) {
+        triangle_list[i] = source[order[i]];
+      }
+      return true;
+    }
+
+    // closest hit along origin + t * direction with t in [0, t_max]
+    bool intersect(const vec3& origin, const vec3& direction, BvhHit& hit, float t_max = FLT_MAX) const {
+      hit = BvhHit();
+      hit.t = t_max;
+      return traverse<false>(origin, direction, hit);
+    }
+
+    // any hit with t in [0, t_max], e.g. for visibility between two points
+    bool occluded(const vec3& origin, const vec3& direction, float t_max = FLT_MAX) const {
+      BvhHit hit;
+      hit.t = t_max;
+      return traverse<true>(origin, direction, hit);
+    }
+
+    // appends the triangles whose bounds overlap the box, as indices into triangles()
+    size_t overlap(const vec3& box_min, const vec3& box_max, std::vector<uint32_t>& result) const {
+      if (node_list.empty()) {
+        return 0;
+      }
+      const float lo[3] = {box_min.x, box_min.y, box_min.z};
+      const float hi[3] = {box_max.x, box_max.y, box_max.z};
+      size_t found = 0;
+      uint32_t stack[128];
+      int top = 0;
+      stack[top++] = 0;
+      while (top > 0) {
+        const BvhNode& node = node_list[stack[--top]];
+        if (node.min[0] > hi[0] || node.min[1] > hi[1] || node.min[2] > hi[2] ||
+            node.max[0] < lo[0] || node.max[1] < lo[1] || node.max[2] < lo[2]) {
+          continue;
+        }
+        if (!node.is_leaf()) {
+          stack[top++] = node.first;
+          stack[top++] = node.first + 1;
+          continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+          const BvhTriangle& tri = triangle_list[i];
+          bvh_detail::Box box;
+          box.grow(tri.v0);
+          box.grow(vec3(tri.v0.x + tri.e1.x, tri.v0.y + tri.e1.y, tri.v0.z + tri.e1.z));
+          box.grow(vec3(tri.v0.x + tri.e2.x, tri.v0.y + tri.e2.y, tri.v0.z + tri.e2.z));
+          if (box.lo.x <= hi[0] && box.lo.y <= hi[1] && box.lo.z <= hi[2] &&
+              box.hi.x >= lo[0] && box.hi.y >= lo[1] && box.hi.z >= lo[2]) {
+            result.emplace_back(i);
+            found++;
+          }
+        }
+      }
+      return found;
+    }
+
+    const std::vector<BvhNode>& nodes() const { return node_list; }
+    const std::vector<BvhTriangle>& triangles() const { return triangle_list; }
+
+  private:
+    class Builder {
+    public:
+      Builder(std::vector<bvh_detail::Primitive>& prims, std::vector<uint32_t>& order, std::vector<BvhNode>& nodes, ThreadPool* pool)
+        : prims(prims), order(order), nodes(nodes), pool(pool), node_count(1) {}
+
+      void split(uint32_t index, uint32_t begin, uint32_t end, int depth) {
+        using namespace bvh_detail;
+        const uint32_t count = end - begin;
+        Box box, centroids;
+        bounds(begin, end, box, centroids);
+        BvhNode& node = nodes[index];
+        node.min[0] = box.lo.x; node.min[1] = box.lo.y; node.min[2] = box.lo.z;
+        node.max[0] = box.hi.x; node.max[1] = box.hi.y; node.max[2] = box.hi.z;
+
+        // best binned split over all three axes; cost in surface area times triangle count
+        int best_axis = -1, best_bin = 0;
+        float best_cost = FLT_MAX;
+        if (count > 2 && depth < max_sah_depth) {
+          for (int a = 0; a < 3; a++) {
+            float lo = axis(centroids.lo, a), hi = axis(centroids.hi, a);
+            if (!(hi > lo)) continue;
+            Bin bins[bin_count];
+            fillBins(begin, end, a, lo, bin_count / (hi - lo), bins);
+            float right_area[bin_count];
+            uint32_t right_count[bin_count];
+            Box acc;
+            uint32_t n = 0;
+            for (int b = bin_count - 1; b > 0; b--) {
+              acc.grow(bins[b].box);
+              n += bins[b].count;
+              right_area[b] = acc.area();
+              right_count[b] = n;
+            }
+            acc = Box();
+            n = 0;
+            for (int b = 0; b < bin_count - 1; b++) {
+              acc.grow(bins[b].box);
+              n += bins[b].count;
+              if (n == 0 || right_count[b + 1] == 0) continue;
+              float cost = acc.area() * n + right_area[b + 1] * right_count[b + 1];
+              if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = a;
+                best_bin = b;
+              }
+            }
+          }
+        }
+
+        // a leaf when splitting does not beat intersecting every triangle (one traversal step = one intersection)
+        const float area = box.area();
+        if (count <= 2 || (count <= max_leaf_size && (best_axis < 0 || area + best_cost >= area * count))) {
+          node.first = begin;
+          node.count = count;
+          return;
+        }
+
+        uint32_t mid;
+        if (best_axis >= 0) {
+          const int a = best_axis;
+          const float lo = axis(centroids.lo, a);
+          const float scale = bin_count / (axis(centroids.hi, a) - lo);
+          mid = static_cast<uint32_t>(std::partition(order.begin() + begin, order.begin() + end, [&](uint32_t p) {
+            return binOf(axis(prims[p].centroid, a), lo, scale) <= best_bin;
+          }) - order.begin());
+        } else {
+          mid = begin; // no usable split, e.g. past the sah depth or every centroid at one point
+        }
+        if (mid == begin || mid == end) {
+          // median along the widest centroid axis
+          float ex = centroids.hi.x - centroids.lo.x, ey = centroids.hi.y - centroids.lo.y, ez = centroids.hi.z - centroids.lo.z;
+          const int a = ex >= ey && ex >= ez ? 0 : (ey >= ez ? 1 : 2);
+          mid = begin + count / 2;
+          std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](uint32_t l, uint32_t r) {
+            return axis(prims[l].centroid, a) < axis(prims[r].centroid, a);
+          });
+        }
+
+        const uint32_t left = node_count.fetch_add(2);
+        node.first = left;
+        node.count = 0;
+        if (pool && mid - begin >= parallel_subtree && end - mid >= parallel_subtree) {
+          pool->parallel_for(2, [&](size_t i) {
+            if (i == 0) split(left, begin, mid, depth + 1);
+            else split(left + 1, mid, end, depth + 1);
+          });
+        } else {
+          split(left, begin, mid, depth + 1);
+          split(left + 1, mid, end, depth + 1);
+        }
+      }
+
+      std::vector<bvh_detail::Primitive>& prims;
+      std::vector<uint32_t>& order;
+      std::vector<BvhNode>& nodes;
+      ThreadPool* pool;
+      std::atomic<uint32_t> node_count;
+
+    private:
+      static int binOf(float c, float lo, float scale) {
+        int b = static_cast<int>((c - lo) * scale);
+        return b < 0 ? 0 : (b >= bvh_detail::bin_count ? bvh_detail::bin_count - 1 : b);
+      }
+
+      // one chunk per worker and the calling thread, small ranges stay in one
+      size_t chunkCount(uint32_t count) const {
+        return !pool || count < bvh_detail::parallel_pass ? 1 : std::min<size_t>(pool->size() + 1, count / (bvh_detail::parallel_pass / 4));
+      }
+
+      // splits a pass over a large range into chunks for the pool, small ranges run inline
+      template <typename F>
+      void chunked(uint32_t begin, uint32_t end, const F& fn) {
+        const uint32_t count = end - begin;
+        const size_t chunks = chunkCount(count);
+        if (chunks == 1) {
+          fn(0, begin, end);
+          return;
+        }
+        pool->parallel_for(chunks, [&](size_t c) {
+          fn(c, begin + static_cast<uint32_t>(count * c / chunks), begin + static_cast<uint32_t>(count * (c + 1) / chunks));
+        });
+      }
+
+      void bounds(uint32_t begin, uint32_t end, bvh_detail::Box& box, bvh_detail::Box& centroids) {
+        std::vector<bvh_detail::Box> boxes(chunkCount(end - begin)), centers(boxes.size());
+        chunked(begin, end, [&](size_t c, uint32_t b, uint32_t e) {
+          for (uint32_t i = b; i < e; i++) {
+            const bvh_detail::Primitive& p = prims[order[i]];
+            boxes[c].grow(p.box);
+            centers[c].grow(p.centroid);
+          }
+        });
+        for (size_t c = 0; c < boxes.size(); c++) {
+          box.grow(boxes[c]);
+          centroids.grow(centers[c]);
+        }
+      }
+
+      void fillBins(uint32_t begin, uint32_t end, int a, float lo, float scale, bvh_detail::Bin* bins) {
+        std::vector<std::vector<bvh_detail::Bin>> partial(chunkCount(end - begin), std::vector<bvh_detail::Bin>(bvh_detail::bin_count));
+        chunked(begin, end, [&](size_t c, uint32_t b, uint32_t e) {
+          bvh_detail::Bin* local = partial[c].data();
+          for (uint32_t i = b; i < e; i++) {
+            const bvh_detail::Primitive& p = prims[order[i]];
+            bvh_detail::Bin& bin = local[binOf(bvh_detail::axis(p.centroid, a), lo, scale)];
+            bin.box.grow(p.box);
+            bin.count++;
+          }
+        });
+        for (const auto& local : partial) {
+          for (int b = 0; b < bvh_detail::bin_count; b++) {
+            bins[b].box.grow(local[b].box);
+            bins[b].count += local[b].count;
+          }
+        }
+      }
+    };
+
+    // entry distance of the ray into the node, FLT_MAX when it misses or starts beyond t_max
+    static float slab(const BvhNode& node, const float o[3], const float inv[3], float t_max) {
+      float t0 = 0.f, t1 = t_max;
+      for (int a = 0; a < 3; a++) {
+        float near_t = (node.min[a] - o[a]) * inv[a];
+        float far_t = (node.max[a] - o[a]) * inv[a];
+        if (near_t > far_t) std::swap(near_t, far_t);
+        // written so a NaN (ray in the slab plane with zero direction) keeps the current interval
+        t0 = near_t > t0 ? near_t : t0;
+        t1 = far_t < t1 ? far_t : t1;
+      }
+      return t0 <= t1 ? t0 : FLT_MAX;
+    }
+
+    // moller-trumbore, both sides of the triangle count
+    static bool hitTriangle(const BvhTriangle& tri, const vec3& o, const vec3& d, BvhHit& hit) {
+      using namespace bvh_detail;
+      vec3 p = cross(d, tri.e2);
+      float det = dot(tri.e1, p);
+      if (std::fabs(det) < 1e-12f) return false;
+      float inv_det = 1.f / det;
+      vec3 s = sub(o, tri.v0);
+      float u = dot(s, p) * inv_det;
+      if (u < 0.f || u > 1.f) return false;
+      vec3 q = cross(s, tri.e1);
+      float v = dot(d, q) * inv_det;
+      if (v < 0.f || u + v > 1.f) return false;
+      float t = dot(tri.e2, q) * inv_det;
+      if (t < 0.f || t > hit.t) return false;
+      hit.t = t;
+      hit.u = u;
+      hit.v = v;
+      hit.mesh = tri.mesh;
+      hit.triangle = tri.index;
+      return true;
+    }
+
+    template <bool AnyHit>
+    bool traverse(const vec3& origin, const vec3& direction, BvhHit& hit) const {
+      if (node_list.empty()) {
+        return false;
+      }
+      const float o[3] = {origin.x, origin.y, origin.z};
+      const float inv[3] = {1.f / direction.x, 1.f / direction.y, 1.f / direction.z};
+      if (slab(node_list[0], o, inv, hit.t) == FLT_MAX) {
+        return false;
+      }
+      bool found = false;
+      uint32_t stack[128];
+      int top = 0;
+      uint32_t index = 0;
+      for (;;) {
+        const BvhNode& node = node_list[index];
+        if (node.is_leaf()) {
+          for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            if (hitTriangle(triangle_list[i], origin, direction, hit)) {
+              if (AnyHit) return true;
+              found = true;
+            }
+          }
+        } else {
+          // nearer child first, the other one is only visited if it still starts before the closest hit
+          uint32_t near_index = node.first, far_index = node.first + 1;
+          float near_t = slab(node_list[near_index], o, inv, hit.t);
+          float far_t = slab(node_list[far_index], o, inv, hit.t);
+          if (far_t < near_t) {
+            std::swap(near_index, far_index);
+            std::swap(near_t, far_t);
+          }
+          if (near_t != FLT_MAX) {
+            if (far_t != FLT_MAX) stack[top++] = far_index;
+            index = near_index;
+            continue;
+          }
+        }
+        // pop, dropping nodes the closest hit has moved in front of
+        for (;;) {
+          if (top == 0) {
+            return found;
+          }
+          index = stack[--top];
+          if (AnyHit || slab(node_list[index], o, inv, hit.t) != FLT_MAX) break;
+        }
+      }
+    }
+
+    std::vector<BvhNode> node_list;
+    std::vector<BvhTriangle> triangle_list;
+  };
+}
+
+#endif //MODEL_LOAD_BVH_H
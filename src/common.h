@@ -53,6 +53,23 @@ struct vec2 {
   }
 };
 
+// column major, m[column * 4 + row] (opengl layout)
+struct mat4 {
+  mat4() { for (int i = 0; i < 16; i++) m[i] = (i % 5 == 0) ? 1.f : 0.f; }
+  float m[16];
+
+  mat4 operator*(const mat4& rhs) const {
+    mat4 r;
+    for (int c = 0; c < 4; c++) {
+      for (int row = 0; row < 4; row++) {
+        r.m[c * 4 + row] = m[row] * rhs.m[c * 4] + m[4 + row] * rhs.m[c * 4 + 1] +
+                           m[8 + row] * rhs.m[c * 4 + 2] + m[12 + row] * rhs.m[c * 4 + 3];
+      }
+    }
+    return r;
+  }
+};
+
 struct vertex {
   vec3 pos, normal;
   vec2 tex_coords;
@@ -0,0 +1,355 @@
+#ifndef MODEL_LOAD_COMPRESSED_STREAM_H
+#define MODEL_LOAD_COMPRESSED_STREAM_H
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "trace.h"
+#ifdef OBJ_LOADER_ZLIB
+#include <zlib.h>
+#endif
+#ifdef OBJ_LOADER_ZSTD
+#include <zstd.h>
+#endif
+
+namespace obj_loader {
+  enum class Compression {
+    NONE,
+    GZIP, // .gz, needs OBJ_LOADER_ZLIB
+    ZSTD, // .zst, needs OBJ_LOADER_ZSTD
+  };
+
+  inline Compression compressionOf(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) return Compression::NONE;
+    if (0 == path.compare(dot, std::string::npos, ".gz")) return Compression::GZIP;
+    if (0 == path.compare(dot, std::string::npos, ".zst")) return Compression::ZSTD;
+    return Compression::NONE;
+  }
+
+  // path without its compression suffix, e.g. for extension checks
+  inline std::string stripCompression(const std::string& path) {
+    switch (compressionOf(path)) {
+      case Compression::GZIP: return path.substr(0, path.size() - 3);
+      case Compression::ZSTD: return path.substr(0, path.size() - 4);
+      default: return path;
+    }
+  }
+
+  // the file itself when it exists, otherwise a compressed sibling (path.gz, path.zst)
+  inline std::string resolveInput(const std::string& path) {
+    const char* candidates[] = {"", ".gz", ".zst"};
+    for (const char* suffix : candidates) {
+      FILE* fp = fopen((path + suffix).c_str(), "rb");
+      if (fp) {
+        fclose(fp);
+        return path + suffix;
+      }
+    }
+    return path;
+  }
+
+  // Streambuf over a compressed file. A decoder thread inflates into a small ring of chunks
+  // while the reader tokenizes the previous one, so decompression and parsing overlap.
+  class DecompressBuf : public std::streambuf {
+  public:
+    DecompressBuf(const std::string& path, Compression compression, size_t chunk_size = 256 * 1024, size_t depth = 4)
+      : file(nullptr), chunks(depth, std::vector<char>(chunk_size)), filled(), free_list(), current(-1),
+        mutex(), cv(), decoder(), stopping(false), finished(false), error(false) {
+      file = fopen(path.c_str(), "rb");
+      if (!file || !supported(compression)) {
+        error = true;
+        return;
+      }
+      for (size_t i = 0; i < depth; i++) {
+        free_list.push_back(static_cast<int>(i));
+      }
+      decoder = std::thread([this, compression] { decode(compression); });
+    }
+
+    ~DecompressBuf() {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+      }
+      cv.notify_all();
+      if (decoder.joinable()) {
+        decoder.join();
+      }
+      if (file) {
+        fclose(file);
+      }
+    }
+
+    DecompressBuf(const DecompressBuf&) = delete;
+    DecompressBuf& operator=(const DecompressBuf&) = delete;
+
+    static bool supported(Compression compression) {
+#ifdef OBJ_LOADER_ZLIB
+      if (compression == Compression::GZIP) return true;
+#endif
+#ifdef OBJ_LOADER_ZSTD
+      if (compression == Compression::ZSTD) return true;
+#endif
+      return compression == Compression::NONE;
+    }
+
+    bool is_open() const { return file != nullptr && !failed(); }
+
+    // corrupt or truncated input; the stream simply ends early, so check this after parsing
+    bool failed() const {
+      std::lock_guard<std::mutex> lock(mutex);
+      return error;
+    }
+
+  protected:
+    int_type underflow() override {
+      if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+      }
+      std::unique_lock<std::mutex> lock(mutex);
+      if (current >= 0) {
+        free_list.push_back(current);
+        current = -1;
+        cv.notify_all();
+      }
+      cv.wait(lock, [this] { return !filled.empty() || finished; });
+      if (filled.empty()) {
+        return traits_type::eof();
+      }
+      current = filled.front().first;
+      size_t size = filled.front().second;
+      filled.pop_front();
+      char* base = chunks[current].data();
+      setg(base, base, base + size);
+      return traits_type::to_int_type(*gptr());
+    }
+
+  private:
+    // next free chunk for the decoder, -1 once the reader is gone
+    int acquire() {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [this] { return stopping || !free_list.empty(); });
+      if (stopping) {
+        return -1;
+      }
+      int chunk = free_list.front();
+      free_list.pop_front();
+      return chunk;
+    }
+
+    void publish(int chunk, size_t size) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (size > 0) {
+        filled.emplace_back(chunk, size);
+      } else {
+        free_list.push_back(chunk);
+      }
+      cv.notify_all();
+    }
+
+    void finish(bool ok) {
+      std::lock_guard<std::mutex> lock(mutex);
+      finished = true;
+      error = error || !ok;
+      cv.notify_all();
+    }
+
+    void decode(Compression compression) {
+      bool ok = false;
+#ifdef OBJ_LOADER_ZLIB
+      if (compression == Compression::GZIP) ok = inflateGzip();
+#endif
+#ifdef OBJ_LOADER_ZSTD
+      if (compression == Compression::ZSTD) ok = decompressZstd();
+#endif
+      (void)compression;
+      finish(ok);
+    }
+
+#ifdef OBJ_LOADER_ZLIB
+    bool inflateGzip() {
+      z_stream zs;
+      memset(&zs, 0, sizeof(zs));
+      if (inflateInit2(&zs, 15 + 32) != Z_OK) { // 32: accept gzip and zlib headers
+        return false;
+      }
+      std::vector<char> in(64 * 1024);
+      int ret = Z_OK;
+      bool ok = true;
+      while (ok) {
+        if (zs.avail_in == 0) {
+          zs.avail_in = static_cast<uInt>(fread(in.data(), 1, in.size(), file));
+          zs.next_in = reinterpret_cast<Bytef*>(in.data());
+          if (zs.avail_in == 0) {
+            ok = ret == Z_STREAM_END; // input ended inside a member means truncation
+            break;
+          }
+        }
+        int chunk = acquire();
+        if (chunk < 0) {
+          break;
+        }
+        zs.next_out = reinterpret_cast<Bytef*>(chunks[chunk].data());
+        zs.avail_out = static_cast<uInt>(chunks[chunk].size());
+        while (zs.avail_out > 0) {
+          if (zs.avail_in == 0) {
+            zs.avail_in = static_cast<uInt>(fread(in.data(), 1, in.size(), file));
+            zs.next_in = reinterpret_cast<Bytef*>(in.data());
+            if (zs.avail_in == 0) break;
+          }
+          ret = inflate(&zs, Z_NO_FLUSH);
+          if (ret == Z_STREAM_END) {
+            inflateReset(&zs); // concatenated gzip members are one stream
+          } else if (ret != Z_OK) {
+            ok = false;
+            break;
+          }
+        }
+        publish(chunk, chunks[chunk].size() - zs.avail_out);
+      }
+      inflateEnd(&zs);
+      return ok;
+    }
+#endif
+
+#ifdef OBJ_LOADER_ZSTD
+    bool decompressZstd() {
+      ZSTD_DStream* ds = ZSTD_createDStream();
+      if (!ds) {
+        return false;
+      }
+      ZSTD_initDStream(ds);
+      std::vector<char> in(ZSTD_DStreamInSize());
+      ZSTD_inBuffer input = {in.data(), 0, 0};
+      size_t ret = 0;
+      bool ok = true;
+      bool drained = false; // the file is read to its end, only what the decoder still holds is left
+      bool eof = false;
+      while (ok && !eof) {
+        int chunk = acquire();
+        if (chunk < 0) {
+          break;
+        }
+        ZSTD_outBuffer output = {chunks[chunk].data(), chunks[chunk].size(), 0};
+        while (output.pos < output.size) {
+          if (input.pos == input.size && !drained) {
+            input.size = fread(in.data(), 1, in.size(), file);
+            input.pos = 0;
+            drained = input.size == 0;
+          }
+          if (drained && ret == 0) {
+            eof = true; // 0 means the last frame was complete and flushed
+            break;
+          }
+          size_t before = output.pos;
+          ret = ZSTD_decompressStream(ds, &output, &input);
+          if (ZSTD_isError(ret)) {
+            ok = false;
+            break;
+          }
+          // a decoded block may not have fit the previous chunk, keep flushing until the decoder is empty
+          if (drained && output.pos == before) {
+            eof = true;
+            ok = ret == 0; // no progress without input: the file ends inside a frame
+            break;
+          }
+        }
+        publish(chunk, output.pos);
+      }
+      ZSTD_freeDStream(ds);
+      return ok;
+    }
+#endif
+
+    FILE* file;
+    std::vector<std::vector<char>> chunks;
+    std::deque<std::pair<int, size_t>> filled; // chunk, decoded size, in stream order
+    std::deque<int> free_list;
+    int current; // chunk the reader is in
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    std::thread decoder;
+    bool stopping;
+    bool finished;
+    bool error;
+  };
+
+  // file contents read ahead of parsing, e.g. by a batch reader, keyed by the path the loader would open.
+  // only uncompressed paths are looked up here.
+  typedef std::unordered_map<std::string, std::vector<char>> PreloadedFiles;
+
+  // read only streambuf over bytes in memory, seekable so PRESCAN can rewind it
+  class MemoryBuf : public std::streambuf {
+  public:
+    explicit MemoryBuf(const std::vector<char>& data) {
+      char* base = const_cast<char*>(data.data()); // never written through, there is no put area
+      setg(base, base, base + data.size());
+    }
+
+  protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+      if (!(which & std::ios_base::in)) {
+        return pos_type(off_type(-1));
+      }
+      off_type base = dir == std::ios_base::beg ? 0 : (dir == std::ios_base::cur ? gptr() - eback() : egptr() - eback());
+      off_type target = base + off;
+      if (target < 0 || target > egptr() - eback()) {
+        return pos_type(off_type(-1));
+      }
+      setg(eback(), eback() + target, egptr());
+      return pos_type(target);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+      return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+  };
+
+  // A plain ifstream, an istream over a DecompressBuf when the path has a compression suffix,
+  // or over the preloaded bytes when the path is one of them.
+  class InputFile {
+  public:
+    explicit InputFile(const std::string& path, const PreloadedFiles* preloaded = nullptr) : plain(), buf(), memory(), wrapped() {
+      OBJ_LOADER_TRACE_SCOPE("open");
+      Compression compression = compressionOf(path);
+      if (preloaded && compression == Compression::NONE) {
+        auto it = preloaded->find(path);
+        if (it != preloaded->end()) {
+          memory.reset(new MemoryBuf(it->second));
+          wrapped.reset(new std::istream(memory.get()));
+          return;
+        }
+      }
+      if (compression == Compression::NONE) {
+        plain.open(path);
+        return;
+      }
+      buf.reset(new DecompressBuf(path, compression));
+      wrapped.reset(new std::istream(buf.get()));
+    }
+
+    bool is_open() const { return memory ? true : (buf ? buf->is_open() : plain.is_open()); }
+    std::istream& stream() { return wrapped ? *wrapped : static_cast<std::istream&>(plain); }
+    // compressed input can only be read once front to back
+    bool seekable() const { return !buf; }
+    bool failed() const { return buf && buf->failed(); }
+
+  private:
+    std::ifstream plain;
+    std::unique_ptr<DecompressBuf> buf;
+    std::unique_ptr<MemoryBuf> memory;
+    std::unique_ptr<std::istream> wrapped;
+  };
+}
+
+#endif //MODEL_LOAD_COMPRESSED_STREAM_H
@@ -2,3 +2,26 @@
 #define TBJ_PROFILE
 #define OBJL_PROFILE
 #define MY_PROFILE
+#define LOD_PROFILE
+#define ARENA_PROFILE
+#define PRESCAN_PROFILE
+#define MTL_CACHE_PROFILE
+#define POSTPROCESS_PROFILE
+#define SCENE_PROFILE
+#define FORMAT_PROFILE
+#define GLTF_PROFILE
+#define HOT_RELOAD_PROFILE
+#define LAZY_PROFILE
+#define COMPRESS_PROFILE
+#define LAYOUT_PROFILE
+#define SPECIALIZE_PROFILE
+#define KEYWORD_PROFILE
+#define BVH_PROFILE
+#define DEDUP_PROFILE
+#define IO_BATCH_PROFILE
+#define WELD_PROFILE
+#define TRACE_PROFILE
+#define MERGE_PROFILE
+#define LARGE_PROFILE
+#define TEXTURE_PROFILE
+#define ROUNDTRIP_PROFILE
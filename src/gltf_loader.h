@@ -0,0 +1,538 @@
+#ifndef MODEL_LOAD_GLTF_LOADER_H
+#define MODEL_LOAD_GLTF_LOADER_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "obj_loader.h"
+#include "mapped_file.h"
+
+namespace gltf_loader {
+  // minimal json dom, enough for the gltf schema
+  struct JsonValue {
+    enum class Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+    JsonValue() : type(Type::NUL), boolean(false), number(0.0), string(), array(), object() {}
+
+    const JsonValue* find(const char* key) const {
+      if (type != Type::OBJECT) return nullptr;
+      for (const auto& it : object) {
+        if (it.first == key) return &it.second;
+      }
+      return nullptr;
+    }
+
+    double numberOr(const char* key, double default_value) const {
+      const JsonValue* v = find(key);
+      return v && v->type == Type::NUMBER ? v->number : default_value;
+    }
+
+    int intOr(const char* key, int default_value) const {
+      return static_cast<int>(numberOr(key, default_value));
+    }
+
+    std::string stringOr(const char* key, const std::string& default_value) const {
+      const JsonValue* v = find(key);
+      return v && v->type == Type::STRING ? v->string : default_value;
+    }
+
+    size_t size() const { return type == Type::ARRAY ? array.size() : 0; }
+
+    Type type;
+    bool boolean;
+    double number;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+  };
+
+  namespace json_detail {
+    struct Parser {
+      const char* p;
+      const char* end;
+
+      void skip() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+      }
+
+      static void appendUtf8(std::string& out, unsigned int cp) {
+        if (cp < 0x80) {
+          out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+          out += static_cast<char>(0xc0 | (cp >> 6));
+          out += static_cast<char>(0x80 | (cp & 0x3f));
+        } else {
+          out += static_cast<char>(0xe0 | (cp >> 12));
+          out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+          out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+      }
+
+      bool parseString(std::string& out) {
+        if (p >= end || *p != '"') return false;
+        p++;
+        while (p < end && *p != '"') {
+          if (*p != '\\') {
+            out += *p++;
+            continue;
+          }
+          if (++p >= end) return false;
+          switch (*p) {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u': {
+              if (end - p < 5) return false;
+              char hex[5] = {p[1], p[2], p[3], p[4], 0};
+              appendUtf8(out, static_cast<unsigned int>(strtoul(hex, nullptr, 16)));
+              p += 4;
+              break;
+            }
+            default: out += *p; break;
+          }
+          p++;
+        }
+        if (p >= end) return false;
+        p++;
+        return true;
+      }
+
+      bool parseValue(JsonValue& v, int depth) {
+        if (depth > 64) return false;
+        skip();
+        if (p >= end) return false;
+        char c = *p;
+        if (c == '{') {
+          v.type = JsonValue::Type::OBJECT;
+          p++;
+          skip();
+          if (p < end && *p == '}') { p++; return true; }
+          for (;;) {
+            skip();
+            std::pair<std::string, JsonValue> member;
+            if (!parseString(member.first)) return false;
+            skip();
+            if (p >= end || *p != ':') return false;
+            p++;
+            if (!parseValue(member.second, depth + 1)) return false;
+            v.object.emplace_back(std::move(member));
+            skip();
+            if (p < end && *p == ',') { p++; continue; }
+            if (p < end && *p == '}') { p++; return true; }
+            return false;
+          }
+        }
+        if (c == '[') {
+          v.type = JsonValue::Type::ARRAY;
+          p++;
+          skip();
+          if (p < end && *p == ']') { p++; return true; }
+          for (;;) {
+            JsonValue item;
+            if (!parseValue(item, depth + 1)) return false;
+            v.array.emplace_back(std::move(item));
+            skip();
+            if (p < end && *p == ',') { p++; continue; }
+            if (p < end && *p == ']') { p++; return true; }
+            return false;
+          }
+        }
+        if (c == '"') {
+          v.type = JsonValue::Type::STRING;
+          return parseString(v.string);
+        }
+        if (end - p >= 4 && 0 == strncmp(p, "true", 4)) { v.type = JsonValue::Type::BOOL; v.boolean = true; p += 4; return true; }
+        if (end - p >= 5 && 0 == strncmp(p, "false", 5)) { v.type = JsonValue::Type::BOOL; p += 5; return true; }
+        if (end - p >= 4 && 0 == strncmp(p, "null", 4)) { p += 4; return true; }
+
+        // number, copied out because the buffer is not null terminated
+        const char* start = p;
+        while (p < end && (isdigit(static_cast<unsigned char>(*p)) || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) p++;
+        size_t len = static_cast<size_t>(p - start);
+        if (len == 0 || len >= 64) return false;
+        char buf[64];
+        memcpy(buf, start, len);
+        buf[len] = '\0';
+        v.type = JsonValue::Type::NUMBER;
+        v.number = strtod(buf, nullptr);
+        return true;
+      }
+    };
+
+    inline int base64Value(char c) {
+      if (c >= 'A' && c <= 'Z') return c - 'A';
+      if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+      if (c >= '0' && c <= '9') return c - '0' + 52;
+      if (c == '+' || c == '-') return 62;
+      if (c == '/' || c == '_') return 63;
+      return -1;
+    }
+
+    inline void decodeBase64(const char* p, const char* end, std::vector<char>& out) {
+      unsigned int acc = 0;
+      int bits = 0;
+      for (; p < end; p++) {
+        int v = base64Value(*p);
+        if (v < 0) continue;
+        acc = (acc << 6) | static_cast<unsigned int>(v);
+        bits += 6;
+        if (bits >= 8) {
+          bits -= 8;
+          out.push_back(static_cast<char>((acc >> bits) & 0xff));
+        }
+      }
+    }
+  }
+
+  inline bool parseJson(const char* data, size_t size, JsonValue& root) {
+    json_detail::Parser parser = {data, data + size};
+    return parser.parseValue(root, 0);
+  }
+
+  enum class ComponentType {
+    BYTE = 5120,
+    UNSIGNED_BYTE = 5121,
+    SHORT = 5122,
+    UNSIGNED_SHORT = 5123,
+    UNSIGNED_INT = 5125,
+    FLOAT = 5126,
+  };
+
+  inline size_t componentSize(ComponentType t) {
+    switch (t) {
+      case ComponentType::BYTE: case ComponentType::UNSIGNED_BYTE: return 1;
+      case ComponentType::SHORT: case ComponentType::UNSIGNED_SHORT: return 2;
+      case ComponentType::UNSIGNED_INT: case ComponentType::FLOAT: return 4;
+      default: return 0;
+    }
+  }
+
+  inline int componentCount(const std::string& type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    if (type == "MAT2") return 4;
+    if (type == "MAT3") return 9;
+    if (type == "MAT4") return 16;
+    return 0;
+  }
+
+  // typed window onto buffer memory: nothing is copied, reads go straight to the mapped file
+  struct AccessorView {
+    AccessorView() : data(nullptr), count(0), stride(0), components(0), component_type(ComponentType::FLOAT), normalized(false) {}
+
+    bool valid() const { return data != nullptr; }
+
+    // element i, component c, converted to float (normalized integers map to [0, 1] / [-1, 1])
+    float readFloat(size_t i, int c) const {
+      const char* p = data + i * stride + c * componentSize(component_type);
+      switch (component_type) {
+        case ComponentType::FLOAT: { float v; memcpy(&v, p, 4); return v; }
+        case ComponentType::UNSIGNED_BYTE: { uint8_t v; memcpy(&v, p, 1); return normalized ? v / 255.f : v; }
+        case ComponentType::BYTE: { int8_t v; memcpy(&v, p, 1); return normalized ? std::max(v / 127.f, -1.f) : v; }
+        case ComponentType::UNSIGNED_SHORT: { uint16_t v; memcpy(&v, p, 2); return normalized ? v / 65535.f : v; }
+        case ComponentType::SHORT: { int16_t v; memcpy(&v, p, 2); return normalized ? std::max(v / 32767.f, -1.f) : v; }
+        case ComponentType::UNSIGNED_INT: { uint32_t v; memcpy(&v, p, 4); return static_cast<float>(v); }
+        default: return 0.f;
+      }
+    }
+
+    uint32_t readIndex(size_t i) const {
+      const char* p = data + i * stride;
+      switch (component_type) {
+        case ComponentType::UNSIGNED_BYTE: { uint8_t v; memcpy(&v, p, 1); return v; }
+        case ComponentType::UNSIGNED_SHORT: { uint16_t v; memcpy(&v, p, 2); return v; }
+        case ComponentType::UNSIGNED_INT: { uint32_t v; memcpy(&v, p, 4); return v; }
+        default: return 0;
+      }
+    }
+
+    // direct pointer when the view is a tightly packed, aligned array of T
+    template <typename T>
+    const T* as() const {
+      if (stride != sizeof(T) || reinterpret_cast<uintptr_t>(data) % alignof(float) != 0) {
+        return nullptr;
+      }
+      return reinterpret_cast<const T*>(data);
+    }
+
+    const char* data;
+    size_t count;
+    size_t stride;
+    int components;
+    ComponentType component_type;
+    bool normalized;
+  };
+
+  struct Primitive {
+    Primitive() : attributes(), indices(-1), material(-1), mode(4) {}
+    std::vector<std::pair<std::string, int>> attributes; // semantic -> accessor
+    int indices;
+    int material;
+    int mode;
+
+    int attribute(const char* semantic) const {
+      for (const auto& a : attributes) {
+        if (a.first == semantic) return a.second;
+      }
+      return -1;
+    }
+  };
+
+  struct MeshDesc {
+    std::string name;
+    std::vector<Primitive> primitives;
+  };
+
+  // A loaded gltf/glb. buffers stay memory mapped for the lifetime of the asset and
+  // accessors are exposed as views into them.
+  class Asset {
+  public:
+    Asset() : json(), meshes(), base_dir(), files(), owned(), buffers() {}
+    Asset(const Asset&) = delete;
+    Asset& operator=(const Asset&) = delete;
+
+    AccessorView accessor(int index) const {
+      AccessorView view;
+      const JsonValue* accessors = json.find("accessors");
+      const JsonValue* views = json.find("bufferViews");
+      if (!accessors || index < 0 || static_cast<size_t>(index) >= accessors->size() || !views) {
+        return view;
+      }
+      const JsonValue& a = accessors->array[index];
+      int view_index = a.intOr("bufferView", -1);
+      if (view_index < 0 || static_cast<size_t>(view_index) >= views->size() || a.find("sparse")) {
+        return view; // sparse and zero-filled accessors are not supported
+      }
+      const JsonValue& bv = views->array[view_index];
+      int buffer = bv.intOr("buffer", -1);
+      if (buffer < 0 || static_cast<size_t>(buffer) >= buffers.size()) {
+        return view;
+      }
+
+      view.component_type = static_cast<ComponentType>(a.intOr("componentType", 0));
+      view.components = componentCount(a.stringOr("type", ""));
+      view.count = static_cast<size_t>(a.numberOr("count", 0));
+      view.normalized = a.find("normalized") && a.find("normalized")->boolean;
+      size_t element_size = componentSize(view.component_type) * view.components;
+      view.stride = static_cast<size_t>(bv.numberOr("byteStride", 0));
+      if (view.stride == 0) view.stride = element_size;
+
+      size_t offset = static_cast<size_t>(bv.numberOr("byteOffset", 0) + a.numberOr("byteOffset", 0));
+      size_t length = static_cast<size_t>(bv.numberOr("byteLength", 0));
+      size_t needed = view.count ? (view.count - 1) * view.stride + element_size : 0;
+      if (element_size == 0 || a.numberOr("byteOffset", 0) + needed > length || offset + needed > buffers[buffer].second) {
+        return AccessorView();
+      }
+      view.data = buffers[buffer].first + offset;
+      return view;
+    }
+
+    // bytes of the .gltf/.glb and its buffer files kept mapped, memory the heap does not see
+    size_t mapped_bytes() const {
+      size_t bytes = 0;
+      for (const auto& file : files) bytes += file->size();
+      return bytes;
+    }
+
+    JsonValue json;
+    std::vector<MeshDesc> meshes;
+    std::string base_dir;
+
+  private:
+    friend bool loadGltf(const std::string& path, Asset& asset);
+
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::vector<std::unique_ptr<std::vector<char>>> owned; // base64 decoded data: uri buffers (the json is parsed in place from the mapping)
+    std::vector<std::pair<const char*, size_t>> buffers;
+  };
+
+  // NOTE: sparse accessors, KHR extensions and embedded images are not handled.
+  bool loadGltf(const std::string& path, Asset& asset) {
+    bool is_glb = obj_loader::endsWith(path, ".glb");
+    if (!is_glb && !obj_loader::endsWith(path, ".gltf")) {
+      return false;
+    }
+
+    std::unique_ptr<MappedFile> file(new MappedFile(path));
+    if (!file->is_open()) {
+      return false;
+    }
+    asset.base_dir = obj_loader::splitDelims(path, "\\/").first;
+
+    const char* json_data = file->data();
+    size_t json_size = file->size();
+    const char* bin_data = nullptr;
+    size_t bin_size = 0;
+    if (is_glb) {
+      // header: magic, version, length, then chunks of (length, type, data)
+      uint32_t header[3];
+      if (file->size() < 20) return false;
+      memcpy(header, file->data(), sizeof(header));
+      if (header[0] != 0x46546C67 || header[1] != 2 || header[2] > file->size()) return false;
+      size_t offset = 12;
+      json_data = nullptr;
+      while (offset + 8 <= header[2]) {
+        uint32_t chunk[2];
+        memcpy(chunk, file->data() + offset, sizeof(chunk));
+        offset += 8;
+        if (offset + chunk[0] > header[2]) return false;
+        if (chunk[1] == 0x4E4F534A && !json_data) { json_data = file->data() + offset; json_size = chunk[0]; }
+        else if (chunk[1] == 0x004E4942 && !bin_data) { bin_data = file->data() + offset; bin_size = chunk[0]; }
+        offset += (chunk[0] + 3) & ~3u;
+      }
+      if (!json_data) return false;
+    }
+
+    if (!parseJson(json_data, json_size, asset.json) || asset.json.type != JsonValue::Type::OBJECT) {
+      return false;
+    }
+    asset.files.emplace_back(std::move(file));
+
+    // buffers: glb bin chunk, external files (mapped) or base64 data uris (decoded once)
+    const JsonValue* buffers = asset.json.find("buffers");
+    for (size_t i = 0; buffers && i < buffers->size(); i++) {
+      std::string uri = buffers->array[i].stringOr("uri", "");
+      if (uri.empty()) {
+        if (!bin_data) return false;
+        asset.buffers.emplace_back(bin_data, bin_size);
+      } else if (0 == uri.compare(0, 5, "data:")) {
+        size_t comma = uri.find(',');
+        if (comma == std::string::npos) return false;
+        std::unique_ptr<std::vector<char>> decoded(new std::vector<char>());
+        json_detail::decodeBase64(uri.data() + comma + 1, uri.data() + uri.size(), *decoded);
+        asset.buffers.emplace_back(decoded->data(), decoded->size());
+        asset.owned.emplace_back(std::move(decoded));
+      } else {
+        std::unique_ptr<MappedFile> bin(new MappedFile(asset.base_dir + uri));
+        if (!bin->is_open()) return false;
+        asset.buffers.emplace_back(bin->data(), bin->size());
+        asset.files.emplace_back(std::move(bin));
+      }
+    }
+
+    const JsonValue* meshes = asset.json.find("meshes");
+    for (size_t i = 0; meshes && i < meshes->size(); i++) {
+      const JsonValue& m = meshes->array[i];
+      MeshDesc desc;
+      desc.name = m.stringOr("name", "");
+      const JsonValue* primitives = m.find("primitives");
+      for (size_t k = 0; primitives && k < primitives->size(); k++) {
+        const JsonValue& p = primitives->array[k];
+        Primitive prim;
+        prim.indices = p.intOr("indices", -1);
+        prim.material = p.intOr("material", -1);
+        prim.mode = p.intOr("mode", 4);
+        const JsonValue* attributes = p.find("attributes");
+        if (attributes && attributes->type == JsonValue::Type::OBJECT) {
+          for (const auto& a : attributes->object) {
+            prim.attributes.emplace_back(a.first, static_cast<int>(a.second.number));
+          }
+        }
+        desc.primitives.emplace_back(std::move(prim));
+      }
+      asset.meshes.emplace_back(std::move(desc));
+    }
+
+    return true;
+  }
+
+  // Materializes the asset as an obj_loader::Scene, one Mesh per triangle primitive in mesh space.
+  inline bool toScene(const Asset& asset, obj_loader::Scene& scene, obj_loader::ParseOption option) {
+    using namespace obj_loader;
+    scene.base_dir = asset.base_dir;
+
+    const JsonValue* textures = asset.json.find("textures");
+    const JsonValue* images = asset.json.find("images");
+    const JsonValue* materials = asset.json.find("materials");
+    for (size_t i = 0; materials && i < materials->size(); i++) {
+      const JsonValue& m = materials->array[i];
+      Material material;
+      material.name = m.stringOr("name", "");
+      const JsonValue* pbr = m.find("pbrMetallicRoughness");
+      const JsonValue* factor = pbr ? pbr->find("baseColorFactor") : nullptr;
+      if (factor && factor->size() >= 3) {
+        material.diffuse = vec3((float)factor->array[0].number, (float)factor->array[1].number, (float)factor->array[2].number);
+        if (factor->size() >= 4) material.dissolve = (float)factor->array[3].number;
+      }
+      const JsonValue* base_color = pbr ? pbr->find("baseColorTexture") : nullptr;
+      int texture = base_color ? base_color->intOr("index", -1) : -1;
+      if (texture >= 0 && textures && static_cast<size_t>(texture) < textures->size()) {
+        int source = textures->array[texture].intOr("source", -1);
+        if (source >= 0 && images && static_cast<size_t>(source) < images->size()) {
+          Texture diffuse;
+          diffuse.name = images->array[source].stringOr("uri", "");
+          if (!diffuse.name.empty()) {
+            material.texture_map.insert(std::make_pair(TextureType::DIFFUSE, diffuse));
+          }
+        }
+      }
+      scene.materials.emplace_back(material);
+    }
+
+    for (const MeshDesc& desc : asset.meshes) {
+      for (size_t k = 0; k < desc.primitives.size(); k++) {
+        const Primitive& prim = desc.primitives[k];
+        AccessorView positions = asset.accessor(prim.attribute("POSITION"));
+        if (prim.mode != 4 || !positions.valid() || positions.components != 3) {
+          continue;
+        }
+        AccessorView normals = asset.accessor(prim.attribute("NORMAL"));
+        AccessorView uvs = asset.accessor(prim.attribute("TEXCOORD_0"));
+        AccessorView indices = asset.accessor(prim.indices);
+
+        Mesh mesh;
+        mesh.name = desc.primitives.size() > 1 ? desc.name + "_" + std::to_string(k) : desc.name;
+        mesh.material_id = prim.material;
+        mesh.vertices.resize(positions.count);
+
+        const vec3* packed = positions.as<vec3>();
+        for (size_t i = 0; i < positions.count; i++) {
+          Vertex& v = mesh.vertices[i];
+          v.position = packed ? packed[i] : vec3(positions.readFloat(i, 0), positions.readFloat(i, 1), positions.readFloat(i, 2));
+          mesh.bounds.expand(v.position);
+        }
+        if (normals.valid() && normals.count == positions.count && normals.components == 3) {
+          for (size_t i = 0; i < normals.count; i++) {
+            mesh.vertices[i].normal = vec3(normals.readFloat(i, 0), normals.readFloat(i, 1), normals.readFloat(i, 2));
+          }
+        }
+        if (uvs.valid() && uvs.count == positions.count && uvs.components == 2) {
+          bool flip = option & ParseOption::FLIP_UV;
+          for (size_t i = 0; i < uvs.count; i++) {
+            float v = uvs.readFloat(i, 1);
+            mesh.vertices[i].texcoord = vec2(uvs.readFloat(i, 0), flip ? 1.f - v : v);
+          }
+        }
+
+        if (indices.valid()) {
+          mesh.indices.resize(indices.count);
+          for (size_t i = 0; i < indices.count; i++) {
+            uint32_t idx = indices.readIndex(i);
+            if (idx >= positions.count) return false;
+            mesh.indices[i] = idx;
+          }
+        } else {
+          mesh.indices.resize(positions.count);
+          for (size_t i = 0; i < positions.count; i++) mesh.indices[i] = static_cast<unsigned int>(i);
+        }
+
+        scene.bounds.merge(mesh.bounds);
+        scene.meshes.emplace_back(std::move(mesh));
+      }
+    }
+
+    internTextures(scene);
+    return true;
+  }
+}
+
+#endif //MODEL_LOAD_GLTF_LOADER_H
@@ -0,0 +1,315 @@
+#ifndef MODEL_LOAD_HOT_RELOAD_H
+#define MODEL_LOAD_HOT_RELOAD_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "obj_loader.h"
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace obj_loader {
+  // Watches loaded obj files and their mtl libraries and re-parses only what changed on a background thread:
+  // an edited obj is loaded again, an edited mtl only replaces the materials of the scenes using it.
+  // New snapshots are published with an atomic pointer swap, readers never wait for a reload.
+  // NOTE: call watch for every file before start. without inotify, files are polled by mtime.
+  class HotReloader {
+  public:
+    // what readers see of a watched file. the geometry is shared by every snapshot until the obj itself changes,
+    // an mtl edit publishes new materials next to the same scene instead of copying its meshes.
+    struct Snapshot {
+      std::shared_ptr<const Scene> scene; // scene->materials and mesh material ids are those of the last obj load
+      std::vector<Material> materials;
+      std::vector<std::string> textures;
+      std::vector<int> material_ids; // per mesh of scene, index into materials or -1
+    };
+
+    // called on the reload thread right after a snapshot was swapped in
+    typedef std::function<void(size_t id, const std::shared_ptr<const Snapshot>& snapshot)> Listener;
+
+    HotReloader() : entries(), dir_watches(), listener(), thread(), running(false), notify_fd(-1) {
+      wake_fds[0] = wake_fds[1] = -1;
+#ifdef __linux__
+      notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (pipe(wake_fds) != 0) {
+        wake_fds[0] = wake_fds[1] = -1;
+      }
+#endif
+    }
+
+    ~HotReloader() {
+      stop();
+#ifdef __linux__
+      if (notify_fd >= 0) close(notify_fd);
+      if (wake_fds[0] >= 0) close(wake_fds[0]);
+      if (wake_fds[1] >= 0) close(wake_fds[1]);
+#endif
+    }
+
+    HotReloader(const HotReloader&) = delete;
+    HotReloader& operator=(const HotReloader&) = delete;
+
+    // loads the file once and watches it and its mtl libraries from then on
+    bool watch(const std::string& path, ParseOption parse_option, size_t& id) {
+      std::unique_ptr<Entry> entry(new Entry());
+      entry->path = path;
+      entry->parse_option = parse_option;
+      entry->version = 0;
+      std::shared_ptr<Scene> scene = std::make_shared<Scene>();
+      if (!loadObj(path, *scene, parse_option)) {
+        return false;
+      }
+      entry->snapshot = makeSnapshot(scene);
+      if (!track(*entry, *scene)) {
+        return false;
+      }
+      id = entries.size();
+      entries.emplace_back(std::move(entry));
+      return true;
+    }
+
+    std::shared_ptr<const Snapshot> snapshot(size_t id) const {
+      return std::atomic_load(&entries[id]->snapshot);
+    }
+
+    // number of reloads published for the file so far
+    size_t version(size_t id) const {
+      return entries[id]->version.load();
+    }
+
+    void setListener(Listener fn) { listener = std::move(fn); }
+
+    bool start() {
+      if (running) {
+        return true;
+      }
+      running = true;
+      thread = std::thread([this] { run(); });
+      return true;
+    }
+
+    void stop() {
+      if (!running) {
+        return;
+      }
+      running = false;
+#ifdef __linux__
+      if (wake_fds[1] >= 0) {
+        char c = 0;
+        ssize_t written = write(wake_fds[1], &c, 1);
+        (void)written;
+      }
+#endif
+      thread.join();
+    }
+
+  private:
+    struct Entry {
+      std::string path;
+      ParseOption parse_option;
+      std::string canonical;
+      long long mtime;
+      std::vector<std::pair<std::string, long long>> libraries; // canonical mtl path, mtime
+      std::shared_ptr<const Snapshot> snapshot;
+      std::atomic<size_t> version;
+    };
+
+    static std::shared_ptr<const Snapshot> makeSnapshot(const std::shared_ptr<const Scene>& scene) {
+      std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+      snapshot->scene = scene;
+      snapshot->materials = scene->materials;
+      snapshot->textures = scene->textures;
+      snapshot->material_ids.reserve(scene->meshes.size());
+      for (const Mesh& mesh : scene->meshes) {
+        snapshot->material_ids.push_back(mesh.material_id);
+      }
+      return snapshot;
+    }
+
+    // refreshes the canonical paths of the obj and its libraries and makes sure their directories are watched
+    bool track(Entry& entry, const Scene& scene) {
+      if (!canonicalPath(entry.path, entry.canonical, entry.mtime)) {
+        return false;
+      }
+      entry.libraries.clear();
+      for (const std::string& lib : scene.material_libraries) {
+        std::pair<std::string, long long> library;
+        if (canonicalPath(lib, library.first, library.second)) {
+          entry.libraries.emplace_back(library);
+        }
+      }
+#ifdef __linux__
+      if (notify_fd >= 0) {
+        watchDirectory(splitDelims(entry.canonical, "/").first);
+        for (const auto& lib : entry.libraries) {
+          watchDirectory(splitDelims(lib.first, "/").first);
+        }
+      }
+#endif
+      return true;
+    }
+
+#ifdef __linux__
+    void watchDirectory(const std::string& dir) {
+      for (const auto& it : dir_watches) {
+        if (it.second == dir) return;
+      }
+      // editors either rewrite in place (close after write) or write a temporary and rename it over
+      int wd = inotify_add_watch(notify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+      if (wd >= 0) {
+        dir_watches.insert(std::make_pair(wd, dir));
+      }
+    }
+
+    // blocks until something changed, returns the canonical paths of the changed files
+    bool waitChanges(std::vector<std::string>& changed) {
+      pollfd fds[2] = {{notify_fd, POLLIN, 0}, {wake_fds[0], POLLIN, 0}};
+      if (poll(fds, 2, -1) <= 0) {
+        return false;
+      }
+      if (fds[1].revents & POLLIN) {
+        char c;
+        ssize_t drained = read(wake_fds[0], &c, 1); // the stop request, consumed so a later start blocks again
+        (void)drained;
+        return false;
+      }
+      alignas(inotify_event) char buf[16 * 1024];
+      bool overflow = false;
+      for (;;) {
+        ssize_t len = read(notify_fd, buf, sizeof(buf));
+        if (len <= 0) {
+          break;
+        }
+        for (char* p = buf; p < buf + len;) {
+          const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+          overflow = overflow || (event->mask & IN_Q_OVERFLOW);
+          auto it = dir_watches.find(event->wd);
+          if (it != dir_watches.end() && event->len > 0) {
+            changed.emplace_back(it->second + event->name);
+          }
+          p += sizeof(inotify_event) + event->len;
+        }
+      }
+      if (overflow) {
+        scanChanges(changed); // the kernel queue dropped events, fall back to comparing modification times
+      }
+      return true;
+    }
+#endif
+
+    // fallback without inotify: compare modification times
+    void pollChanges(std::vector<std::string>& changed) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      scanChanges(changed);
+    }
+
+    void scanChanges(std::vector<std::string>& changed) {
+      for (const auto& entry : entries) {
+        std::string canonical;
+        long long mtime = 0;
+        if (canonicalPath(entry->canonical, canonical, mtime) && mtime != entry->mtime) {
+          changed.emplace_back(canonical);
+        }
+        for (const auto& lib : entry->libraries) {
+          if (canonicalPath(lib.first, canonical, mtime) && mtime != lib.second) {
+            changed.emplace_back(canonical);
+          }
+        }
+      }
+    }
+
+    void run() {
+      while (running) {
+        std::vector<std::string> changed;
+#ifdef __linux__
+        if (notify_fd >= 0 && wake_fds[0] >= 0) {
+          if (!waitChanges(changed)) continue;
+        } else {
+          pollChanges(changed);
+        }
+#else
+        pollChanges(changed);
+#endif
+        if (changed.empty()) {
+          continue;
+        }
+        auto is_changed = [&changed](const std::string& path) {
+          for (const std::string& c : changed) {
+            if (c == path) return true;
+          }
+          return false;
+        };
+
+        for (size_t id = 0; id < entries.size() && running; id++) {
+          Entry& entry = *entries[id];
+          std::shared_ptr<const Snapshot> published;
+          if (is_changed(entry.canonical)) {
+            std::shared_ptr<Scene> scene = std::make_shared<Scene>();
+            if (!loadObj(entry.path, *scene, entry.parse_option)) {
+              continue; // keep the last good scene, a half written file usually gets a second event
+            }
+            published = makeSnapshot(scene);
+          } else {
+            bool library_changed = false;
+            for (const auto& lib : entry.libraries) {
+              library_changed = library_changed || is_changed(lib.first);
+            }
+            if (!library_changed) {
+              continue;
+            }
+            std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>(*std::atomic_load(&entry.snapshot));
+            reloadMaterials(*snapshot);
+            published = snapshot;
+          }
+
+          track(entry, *published->scene);
+          std::atomic_store(&entry.snapshot, published);
+          entry.version++;
+          if (listener) {
+            listener(id, published);
+          }
+        }
+      }
+    }
+
+    // re-reads the libraries of the snapshot's scene and remaps the material ids by material name.
+    // only the materials are rebuilt, the scene itself is shared with the previous snapshot
+    static void reloadMaterials(Snapshot& snapshot) {
+      const Scene& scene = *snapshot.scene;
+      Scene materials; // just the parts internTextures reads and writes
+      materials.base_dir = scene.base_dir;
+      std::unordered_map<std::string, int> material_map;
+      for (const std::string& lib : scene.material_libraries) {
+        parseMtl(lib, materials.materials, material_map);
+      }
+      for (int& material_id : snapshot.material_ids) {
+        if (material_id < 0 || static_cast<size_t>(material_id) >= snapshot.materials.size()) {
+          continue;
+        }
+        auto it = material_map.find(snapshot.materials[material_id].name);
+        material_id = it == material_map.end() ? -1 : it->second;
+      }
+      internTextures(materials);
+      snapshot.materials.swap(materials.materials);
+      snapshot.textures.swap(materials.textures);
+    }
+
+    std::vector<std::unique_ptr<Entry>> entries;
+    std::unordered_map<int, std::string> dir_watches; // inotify watch descriptor -> directory with trailing slash
+    Listener listener;
+    std::thread thread;
+    std::atomic<bool> running;
+    int notify_fd;
+    int wake_fds[2];
+  };
+}
+
+#endif //MODEL_LOAD_HOT_RELOAD_H
@@ -14,6 +14,182 @@
 #ifdef MY_PROFILE
 #include "obj_loader.h"
 #endif
+#ifdef LOD_PROFILE
+#include "mesh_simplify.h"
+#endif
+#ifdef PRESCAN_PROFILE
+#include <cstdio>
+#include "obj_loader.h"
+#endif
+#ifdef MTL_CACHE_PROFILE
+#include "obj_loader.h"
+#endif
+#ifdef FORMAT_PROFILE
+#include <cstdio>
+#include "assimp_loader.h"
+#include "obj_loader.h"
+#include "stl_loader.h"
+#include "ply_loader.h"
+#endif
+#ifdef SCENE_PROFILE
+#include "assimp_loader.h"
+#include "thread_pool.h"
+#endif
+#ifdef POSTPROCESS_PROFILE
+#include "assimp_loader.h"
+#include "mesh_weld.h"
+#include "obj_loader.h"
+#endif
+#ifdef ARENA_PROFILE
+#include <cstdlib>
+#include "arena.h"
+#include "obj_loader.h"
+#endif
+#ifdef GLTF_PROFILE
+#include <cstdio>
+#include <cstdlib>
+#include "assimp_loader.h"
+#include "obj_loader.h"
+#include "gltf_loader.h"
+#endif
+
+#ifdef COMPRESS_PROFILE
+#include <cstdio>
+#include "obj_loader.h"
+#endif
+#ifdef LAYOUT_PROFILE
+#include "obj_loader.h"
+#endif
+#ifdef SPECIALIZE_PROFILE
+#include "obj_loader.h"
+#endif
+#ifdef KEYWORD_PROFILE
+#include <cstdio>
+#include "obj_loader.h"
+#endif
+#ifdef DEDUP_PROFILE
+#include "mesh_cache.h"
+#endif
+#ifdef MERGE_PROFILE
+#include "obj_loader.h"
+#endif
+#ifdef WELD_PROFILE
+#include "mesh_weld.h"
+#include "thread_pool.h"
+#endif
+#ifdef LARGE_PROFILE
+#include <cstdio>
+#include "obj_loader.h"
+#endif
+#ifdef ROUNDTRIP_PROFILE
+#include <fstream>
+#include <iomanip>
+#include "obj_writer.h"
+#include "thread_pool.h"
+#endif
+#ifdef TEXTURE_PROFILE
+#include <sys/stat.h>
+#include "texture_loader.h"
+#include "thread_pool.h"
+#endif
+#ifdef IO_BATCH_PROFILE
+#include <fcntl.h>
+#include <unistd.h>
+#include "batch_reader.h"
+#include "thread_pool.h"
+#endif
+#ifdef TRACE_PROFILE
+#include <fstream>
+#include "bvh.h"
+#include "mesh_weld.h"
+#include "thread_pool.h"
+#include "trace.h"
+#endif
+#ifdef BVH_PROFILE
+#include "bvh.h"
+#include "thread_pool.h"
+#endif
+#ifdef LAZY_PROFILE
+#include "obj_index.h"
+#include "thread_pool.h"
+#endif
+#ifdef HOT_RELOAD_PROFILE
+#include <condition_variable>
+#include <cstdio>
+#include "hot_reload.h"
+#endif
+
+#if defined(ARENA_PROFILE) || defined(GLTF_PROFILE)
+#include <atomic>
+#include <new>
+// count every global heap allocation so the arena mode can be compared against default vector growth,
+// and track live bytes so loaders can be compared by peak heap usage
+std::atomic<size_t> heap_allocation_count(0);
+std::atomic<size_t> heap_live_bytes(0);
+std::atomic<size_t> heap_peak_bytes(0);
+
+static const size_t heap_header_size = 16; // keeps the returned pointer max aligned
+
+// every replaced new/delete routes through these two so the size header is read back by the same code
+// that wrote it, and the counters stay consistent when the benchmark's thread pools allocate concurrently
+static void* heap_counted_alloc(size_t size) {
+  heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+  char* p = static_cast<char*>(std::malloc(size + heap_header_size));
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  memcpy(p, &size, sizeof(size));
+  size_t live = heap_live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  size_t peak = heap_peak_bytes.load(std::memory_order_relaxed);
+  while (live > peak && !heap_peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+  }
+  return p + heap_header_size;
+}
+
+static void heap_counted_free(void* p) noexcept {
+  if (!p) {
+    return;
+  }
+  char* base = static_cast<char*>(p) - heap_header_size;
+  size_t size;
+  memcpy(&size, base, sizeof(size));
+  heap_live_bytes.fetch_sub(size, std::memory_order_relaxed);
+  std::free(base);
+}
+
+void* operator new(size_t size) {
+  return heap_counted_alloc(size);
+}
+
+void* operator new[](size_t size) {
+  return heap_counted_alloc(size);
+}
+
+void operator delete(void* p) noexcept {
+  heap_counted_free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  heap_counted_free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  heap_counted_free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  heap_counted_free(p);
+}
+
+// peak bytes allocated on top of what was live when the measurement started
+struct heap_peak_scope {
+  heap_peak_scope() : base(heap_live_bytes.load(std::memory_order_relaxed)) {
+    heap_peak_bytes.store(base, std::memory_order_relaxed);
+  }
+  size_t peak() const { return heap_peak_bytes.load(std::memory_order_relaxed) - base; }
+  size_t base;
+};
+#endif
 
 /*
 obj, fbx, blend, gltf, ply, stl, dae, 3ds
@@ -33,6 +209,20 @@ void log_mesh_profile(const std::string& name, std::vector<mesh*>& mesh, bool re
 }
 #endif
 
+#ifdef ASSIMP_PROFILE
+void log_mesh_profile(const std::string& name, const flat_model& model, bool res, float elapsed, bool verbos) {
+  std::cout << "## mesh (" << name << "): " << model.meshes.size() << std::boolalpha << " (" << res << ")" << '\n';
+  std::cout << std::tab << "time: " << elapsed << "ms" << '\n';
+  if (verbos) {
+    for (const auto& m : model.meshes) {
+      printf("mesh name: %s\n", m.name.c_str());
+      printf("verts size: %u\n", m.vertex_count);
+      printf("indices size: %u\n", m.index_count);
+    }
+  }
+}
+#endif
+
 #ifdef TBJ_PROFILE
 void log_mesh_profile(const std::string& name, std::vector<tinyobj::shape_t>& sh, bool res, float elapsed, bool verbos) {
   std::cout << "## mesh (" << name << "): " << sh.size() << std::boolalpha << " (" << res << ")" << '\n';
@@ -62,12 +252,589 @@ void log_mesh_profile(const std::string& name, const obj_loader::Scene& scene, b
   std::cout << "## mesh (" << name << "): " << scene.meshes.size() << std::boolalpha << " (" << res << ")" << '\n';
 //  std::cout << std::tab << "time: " << elapsed << "ms" << '\n';
   if (verbos) {
+    printf("scene radius: %f\n", scene.bounds.radius);
     for (const auto& m : scene.meshes) {
       printf("mesh name: %s\n", m.name.c_str());
       printf("verts size: %ld\n", m.vertices.size());
       printf("indices size: %ld\n", m.indices.size());
+      printf("bounds: (%f, %f, %f) - (%f, %f, %f)\n", m.bounds.aabb_min.x, m.bounds.aabb_min.y, m.bounds.aabb_min.z,
+             m.bounds.aabb_max.x, m.bounds.aabb_max.y, m.bounds.aabb_max.z);
+    }
+  }
+}
+#endif
+
+#ifdef LOD_PROFILE
+void log_lod_profile(const std::string& name, size_t triangles, const std::vector<obj_loader::LodLevel>& lods, float elapsed) {
+  std::cout << "## lod (" << name << "): " << triangles << " tris ->";
+  for (const auto& lod : lods) {
+    std::cout << " " << lod.indices.size() / 3;
+  }
+  std::cout << '\n';
+  std::cout << std::tab << "time: " << elapsed << "ms, " << (elapsed > 0.f ? triangles / elapsed * 1000.f : 0.f) << " tris/s" << '\n';
+}
+
+// uv sphere standing in for a dense scan, seam along u = 0 and poles as degenerate fans
+obj_loader::Mesh make_dense_sphere(unsigned int rings, unsigned int segments) {
+  obj_loader::Mesh mesh;
+  mesh.name = "dense_sphere";
+  mesh.vertices.reserve((rings + 1) * (segments + 1));
+  for (unsigned int r = 0; r <= rings; r++) {
+    float theta = 3.14159265f * r / rings;
+    for (unsigned int s = 0; s <= segments; s++) {
+      float phi = 2.f * 3.14159265f * (s == segments ? 0 : s) / segments;
+      obj_loader::Vertex vtx;
+      vtx.normal = vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+      vtx.position = vtx.normal;
+      vtx.texcoord = vec2((float)s / segments, (float)r / rings);
+      mesh.vertices.emplace_back(vtx);
+    }
+  }
+  mesh.indices.reserve(rings * segments * 6);
+  for (unsigned int r = 0; r < rings; r++) {
+    for (unsigned int s = 0; s < segments; s++) {
+      unsigned int i0 = r * (segments + 1) + s, i1 = i0 + 1, i2 = i0 + segments + 1, i3 = i2 + 1;
+      if (r != 0) {
+        mesh.indices.push_back(i0); mesh.indices.push_back(i1); mesh.indices.push_back(i2);
+      }
+      if (r != rings - 1) {
+        mesh.indices.push_back(i1); mesh.indices.push_back(i3); mesh.indices.push_back(i2);
+      }
+    }
+  }
+  return mesh;
+}
+#endif
+
+#ifdef PRESCAN_PROFILE
+// writes a smooth n x n quad grid split into triangles, with texcoords and normals
+bool write_grid_obj(const std::string& path, unsigned int n) {
+  FILE* fp = fopen(path.c_str(), "w");
+  if (!fp) {
+    return false;
+  }
+  fprintf(fp, "o grid\n");
+  for (unsigned int y = 0; y <= n; y++) {
+    for (unsigned int x = 0; x <= n; x++) {
+      fprintf(fp, "v %f %f %f\n", (float)x / n, std::sin(x * 0.1f) * std::cos(y * 0.1f) * 0.05f, (float)y / n);
+    }
+  }
+  for (unsigned int y = 0; y <= n; y++) {
+    for (unsigned int x = 0; x <= n; x++) {
+      fprintf(fp, "vt %f %f\n", (float)x / n, (float)y / n);
+    }
+  }
+  for (unsigned int y = 0; y <= n; y++) {
+    for (unsigned int x = 0; x <= n; x++) {
+      fprintf(fp, "vn 0.000000 1.000000 0.000000\n");
+    }
+  }
+  for (unsigned int y = 0; y < n; y++) {
+    for (unsigned int x = 0; x < n; x++) {
+      unsigned int i0 = y * (n + 1) + x + 1, i1 = i0 + 1, i2 = i0 + n + 1, i3 = i2 + 1;
+      fprintf(fp, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", i0, i0, i0, i2, i2, i2, i1, i1, i1);
+      fprintf(fp, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", i1, i1, i1, i2, i2, i2, i3, i3, i3);
+    }
+  }
+  fclose(fp);
+  return true;
+}
+#endif
+
+#ifdef POSTPROCESS_PROFILE
+// one row of the post-process matrix, spelled out for every loader.
+// a loader without an equivalent step runs without it and is marked with '*'.
+struct post_process_setting {
+  const char* name;
+  unsigned int assimp_flags;
+  obj_loader::ParseOption obj_option;
+  bool obj_weld; // weldVertices after the load, for JoinIdenticalVertices
+  bool tinyobj_triangulate;
+  bool tinyobj_exact;
+};
+
+std::vector<post_process_setting> post_process_matrix() {
+  const unsigned int base = aiProcess_Triangulate | aiProcess_FlipUVs;
+  const obj_loader::ParseOption obj_base = obj_loader::ParseOption::TRIANGULATE | obj_loader::ParseOption::FLIP_UV;
+  return {
+    {"triangulate | flip uv", base, obj_base, false, true, true},
+    {"+ tangent space", base | aiProcess_CalcTangentSpace, obj_base | obj_loader::ParseOption::CALC_TANGENT, false, true, false},
+    {"+ join identical vertices", base | aiProcess_JoinIdenticalVertices, obj_base, true, true, false},
+    {"+ optimize meshes", base | aiProcess_OptimizeMeshes, obj_base | obj_loader::ParseOption::MERGE_MATERIALS, false, true, false},
+  };
+}
+#endif
+
+#ifdef FORMAT_PROFILE
+// converters producing the stl/ply inputs of the format matrix from loaded obj scenes
+
+bool write_stl(const obj_loader::Scene& scene, const std::string& path) {
+  FILE* fp = fopen(path.c_str(), "wb");
+  if (!fp) {
+    return false;
+  }
+  char header[80] = "model-load benchmark";
+  uint32_t count = 0;
+  for (const auto& m : scene.meshes) count += (uint32_t)(m.indices.size() / 3);
+  fwrite(header, 1, sizeof(header), fp);
+  fwrite(&count, sizeof(count), 1, fp);
+  for (const auto& m : scene.meshes) {
+    for (size_t i = 0; i + 2 < m.indices.size(); i += 3) {
+      float record[12];
+      const vec3& n = m.vertices[m.indices[i]].normal;
+      record[0] = n.x; record[1] = n.y; record[2] = n.z;
+      for (int k = 0; k < 3; k++) {
+        const vec3& p = m.vertices[m.indices[i + k]].position;
+        record[3 + k * 3] = p.x; record[4 + k * 3] = p.y; record[5 + k * 3] = p.z;
+      }
+      uint16_t attribute = 0;
+      fwrite(record, sizeof(record), 1, fp);
+      fwrite(&attribute, sizeof(attribute), 1, fp);
+    }
+  }
+  fclose(fp);
+  return true;
+}
+
+bool write_ply(const obj_loader::Scene& scene, const std::string& path, bool binary) {
+  FILE* fp = fopen(path.c_str(), "wb");
+  if (!fp) {
+    return false;
+  }
+  size_t vertex_count = 0, face_count = 0;
+  for (const auto& m : scene.meshes) {
+    vertex_count += m.vertices.size();
+    face_count += m.indices.size() / 3;
+  }
+  fprintf(fp, "ply\nformat %s 1.0\nelement vertex %zu\n", binary ? "binary_little_endian" : "ascii", vertex_count);
+  fprintf(fp, "property float x\nproperty float y\nproperty float z\nproperty float nx\nproperty float ny\nproperty float nz\n");
+  fprintf(fp, "property float s\nproperty float t\nelement face %zu\nproperty list uchar int vertex_indices\nend_header\n", face_count);
+  for (const auto& m : scene.meshes) {
+    for (const auto& v : m.vertices) {
+      float record[8] = {v.position.x, v.position.y, v.position.z, v.normal.x, v.normal.y, v.normal.z, v.texcoord.x, v.texcoord.y};
+      if (binary) {
+        fwrite(record, sizeof(record), 1, fp);
+      } else {
+        fprintf(fp, "%g %g %g %g %g %g %g %g\n", record[0], record[1], record[2], record[3], record[4], record[5], record[6], record[7]);
+      }
+    }
+  }
+  int base = 0;
+  for (const auto& m : scene.meshes) {
+    for (size_t i = 0; i + 2 < m.indices.size(); i += 3) {
+      int face[3] = {base + (int)m.indices[i], base + (int)m.indices[i + 1], base + (int)m.indices[i + 2]};
+      if (binary) {
+        unsigned char n = 3;
+        fwrite(&n, 1, 1, fp);
+        fwrite(face, sizeof(face), 1, fp);
+      } else {
+        fprintf(fp, "3 %d %d %d\n", face[0], face[1], face[2]);
+      }
+    }
+    base += (int)m.vertices.size();
+  }
+  fclose(fp);
+  return true;
+}
+#endif
+
+#ifdef GLTF_PROFILE
+// writes the scene as a single buffer glb: interleaved-free position/normal/texcoord streams and uint32 indices
+bool write_glb(const obj_loader::Scene& scene, const std::string& path) {
+  std::string bin;
+  std::string views, accessors, meshes, nodes;
+  auto append = [&bin](const void* data, size_t size) {
+    size_t offset = bin.size();
+    bin.append(static_cast<const char*>(data), size);
+    bin.resize((bin.size() + 3) & ~size_t(3));
+    return offset;
+  };
+  auto add_view = [&](size_t offset, size_t size, int target) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":%d}",
+             views.empty() ? "" : ",", offset, size, target);
+    views += buf;
+  };
+  int accessor = 0;
+  for (size_t i = 0; i < scene.meshes.size(); i++) {
+    const auto& m = scene.meshes[i];
+    if (m.vertices.empty() || m.indices.empty()) {
+      continue;
+    }
+    std::vector<float> positions, normals, texcoords;
+    for (const auto& v : m.vertices) {
+      positions.insert(positions.end(), {v.position.x, v.position.y, v.position.z});
+      normals.insert(normals.end(), {v.normal.x, v.normal.y, v.normal.z});
+      texcoords.insert(texcoords.end(), {v.texcoord.x, v.texcoord.y});
+    }
+    add_view(append(positions.data(), positions.size() * 4), positions.size() * 4, 34962);
+    add_view(append(normals.data(), normals.size() * 4), normals.size() * 4, 34962);
+    add_view(append(texcoords.data(), texcoords.size() * 4), texcoords.size() * 4, 34962);
+    add_view(append(m.indices.data(), m.indices.size() * 4), m.indices.size() * 4, 34963);
+
+    char buf[512];
+    const auto& b = m.bounds;
+    snprintf(buf, sizeof(buf),
+             "%s{\"bufferView\":%d,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\",\"min\":[%g,%g,%g],\"max\":[%g,%g,%g]},"
+             "{\"bufferView\":%d,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},"
+             "{\"bufferView\":%d,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC2\"},"
+             "{\"bufferView\":%d,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}",
+             accessors.empty() ? "" : ",", accessor, m.vertices.size(), b.aabb_min.x, b.aabb_min.y, b.aabb_min.z,
+             b.aabb_max.x, b.aabb_max.y, b.aabb_max.z, accessor + 1, m.vertices.size(), accessor + 2, m.vertices.size(),
+             accessor + 3, m.indices.size());
+    accessors += buf;
+    snprintf(buf, sizeof(buf),
+             "%s{\"primitives\":[{\"attributes\":{\"POSITION\":%d,\"NORMAL\":%d,\"TEXCOORD_0\":%d},\"indices\":%d}]}",
+             meshes.empty() ? "" : ",", accessor, accessor + 1, accessor + 2, accessor + 3);
+    meshes += buf;
+    snprintf(buf, sizeof(buf), "%s{\"mesh\":%d}", nodes.empty() ? "" : ",", accessor / 4);
+    nodes += buf;
+    accessor += 4;
+  }
+  if (nodes.empty()) {
+    return false;
+  }
+
+  std::string scene_nodes;
+  for (int i = 0; i < accessor / 4; i++) {
+    scene_nodes += (i ? "," : "") + std::to_string(i);
+  }
+  std::string json = "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[" + scene_nodes + "]}],"
+    "\"nodes\":[" + nodes + "],\"meshes\":[" + meshes + "],\"accessors\":[" + accessors + "],"
+    "\"bufferViews\":[" + views + "],\"buffers\":[{\"byteLength\":" + std::to_string(bin.size()) + "}]}";
+  json.resize((json.size() + 3) & ~size_t(3), ' ');
+
+  FILE* fp = fopen(path.c_str(), "wb");
+  if (!fp) {
+    return false;
+  }
+  uint32_t header[3] = {0x46546C67, 2, (uint32_t)(12 + 8 + json.size() + 8 + bin.size())};
+  uint32_t json_chunk[2] = {(uint32_t)json.size(), 0x4E4F534A};
+  uint32_t bin_chunk[2] = {(uint32_t)bin.size(), 0x004E4942};
+  fwrite(header, sizeof(header), 1, fp);
+  fwrite(json_chunk, sizeof(json_chunk), 1, fp);
+  fwrite(json.data(), 1, json.size(), fp);
+  fwrite(bin_chunk, sizeof(bin_chunk), 1, fp);
+  fwrite(bin.data(), 1, bin.size(), fp);
+  fclose(fp);
+  return true;
+}
+#endif
+
+#ifdef KEYWORD_PROFILE
+// a material library exercising every mtl statement, count materials of 22 lines each
+size_t write_keyword_mtl(const std::string& path, int count) {
+  FILE* fp = fopen(path.c_str(), "wb");
+  if (!fp) {
+    return 0;
+  }
+  for (int i = 0; i < count; i++) {
+    fprintf(fp, "newmtl material_%d\nKa 0.1 0.1 0.1\nKd 0.6 0.5 0.4\nKs 0.2 0.2 0.2\nKe 0 0 0\nKt 0 0 0\nTf 1 1 1\n", i);
+    fprintf(fp, "Ni 1.45\nNs 32\nillum 2\nd 1\nTr 0\nmap_Ka ambient_%d.png\nmap_Kd -s 1 1 1 diffuse_%d.png\n", i, i);
+    fprintf(fp, "map_Ks specular_%d.png\nmap_Ns gloss_%d.png\nmap_bump -bm 0.5 normal_%d.png\nbump normal_%d.png\n", i, i, i, i);
+    fprintf(fp, "map_d alpha_%d.png\ndisp height_%d.png\nrefl -type sphere env_%d.png\n# end of material %d\n", i, i, i, i);
+  }
+  fclose(fp);
+  return (size_t)count * 22;
+}
+
+// the if chain obj_loader::objKeyword replaced, tests every keyword in turn
+obj_loader::ObjKeyword obj_keyword_chain(const char* token) {
+  if (token[0] == 'v' && obj_loader::is_space(token[1])) return obj_loader::ObjKeyword::VERTEX;
+  if (token[0] == 'v' && token[1] == 'n' && obj_loader::is_space(token[2])) return obj_loader::ObjKeyword::NORMAL;
+  if (token[0] == 'v' && token[1] == 't' && obj_loader::is_space(token[2])) return obj_loader::ObjKeyword::TEXCOORD;
+  if (token[0] == 'f' && obj_loader::is_space(token[1])) return obj_loader::ObjKeyword::FACE;
+  if (0 == strncmp(token, "usemtl", 6) && obj_loader::is_space(token[6])) return obj_loader::ObjKeyword::USEMTL;
+  if (0 == strncmp(token, "mtllib", 6) && obj_loader::is_space(token[6])) return obj_loader::ObjKeyword::MTLLIB;
+  if (token[0] == 'g' && obj_loader::is_space(token[1])) return obj_loader::ObjKeyword::GROUP;
+  if (token[0] == 'o' && obj_loader::is_space(token[1])) return obj_loader::ObjKeyword::OBJECT;
+  return obj_loader::ObjKeyword::UNKNOWN;
+}
+
+// the strncmp chain obj_loader::mtlKeyword replaced, in the order loadMtl used to test them
+obj_loader::MtlKeyword mtl_keyword_chain(const char* token) {
+  if (0 == strncmp(token, "newmtl", 6) && obj_loader::is_space(token[6])) return obj_loader::MtlKeyword::NEWMTL;
+  if (token[0] == 'K' && token[1] == 'a' && obj_loader::is_space(token[2])) return obj_loader::MtlKeyword::KA;
+  if (token[0] == 'K' && token[1] == 'd' && obj_loader::is_space(token[2])) return obj_loader::MtlKeyword::KD;
+  if (token[0] == 'K' && token[1] == 's' && obj_loader::is_space(token[2])) return obj_loader::MtlKeyword::KS;
+  if ((token[0] == 'K' && token[1] == 't' && obj_loader::is_space(token[2])) || (token[0] == 'T' && token[1] == 'f' && obj_loader::is_space(token[2]))) return obj_loader::MtlKeyword::KT;
+  if (token[0] == 'N' && token[1] == 'i' && obj_loader::is_space(token[2])) return obj_loader::MtlKeyword::NI;
+  if (token[0] == 'K' && token[1] == 'e' && obj_loader::is_space(token[2])) return obj_loader::MtlKeyword::KE;
+  if (token[0] == 'N' && token[1] == 's' && obj_loader::is_space(token[2])) return obj_loader::MtlKeyword::NS;
+  if (0 == strncmp(token, "illum", 5) && obj_loader::is_space(token[5])) return obj_loader::MtlKeyword::ILLUM;
+  if (token[0] == 'd' && obj_loader::is_space(token[1])) return obj_loader::MtlKeyword::D;
+  if (token[0] == 'T' && token[1] == 'r' && obj_loader::is_space(token[2])) return obj_loader::MtlKeyword::TR;
+  if (0 == strncmp(token, "map_Ka", 6) && obj_loader::is_space(token[6])) return obj_loader::MtlKeyword::MAP_KA;
+  if (0 == strncmp(token, "map_Kd", 6) && obj_loader::is_space(token[6])) return obj_loader::MtlKeyword::MAP_KD;
+  if (0 == strncmp(token, "map_Ks", 6) && obj_loader::is_space(token[6])) return obj_loader::MtlKeyword::MAP_KS;
+  if (0 == strncmp(token, "map_Ns", 6) && obj_loader::is_space(token[6])) return obj_loader::MtlKeyword::MAP_NS;
+  if ((0 == strncmp(token, "map_bump", 8) || 0 == strncmp(token, "map_Bump", 8)) && obj_loader::is_space(token[8])) return obj_loader::MtlKeyword::MAP_BUMP;
+  if (0 == strncmp(token, "bump", 4) && obj_loader::is_space(token[4])) return obj_loader::MtlKeyword::BUMP;
+  if (0 == strncmp(token, "map_d", 5) && obj_loader::is_space(token[5])) return obj_loader::MtlKeyword::MAP_D;
+  if (0 == strncmp(token, "disp", 4) && obj_loader::is_space(token[4])) return obj_loader::MtlKeyword::DISP;
+  if (0 == strncmp(token, "refl", 4) && obj_loader::is_space(token[4])) return obj_loader::MtlKeyword::REFL;
+  return obj_loader::MtlKeyword::UNKNOWN;
+}
+
+// the statements of a file as the parse loops see them: leading blanks skipped, empty and comment lines dropped,
+// trailing blanks cut like loadMtl does. text keeps the bytes the tokens point into
+void statement_tokens(const std::string& path, std::vector<char>& text, std::vector<const char*>& tokens) {
+  text.clear();
+  FILE* fp = fopen(path.c_str(), "rb");
+  if (!fp) {
+    return;
+  }
+  char buf[64 * 1024];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    text.insert(text.end(), buf, buf + n);
+  }
+  fclose(fp);
+  text.push_back('\n');
+  size_t begin = 0;
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] != '\n' && text[i] != '\r') {
+      continue;
+    }
+    text[i] = '\0';
+    for (size_t end = i; end > begin && obj_loader::is_space(text[end - 1]); end--) {
+      text[end - 1] = '\0';
+    }
+    const char* token = &text[begin] + strspn(&text[begin], " \t");
+    if (token[0] != '\0' && token[0] != '#') {
+      tokens.push_back(token);
+    }
+    begin = i + 1;
+  }
+}
+
+// ms spent classifying every token passes times, the sum of the keywords keeps the calls alive
+template <typename Classify>
+float time_dispatch(Profiler& profiler, const std::vector<const char*>& tokens, int passes, Classify classify, size_t& sink) {
+  profiler.Start();
+  for (int pass = 0; pass < passes; pass++) {
+    for (const char* token : tokens) {
+      sink += static_cast<size_t>(classify(token));
     }
   }
+  return profiler.Stop();
+}
+#endif
+
+#ifdef ROUNDTRIP_PROFILE
+// the same records as ObjWriter through an ofstream with 9 digit floats, the baseline it is measured against
+void write_obj_iostream(const obj_loader::Scene& scene, const std::string& path) {
+  std::ofstream ofs(path);
+  ofs << std::setprecision(9);
+  size_t base = 1;
+  for (const obj_loader::Mesh& mesh : scene.meshes) {
+    ofs << "g " << mesh.name << '\n';
+    for (const obj_loader::Vertex& v : mesh.vertices) ofs << "v " << v.position.x << ' ' << v.position.y << ' ' << v.position.z << '\n';
+    for (const obj_loader::Vertex& v : mesh.vertices) ofs << "vt " << v.texcoord.x << ' ' << v.texcoord.y << '\n';
+    for (const obj_loader::Vertex& v : mesh.vertices) ofs << "vn " << v.normal.x << ' ' << v.normal.y << ' ' << v.normal.z << '\n';
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+      ofs << 'f';
+      for (size_t k = 0; k < 3; k++) {
+        size_t idx = base + mesh.indices[i + k];
+        ofs << ' ' << idx << '/' << idx << '/' << idx;
+      }
+      ofs << '\n';
+    }
+    base += mesh.vertices.size();
+  }
+}
+
+// bitwise equal corners, names and material names. corners are compared through the indices, a triangulated
+// polygon shares its corners while the reload of its triangles stores three each. meshes without vertices are
+// skipped, the loader can end a scene with one (a group without faces) and the writer has nothing to write for it.
+bool same_scene(const obj_loader::Scene& a, const obj_loader::Scene& b) {
+  std::vector<const obj_loader::Mesh*> left, right;
+  for (const obj_loader::Mesh& mesh : a.meshes) if (!mesh.empty()) left.push_back(&mesh);
+  for (const obj_loader::Mesh& mesh : b.meshes) if (!mesh.empty()) right.push_back(&mesh);
+  if (left.size() != right.size() || a.materials.size() != b.materials.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < left.size(); i++) {
+    const obj_loader::Mesh& x = *left[i];
+    const obj_loader::Mesh& y = *right[i];
+    if (x.name != y.name || x.material_id != y.material_id || x.indices.size() != y.indices.size()) {
+      return false;
+    }
+    for (size_t k = 0; k < x.indices.size(); k++) {
+      if (0 != memcmp(&x.vertices[x.indices[k]], &y.vertices[y.indices[k]], sizeof(obj_loader::Vertex))) {
+        return false;
+      }
+    }
+  }
+  for (size_t i = 0; i < a.materials.size(); i++) {
+    if (a.materials[i].name != b.materials[i].name || a.materials[i].texture_map.size() != b.materials[i].texture_map.size()) {
+      return false;
+    }
+  }
+  return true;
+}
+#endif
+
+#ifdef LARGE_PROFILE
+// a side x side position only grid as a triangle list, 6 (side - 1)^2 corners in a single group. returns the file size.
+size_t write_position_grid_obj(const std::string& path, size_t side) {
+  FILE* fp = fopen(path.c_str(), "wb");
+  if (!fp) {
+    return 0;
+  }
+  for (size_t y = 0; y < side; y++) {
+    for (size_t x = 0; x < side; x++) {
+      fprintf(fp, "v %zu.5 %zu.25 0\n", x, y);
+    }
+  }
+  fprintf(fp, "g grid\n");
+  for (size_t y = 0; y + 1 < side; y++) {
+    for (size_t x = 0; x + 1 < side; x++) {
+      size_t i = y * side + x + 1;
+      fprintf(fp, "f %zu %zu %zu\nf %zu %zu %zu\n", i, i + 1, i + side, i + 1, i + side + 1, i + side);
+    }
+  }
+  long size = ftell(fp);
+  fclose(fp);
+  return size < 0 ? 0 : static_cast<size_t>(size);
+}
+#endif
+
+#ifdef IO_BATCH_PROFILE
+// drops the cached pages of the files so the next load reads from disk (clean pages only, no root needed)
+void evict_page_cache(const std::vector<std::string>& paths) {
+  for (const std::string& path : paths) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      continue;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+#endif
+
+#ifdef LAYOUT_PROFILE
+// the downstream pass this replaces: a loaded scene repacked into the layout afterwards
+template <obj_loader::VertexFormat F>
+void repack_scene(const obj_loader::Scene& scene, obj_loader::VertexBuffer& buffer) {
+  size_t count = 0;
+  for (const auto& m : scene.meshes) count += m.vertices.size();
+  buffer.data.resize(count * buffer.layout.stride);
+  unsigned char* dst = buffer.data.data();
+  for (const auto& m : scene.meshes) {
+    for (const auto& v : m.vertices) {
+      obj_loader::VertexEmitter<F>::emit(buffer.layout, dst, v.position, v.normal, v.texcoord, v.tangent);
+      dst += buffer.layout.stride;
+    }
+  }
+}
+
+void repack_scene(const obj_loader::Scene& scene, obj_loader::VertexBuffer& buffer) {
+  using obj_loader::VertexFormat;
+  switch (buffer.layout.format) {
+    case VertexFormat::P3F_N3F_T2F: repack_scene<VertexFormat::P3F_N3F_T2F>(scene, buffer); break;
+    case VertexFormat::P3F_T2F_N3F: repack_scene<VertexFormat::P3F_T2F_N3F>(scene, buffer); break;
+    case VertexFormat::P3F_N4B_T2H: repack_scene<VertexFormat::P3F_N4B_T2H>(scene, buffer); break;
+    case VertexFormat::P3F: repack_scene<VertexFormat::P3F>(scene, buffer); break;
+    default: repack_scene<VertexFormat::CUSTOM>(scene, buffer); break;
+  }
+}
+#endif
+
+#if defined(COMPRESS_PROFILE) && defined(OBJ_LOADER_ZLIB)
+// gzip level 6, what the asset store uses
+bool gzip_file(const std::string& src, const std::string& dst) {
+  FILE* in = fopen(src.c_str(), "rb");
+  gzFile out = gzopen(dst.c_str(), "wb6");
+  if (!in || !out) {
+    if (in) fclose(in);
+    if (out) gzclose(out);
+    return false;
+  }
+  char buf[64 * 1024];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    gzwrite(out, buf, (unsigned)n);
+  }
+  fclose(in);
+  return gzclose(out) == Z_OK;
+}
+
+// decompress to a temporary file, today's path in front of loadObj
+size_t gunzip_file(const std::string& src, const std::string& dst) {
+  gzFile in = gzopen(src.c_str(), "rb");
+  FILE* out = fopen(dst.c_str(), "wb");
+  if (!in || !out) {
+    if (in) gzclose(in);
+    if (out) fclose(out);
+    return 0;
+  }
+  static char buf[256 * 1024];
+  size_t total = 0;
+  int n;
+  while ((n = gzread(in, buf, sizeof(buf))) > 0) {
+    fwrite(buf, 1, (size_t)n, out);
+    total += (size_t)n;
+  }
+  gzclose(in);
+  fclose(out);
+  return total;
+}
+#endif
+
+#if defined(COMPRESS_PROFILE) && defined(OBJ_LOADER_ZSTD)
+// zstd level 3 in one shot, returns the uncompressed size or 0
+size_t zstd_file(const std::string& src, const std::string& dst) {
+  FILE* in = fopen(src.c_str(), "rb");
+  if (!in) {
+    return 0;
+  }
+  std::vector<char> data;
+  char buf[64 * 1024];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    data.insert(data.end(), buf, buf + n);
+  }
+  fclose(in);
+  std::vector<char> packed(ZSTD_compressBound(data.size()));
+  size_t size = ZSTD_compress(packed.data(), packed.size(), data.data(), data.size(), 3);
+  FILE* out = fopen(dst.c_str(), "wb");
+  if (ZSTD_isError(size) || !out) {
+    if (out) fclose(out);
+    return 0;
+  }
+  bool ok = fwrite(packed.data(), 1, size, out) == size;
+  ok = fclose(out) == 0 && ok;
+  return ok ? data.size() : 0;
+}
+#endif
+
+#ifdef HOT_RELOAD_PROFILE
+// rewrites dst with the bytes of src, the way an exporter overwrites its output.
+// written is taken after the data is flushed but before the close that raises the change event
+bool copy_file(const std::string& src, const std::string& dst, std::chrono::steady_clock::time_point* written = nullptr) {
+  FILE* in = fopen(src.c_str(), "rb");
+  if (!in) {
+    return false;
+  }
+  FILE* out = fopen(dst.c_str(), "wb");
+  if (!out) {
+    fclose(in);
+    return false;
+  }
+  char buf[64 * 1024];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    fwrite(buf, 1, n, out);
+  }
+  fclose(in);
+  fflush(out);
+  if (written) {
+    *written = std::chrono::steady_clock::now();
+  }
+  fclose(out);
+  return true;
 }
 #endif
 
@@ -86,8 +853,20 @@ int main() {
     profiler.Start();
     bool res = load_model("../res/" + str, mesh_assimp);
     log_mesh_profile(str, mesh_assimp, res, profiler.Stop(), verbos);
+    for (auto m : mesh_assimp) {
+      delete m;
+    }
   }
   std::cout << "average elapsed time (ASSIMP): " << profiler.Average() << " ms" << '\n';
+
+  // assimp, flat output
+  for (auto& str : file_list) {
+    flat_model model;
+    profiler.Start();
+    bool res = load_model_flat("../res/" + str, model);
+    log_mesh_profile(str, model, res, profiler.Stop(), verbos);
+  }
+  std::cout << "average elapsed time (ASSIMP flat): " << profiler.Average() << " ms" << '\n';
   std::cout << "===========================================================" << '\n';
 #endif
 
@@ -119,6 +898,1152 @@ int main() {
   std::cout << "===========================================================" << '\n';
 #endif
 
+#ifdef LOD_PROFILE
+  // lod chain generation (50/25/10%)
+  std::vector<float> lod_ratios = {0.5f, 0.25f, 0.1f};
+  size_t lod_triangles = 0;
+  float lod_elapsed = 0.f;
+  for (auto& str : file_list) {
+    obj_loader::Scene scene;
+    if (!obj_loader::loadObj("../res/" + str, scene, obj_loader::ParseOption::TRIANGULATE)) {
+      continue;
+    }
+    for (const auto& m : scene.meshes) {
+      std::vector<obj_loader::LodLevel> lods;
+      profiler.Start();
+      bool res = obj_loader::generateLods(m, lod_ratios, lods);
+      float elapsed = profiler.Stop();
+      if (res) {
+        log_lod_profile(str + ":" + m.name, m.indices.size() / 3, lods, elapsed);
+        lod_triangles += m.indices.size() / 3;
+        lod_elapsed += elapsed;
+      }
+    }
+  }
+  profiler.Reset();
+  {
+    obj_loader::Mesh dense = make_dense_sphere(1000, 1000);
+    std::vector<obj_loader::LodLevel> lods;
+    profiler.Start();
+    obj_loader::generateLods(dense, lod_ratios, lods, obj_loader::SimplifyOption::NONE);
+    float elapsed = profiler.Stop();
+    log_lod_profile(dense.name, dense.indices.size() / 3, lods, elapsed);
+    lod_triangles += dense.indices.size() / 3;
+    lod_elapsed += elapsed;
+  }
+  profiler.Reset();
+  std::cout << "lod throughput: " << (lod_elapsed > 0.f ? lod_triangles / lod_elapsed * 1000.f : 0.f) << " tris/s" << '\n';
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef ARENA_PROFILE
+  // whole file list with heap backed temporaries vs one reused arena
+  for (int mode = 0; mode < 2; mode++) {
+    Arena arena(4 << 20);
+    Arena* scratch = mode == 0 ? nullptr : &arena;
+    size_t allocations_before = heap_allocation_count.load(std::memory_order_relaxed);
+    profiler.Start();
+    for (auto& str : file_list) {
+      obj_loader::Scene scene;
+      obj_loader::loadObj("../res/" + str, scene, obj_loader::ParseOption::FLIP_UV | obj_loader::ParseOption::CALC_TANGENT, scratch);
+    }
+    float elapsed = profiler.Stop();
+    std::cout << (mode == 0 ? "heap" : "arena") << ": " << elapsed << "ms, "
+              << heap_allocation_count.load(std::memory_order_relaxed) - allocations_before << " heap allocations";
+    if (scratch) {
+      std::cout << ", " << arena.allocation_count() << " arena allocations in " << arena.system_allocation_count()
+                << " blocks (" << arena.capacity() / 1024 << " KiB)";
+    }
+    std::cout << '\n';
+  }
+  profiler.Reset();
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef PRESCAN_PROFILE
+  // does counting records first pay for itself against geometric growth?
+  for (unsigned int n : {32u, 128u, 512u, 1024u}) {
+    std::string path = "prescan_grid_" + std::to_string(n) + ".obj";
+    if (!write_grid_obj(path, n)) {
+      continue;
+    }
+    float elapsed[2];
+    for (int mode = 0; mode < 2; mode++) {
+      obj_loader::ParseOption option = mode == 0 ? obj_loader::ParseOption::NONE : obj_loader::ParseOption::PRESCAN;
+      for (int i = 0; i < 3; i++) {
+        obj_loader::Scene scene;
+        profiler.Start();
+        obj_loader::loadObj(path, scene, option);
+        profiler.Stop();
+      }
+      elapsed[mode] = profiler.Average();
+    }
+    std::cout << "## prescan (" << path << "): " << 2 * n * n << " faces" << '\n';
+    std::cout << std::tab << "growth: " << elapsed[0] << "ms, prescan: " << elapsed[1] << "ms ("
+              << (elapsed[1] < elapsed[0] ? "pays off" : "does not pay off") << ")" << '\n';
+    std::remove(path.c_str());
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef MTL_CACHE_PROFILE
+  // second pass over the file list reuses every parsed mtl
+  {
+    obj_loader::MaterialCache material_cache;
+    for (int pass = 0; pass < 2; pass++) {
+      profiler.Start();
+      for (auto& str : file_list) {
+        obj_loader::Scene scene;
+        obj_loader::loadObj("../res/" + str, scene, obj_loader::ParseOption::FLIP_UV | obj_loader::ParseOption::CALC_TANGENT, nullptr, &material_cache);
+      }
+      std::cout << "mtl cache pass " << pass << ": " << profiler.Stop() << "ms" << '\n';
+    }
+    profiler.Reset();
+    std::cout << "mtl cache: " << material_cache.hit_count() << " hits, " << material_cache.miss_count() << " misses, "
+              << material_cache.textures().size() << " unique textures" << '\n';
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef FORMAT_PROFILE
+  // every format through the native loader and assimp, on converted res models
+  {
+    struct format_entry {
+      const char* name;
+      const char* extension;
+      bool (*native)(const std::string&, obj_loader::Scene&, obj_loader::ParseOption);
+    };
+    const format_entry formats[] = {
+      {"OBJ", ".obj", nullptr},
+      {"STL", ".stl", obj_loader::loadStl},
+      {"PLY binary", ".bin.ply", obj_loader::loadPly},
+      {"PLY ascii", ".ascii.ply", obj_loader::loadPly},
+    };
+
+    std::vector<std::pair<std::string, std::string>> converted; // source obj, converted stem
+    for (auto& str : file_list) {
+      obj_loader::Scene scene;
+      if (!obj_loader::loadObj("../res/" + str, scene, obj_loader::ParseOption::TRIANGULATE)) {
+        continue;
+      }
+      std::string stem = "converted_" + obj_loader::splitDelims(str, "\\/").second;
+      stem = stem.substr(0, stem.size() - 4);
+      if (write_stl(scene, stem + ".stl") && write_ply(scene, stem + ".bin.ply", true) && write_ply(scene, stem + ".ascii.ply", false)) {
+        converted.emplace_back("../res/" + str, stem);
+      }
+    }
+
+    for (const auto& format : formats) {
+      float native_total = 0.f, assimp_total = 0.f;
+      for (auto& source : converted) {
+        std::string path = format.native ? source.second + format.extension : source.first;
+        obj_loader::Scene scene;
+        profiler.Start();
+        if (format.native) {
+          format.native(path, scene, obj_loader::ParseOption::NONE);
+        } else {
+          obj_loader::loadObj(path, scene, obj_loader::ParseOption::NONE);
+        }
+        native_total += profiler.Stop();
+
+        flat_model model;
+        profiler.Start();
+        load_model_flat(path, model);
+        assimp_total += profiler.Stop();
+      }
+      profiler.Reset();
+      std::cout << "## format (" << format.name << "): " << converted.size() << " files" << '\n';
+      std::cout << std::tab << "native: " << native_total << "ms, assimp: " << assimp_total << "ms" << '\n';
+    }
+
+    for (auto& source : converted) {
+      for (const auto& format : formats) {
+        if (format.native) std::remove((source.second + format.extension).c_str());
+      }
+    }
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef GLTF_PROFILE
+  // native glb (mapped views, then Scene on demand) against assimp's gltf import, on converted res models
+  {
+    std::vector<std::string> converted;
+    for (auto& str : file_list) {
+      obj_loader::Scene scene;
+      if (!obj_loader::loadObj("../res/" + str, scene, obj_loader::ParseOption::TRIANGULATE)) {
+        continue;
+      }
+      std::string stem = "converted_" + obj_loader::splitDelims(str, "\\/").second;
+      std::string path = stem.substr(0, stem.size() - 4) + ".glb";
+      if (write_glb(scene, path)) {
+        converted.push_back(path);
+      }
+    }
+
+    float view_total = 0.f, scene_total = 0.f, assimp_total = 0.f;
+    // the native loader keeps its input mapped instead of copying it to the heap, so its mapped bytes are
+    // reported next to the heap peak; assimp reads into heap buffers, which its peak already counts
+    size_t view_peak = 0, scene_peak = 0, assimp_peak = 0, view_mapped = 0, scene_mapped = 0;
+    for (auto& path : converted) {
+      size_t vertex_count = 0;
+      {
+        gltf_loader::Asset asset;
+        heap_peak_scope heap;
+        profiler.Start();
+        bool res = gltf_loader::loadGltf(path, asset);
+        view_total += profiler.Stop();
+        view_peak = std::max(view_peak, heap.peak());
+        if (!res) continue;
+        view_mapped = std::max(view_mapped, asset.mapped_bytes());
+        for (const auto& m : asset.meshes) {
+          for (const auto& prim : m.primitives) {
+            vertex_count += asset.accessor(prim.attribute("POSITION")).count;
+          }
+        }
+      }
+      {
+        gltf_loader::Asset asset;
+        obj_loader::Scene scene;
+        heap_peak_scope heap;
+        profiler.Start();
+        gltf_loader::loadGltf(path, asset);
+        gltf_loader::toScene(asset, scene, obj_loader::ParseOption::NONE);
+        scene_total += profiler.Stop();
+        scene_peak = std::max(scene_peak, heap.peak());
+        scene_mapped = std::max(scene_mapped, asset.mapped_bytes());
+      }
+      {
+        flat_model model;
+        heap_peak_scope heap;
+        profiler.Start();
+        load_model_flat(path, model);
+        assimp_total += profiler.Stop();
+        assimp_peak = std::max(assimp_peak, heap.peak());
+      }
+      std::cout << "## gltf (" << path << "): " << vertex_count << " vertices" << '\n';
+    }
+    profiler.Reset();
+    std::cout << std::tab << "native views: " << view_total << "ms, peak heap " << view_peak / 1024 << " KiB + "
+              << view_mapped / 1024 << " KiB mapped" << '\n';
+    std::cout << std::tab << "native scene: " << scene_total << "ms, peak heap " << scene_peak / 1024 << " KiB + "
+              << scene_mapped / 1024 << " KiB mapped" << '\n';
+    std::cout << std::tab << "assimp: " << assimp_total << "ms, peak heap " << assimp_peak / 1024 << " KiB" << '\n';
+
+    for (auto& path : converted) {
+      std::remove(path.c_str());
+    }
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef KEYWORD_PROFILE
+  // statement dispatch on an mtl heavy and on the obj inputs: the jump tables against the strncmp chains they
+  // replaced, classifying the same statements so nothing but the dispatch is timed. rounds alternate
+  {
+    const int rounds = 5, passes = 10;
+    write_keyword_mtl("keyword_heavy.mtl", 20000);
+    std::vector<char> mtl_text;
+    std::vector<const char*> mtl_tokens;
+    statement_tokens("keyword_heavy.mtl", mtl_text, mtl_tokens);
+    std::remove("keyword_heavy.mtl");
+
+    std::vector<std::vector<char>> obj_texts(file_list.size());
+    std::vector<const char*> obj_tokens;
+    for (size_t i = 0; i < file_list.size(); i++) {
+      statement_tokens("../res/" + file_list[i], obj_texts[i], obj_tokens);
+    }
+
+    size_t sink = 0;
+    float mtl_ms[2] = {0.f, 0.f}, obj_ms[2] = {0.f, 0.f};
+    for (int round = 0; round < rounds; round++) {
+      // lambdas rather than function pointers, so both sides are inlined into the loop the same way
+      mtl_ms[0] += time_dispatch(profiler, mtl_tokens, passes, [](const char* t) { return obj_loader::mtlKeyword(t); }, sink);
+      mtl_ms[1] += time_dispatch(profiler, mtl_tokens, passes, [](const char* t) { return mtl_keyword_chain(t); }, sink);
+      obj_ms[0] += time_dispatch(profiler, obj_tokens, passes, [](const char* t) { return obj_loader::objKeyword(t); }, sink);
+      obj_ms[1] += time_dispatch(profiler, obj_tokens, passes, [](const char* t) { return obj_keyword_chain(t); }, sink);
+    }
+    profiler.Reset();
+    auto print_rates = [&](size_t statements, const float* ms) {
+      float table = statements * float(rounds * passes) / (ms[0] / 1000.f) / 1e6f;
+      float chain = statements * float(rounds * passes) / (ms[1] / 1000.f) / 1e6f;
+      std::cout << std::tab << "strncmp chain: " << chain << " M statements/s, jump table: " << table << " M statements/s ("
+                << (table / chain - 1.f) * 100.f << "%)" << '\n';
+    };
+    std::cout << "## keyword dispatch (mtl): " << mtl_tokens.size() << " statements" << '\n';
+    print_rates(mtl_tokens.size(), mtl_ms);
+    std::cout << "## keyword dispatch (obj): " << obj_tokens.size() << " statements (checksum " << sink % 1000 << ")" << '\n';
+    print_rates(obj_tokens.size(), obj_ms);
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef SPECIALIZE_PROFILE
+  // per element flags tested at run time against the compile time instantiations, for the option mixes used here
+  {
+    using obj_loader::ParseOption;
+    const std::pair<const char*, ParseOption> mixes[] = {
+      {"NONE", ParseOption::NONE},
+      {"TRIANGULATE", ParseOption::TRIANGULATE},
+      {"CALC_TANGENT", ParseOption::CALC_TANGENT},
+      {"PRESCAN", ParseOption::PRESCAN},
+      {"TRIANGULATE | FLIP_UV", ParseOption::TRIANGULATE | ParseOption::FLIP_UV},
+      {"FLIP_UV | CALC_TANGENT", ParseOption::FLIP_UV | ParseOption::CALC_TANGENT},
+    };
+    const int rounds = 3;
+    std::cout << "## specialized (option mix): dynamic ms | specialized ms | gain" << '\n';
+    for (const auto& mix : mixes) {
+      float dynamic_total = 0.f, static_total = 0.f;
+      for (int round = 0; round < rounds; round++) {
+        for (auto& str : file_list) {
+          obj_loader::Scene dynamic_scene, static_scene;
+          profiler.Start();
+          obj_loader::loadObjDynamic("../res/" + str, dynamic_scene, mix.second);
+          dynamic_total += profiler.Stop();
+          profiler.Start();
+          obj_loader::loadObj("../res/" + str, static_scene, mix.second);
+          static_total += profiler.Stop();
+        }
+      }
+      profiler.Reset();
+      std::cout << std::tab << mix.first << ": " << dynamic_total / rounds << " | " << static_total / rounds << " | "
+                << (dynamic_total - static_total) / dynamic_total * 100.f << "%" << '\n';
+    }
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef LAYOUT_PROFILE
+  // load then repack against emitting the target layout from parsePrimitive
+  {
+    using namespace obj_loader;
+    std::vector<std::pair<std::string, VertexLayout>> layouts = {
+      {"P3F_N3F_T2F", VertexLayout::make(VertexFormat::P3F_N3F_T2F)},
+      {"P3F_N4B_T2H", VertexLayout::make(VertexFormat::P3F_N4B_T2H)},
+      {"P3F", VertexLayout::make(VertexFormat::P3F)},
+      {"custom P3F_N4S_T2US_T4B", VertexLayout().add(VertexAttribute::POSITION, ComponentType::FLOAT32, 3)
+        .add(VertexAttribute::NORMAL, ComponentType::SNORM16, 4).add(VertexAttribute::TEXCOORD, ComponentType::UNORM16, 2)
+        .add(VertexAttribute::TANGENT, ComponentType::SNORM8, 4)},
+    };
+    for (const auto& layout : layouts) {
+      float repack_total = 0.f, direct_total = 0.f;
+      size_t bytes = 0;
+      for (auto& str : file_list) {
+        Scene scene;
+        VertexBuffer repacked(layout.second);
+        profiler.Start();
+        bool res = loadObj("../res/" + str, scene, ParseOption::CALC_TANGENT);
+        repack_scene(scene, repacked);
+        repack_total += profiler.Stop();
+        if (!res) {
+          continue;
+        }
+
+        Scene direct;
+        VertexBuffer packed(layout.second);
+        profiler.Start();
+        loadObj("../res/" + str, direct, ParseOption::CALC_TANGENT, nullptr, nullptr, &packed);
+        direct_total += profiler.Stop();
+        bytes += packed.data.size();
+      }
+      profiler.Reset();
+      std::cout << "## layout (" << layout.first << "): stride " << layout.second.stride << ", " << bytes / 1024 << " KiB" << '\n';
+      std::cout << std::tab << "load + repack: " << repack_total << "ms, direct emit: " << direct_total << "ms" << '\n';
+    }
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef COMPRESS_PROFILE
+  // gzip inputs: streaming decompression overlapped with parsing, against decompress to a file then parse
+#ifdef OBJ_LOADER_ZLIB
+  {
+    float stream_total = 0.f, staged_total = 0.f;
+    size_t bytes_total = 0;
+    for (auto& str : file_list) {
+      obj_loader::Scene source;
+      if (!obj_loader::loadObj("../res/" + str, source, obj_loader::ParseOption::NONE)) {
+        continue;
+      }
+      std::string name = obj_loader::splitDelims(str, "\\/").second;
+      std::string gz = "compressed_" + name + ".gz";
+      // libraries keep their relative names so the compressed obj still finds them, as name.mtl.gz
+      std::vector<std::string> libraries;
+      bool ok = gzip_file("../res/" + str, gz);
+      for (const std::string& lib : source.material_libraries) {
+        libraries.push_back(lib.substr(source.base_dir.size()));
+        ok = ok && gzip_file(lib, libraries.back() + ".gz");
+      }
+      if (!ok) {
+        continue;
+      }
+
+      obj_loader::Scene streamed;
+      profiler.Start();
+      bool res = obj_loader::loadObj(gz, streamed, obj_loader::ParseOption::NONE);
+      float stream_ms = profiler.Stop();
+
+      obj_loader::Scene staged;
+      std::string plain = "decompressed_" + name;
+      profiler.Start();
+      size_t bytes = gunzip_file(gz, plain);
+      for (const std::string& lib : libraries) gunzip_file(lib + ".gz", lib);
+      obj_loader::loadObj(plain, staged, obj_loader::ParseOption::NONE);
+      float staged_ms = profiler.Stop();
+      profiler.Reset();
+
+      std::cout << "## compressed (" << name << "): " << streamed.meshes.size() << " meshes, " << streamed.materials.size()
+                << " materials" << std::boolalpha << " (" << res << ")" << '\n';
+      std::cout << std::tab << "streaming: " << stream_ms << "ms, decompress then parse: " << staged_ms << "ms" << '\n';
+      stream_total += stream_ms;
+      staged_total += staged_ms;
+      bytes_total += bytes;
+
+      std::remove(gz.c_str());
+      std::remove(plain.c_str());
+      for (const std::string& lib : libraries) {
+        std::remove((lib + ".gz").c_str());
+        std::remove(lib.c_str());
+      }
+    }
+    float mb = bytes_total / (1024.f * 1024.f);
+    std::cout << "streaming: " << mb / (stream_total / 1000.f) << " MB/s, decompress then parse: "
+              << mb / (staged_total / 1000.f) << " MB/s (uncompressed obj bytes)" << '\n';
+  }
+#else
+  std::cout << "## compressed: built without zlib" << '\n';
+#endif
+  // zstd inputs larger than one 256 KiB decode chunk, so blocks straddle chunks; checked against the plain parse
+#ifdef OBJ_LOADER_ZSTD
+  {
+    float stream_total = 0.f;
+    size_t bytes_total = 0, mismatches = 0;
+    for (auto& str : file_list) {
+      obj_loader::Scene plain;
+      if (!obj_loader::loadObj("../res/" + str, plain, obj_loader::ParseOption::NONE)) {
+        continue;
+      }
+      std::string name = obj_loader::splitDelims(str, "\\/").second;
+      std::string zst = "compressed_" + name + ".zst";
+      std::vector<std::string> libraries;
+      size_t bytes = zstd_file("../res/" + str, zst);
+      bool ok = bytes > 256 * 1024;
+      for (const std::string& lib : plain.material_libraries) {
+        libraries.push_back(lib.substr(plain.base_dir.size()));
+        ok = ok && zstd_file(lib, libraries.back() + ".zst") > 0;
+      }
+      if (ok) {
+        obj_loader::Scene streamed;
+        profiler.Start();
+        bool res = obj_loader::loadObj(zst, streamed, obj_loader::ParseOption::NONE);
+        float stream_ms = profiler.Stop();
+        bool same = res && streamed.meshes.size() == plain.meshes.size() && streamed.materials.size() == plain.materials.size();
+        for (size_t i = 0; same && i < plain.meshes.size(); i++) {
+          const obj_loader::Mesh& a = plain.meshes[i];
+          const obj_loader::Mesh& b = streamed.meshes[i];
+          same = a.vertices.size() == b.vertices.size() && a.indices == b.indices &&
+                 0 == memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(obj_loader::Vertex));
+        }
+        std::cout << "## compressed zstd (" << name << "): " << streamed.meshes.size() << " meshes" << std::boolalpha
+                  << " (" << res << "), matches plain: " << same << '\n';
+        std::cout << std::tab << "streaming: " << stream_ms << "ms" << '\n';
+        stream_total += stream_ms;
+        bytes_total += bytes;
+        mismatches += same ? 0 : 1;
+      }
+      profiler.Reset();
+
+      std::remove(zst.c_str());
+      for (const std::string& lib : libraries) {
+        std::remove((lib + ".zst").c_str());
+      }
+    }
+    std::cout << "zstd streaming: " << bytes_total / (1024.f * 1024.f) / (stream_total / 1000.f) << " MB/s, "
+              << mismatches << " mismatches" << '\n';
+  }
+#else
+  std::cout << "## compressed (zstd): built without zstd" << '\n';
+#endif
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef IO_BATCH_PROFILE
+  // cold cache batch load: one stream per file against batched reads of every obj and mtl, then parsing from memory
+  {
+    ThreadPool pool;
+    std::vector<std::string> paths, all_files;
+    for (auto& str : file_list) {
+      std::vector<char> data;
+      if (!obj_loader::readWholeFile("../res/" + str, data)) {
+        continue;
+      }
+      paths.emplace_back("../res/" + str);
+      obj_loader::mtlLibraries(data, obj_loader::splitDelims(paths.back(), "\\/").first, all_files);
+    }
+    all_files.insert(all_files.end(), paths.begin(), paths.end());
+
+    const int rounds = 3;
+    obj_loader::BatchReader pread_reader(&pool, obj_loader::IoBackend::PREAD);
+    obj_loader::BatchReader auto_reader(&pool, obj_loader::IoBackend::AUTO);
+    float stream_ms = 0.f, pread_ms = 0.f, uring_ms = 0.f, pread_io_ms = 0.f, uring_io_ms = 0.f;
+    for (int round = 0; round < rounds; round++) {
+      evict_page_cache(all_files);
+      profiler.Start();
+      for (const std::string& path : paths) {
+        obj_loader::Scene scene;
+        obj_loader::loadObj(path, scene, obj_loader::ParseOption::NONE);
+      }
+      stream_ms += profiler.Stop();
+
+      std::vector<obj_loader::Scene> scenes;
+      std::vector<bool> loaded;
+      evict_page_cache(all_files);
+      profiler.Start();
+      obj_loader::loadObjBatch(paths, scenes, loaded, obj_loader::ParseOption::NONE, pread_reader, &pool);
+      pread_ms += profiler.Stop();
+      evict_page_cache(all_files);
+      profiler.Start();
+      obj_loader::loadObjBatch(paths, scenes, loaded, obj_loader::ParseOption::NONE, auto_reader, &pool);
+      uring_ms += profiler.Stop();
+
+      // the reads alone
+      obj_loader::PreloadedFiles files;
+      evict_page_cache(all_files);
+      profiler.Start();
+      pread_reader.read(all_files, files);
+      pread_io_ms += profiler.Stop();
+      files.clear();
+      evict_page_cache(all_files);
+      profiler.Start();
+      auto_reader.read(all_files, files);
+      uring_io_ms += profiler.Stop();
+    }
+    profiler.Reset();
+    const char* auto_name = auto_reader.backend() == obj_loader::IoBackend::IO_URING ? "io_uring" : "pread (io_uring unavailable)";
+    std::cout << "## batch io (" << paths.size() << " obj, " << all_files.size() - paths.size() << " mtl, cold cache)" << '\n';
+    std::cout << std::tab << "stream per file: " << stream_ms / rounds << "ms" << '\n';
+    std::cout << std::tab << "batch pread: " << pread_ms / rounds << "ms (reads " << pread_io_ms / rounds << "ms)" << '\n';
+    std::cout << std::tab << "batch " << auto_name << ": " << uring_ms / rounds << "ms (reads " << uring_io_ms / rounds << "ms)" << '\n';
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef DEDUP_PROFILE
+  // a batch of levels that all reference the same files: geometry kept with and without the mesh cache
+  {
+    const int levels = 3;
+    obj_loader::MeshCache cache;
+    std::vector<obj_loader::MeshInstance> instances;
+    size_t mesh_count = 0, loaded_bytes = 0;
+    float load_ms = 0.f, intern_ms = 0.f;
+    for (int level = 0; level < levels; level++) {
+      for (auto& str : file_list) {
+        obj_loader::Scene scene;
+        profiler.Start();
+        bool res = obj_loader::loadObj("../res/" + str, scene, obj_loader::ParseOption::TRIANGULATE);
+        load_ms += profiler.Stop();
+        if (!res) {
+          continue;
+        }
+        for (const obj_loader::Mesh& mesh : scene.meshes) {
+          loaded_bytes += mesh.vertices.size() * sizeof(obj_loader::Vertex) + mesh.indices.size() * sizeof(unsigned int);
+        }
+        mesh_count += scene.meshes.size();
+        profiler.Start();
+        cache.intern(scene, instances);
+        intern_ms += profiler.Stop();
+      }
+    }
+    profiler.Reset();
+    std::cout << "## mesh dedup (" << levels << " levels): " << mesh_count << " meshes, " << cache.miss_count() << " unique" << '\n';
+    std::cout << std::tab << "geometry: " << loaded_bytes / (1024.f * 1024.f) << "MB loaded, " << cache.bytes_stored() / (1024.f * 1024.f)
+              << "MB stored, " << cache.bytes_saved() / (1024.f * 1024.f) << "MB saved" << '\n';
+    std::cout << std::tab << "load: " << load_ms << "ms, hash and intern: " << intern_ms << "ms ("
+              << loaded_bytes / (intern_ms / 1000.f) / (1024.f * 1024.f * 1024.f) << " GB/s)" << '\n';
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef MERGE_PROFILE
+  // one mesh per material against one per group, the draw calls a renderer would issue
+  {
+    const int rounds = 5;
+    size_t total_before = 0, total_after = 0;
+    for (auto& str : file_list) {
+      obj_loader::Scene split, merged;
+      float split_ms = 0.f, merged_ms = 0.f;
+      bool res = true;
+      for (int i = 0; i < rounds && res; i++) {
+        split = obj_loader::Scene();
+        merged = obj_loader::Scene();
+        profiler.Start();
+        res = obj_loader::loadObj("../res/" + str, split, obj_loader::ParseOption::TRIANGULATE);
+        split_ms += profiler.Stop();
+        profiler.Start();
+        res = res && obj_loader::loadObj("../res/" + str, merged, obj_loader::ParseOption::TRIANGULATE | obj_loader::ParseOption::MERGE_MATERIALS);
+        merged_ms += profiler.Stop();
+      }
+      profiler.Reset();
+      if (!res) {
+        continue;
+      }
+      size_t ranges = 0;
+      for (const obj_loader::Mesh& mesh : merged.meshes) ranges += mesh.ranges.size();
+      total_before += split.meshes.size();
+      total_after += merged.meshes.size();
+      std::cout << "## merge by material (" << str << "): " << split.meshes.size() << " -> " << merged.meshes.size() << " meshes ("
+                << ranges << " ranges, " << merged.materials.size() << " materials)" << '\n';
+      std::cout << std::tab << "load: " << split_ms / rounds << "ms, merged: " << merged_ms / rounds << "ms" << '\n';
+    }
+    std::cout << "## merge by material: " << total_before << " -> " << total_after << " meshes over every file" << '\n';
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef ROUNDTRIP_PROFILE
+  // load, write, reload: ObjWriter against an ofstream, and whether the reloaded scene is bit identical
+  {
+    const int rounds = 3;
+    const std::string path = "roundtrip.obj";
+    ThreadPool pool;
+    obj_loader::ObjWriter serial, parallel(&pool);
+    float stream_total = 0.f, serial_total = 0.f, parallel_total = 0.f, reload_total = 0.f;
+    size_t bytes_total = 0, stream_bytes_total = 0;
+    for (auto& str : file_list) {
+      obj_loader::Scene scene;
+      if (!obj_loader::loadObj("../res/" + str, scene, obj_loader::ParseOption::TRIANGULATE)) {
+        continue;
+      }
+      float stream_ms = 0.f, serial_ms = 0.f, parallel_ms = 0.f, reload_ms = 0.f;
+      bool exact = true;
+      size_t stream_bytes = 0;
+      for (int i = 0; i < rounds; i++) {
+        profiler.Start();
+        write_obj_iostream(scene, path);
+        stream_ms += profiler.Stop();
+        stream_bytes = static_cast<size_t>(std::ifstream(path, std::ios::binary | std::ios::ate).tellg());
+        profiler.Start();
+        exact = serial.write(scene, path) && exact;
+        serial_ms += profiler.Stop();
+        profiler.Start();
+        exact = parallel.write(scene, path) && exact;
+        parallel_ms += profiler.Stop();
+        obj_loader::Scene reloaded;
+        profiler.Start();
+        exact = obj_loader::loadObj(path, reloaded, obj_loader::ParseOption::TRIANGULATE) && exact;
+        reload_ms += profiler.Stop();
+        exact = exact && same_scene(scene, reloaded);
+      }
+      profiler.Reset();
+      std::remove(path.c_str());
+      std::remove("roundtrip.mtl");
+
+      const size_t bytes = parallel.bytes_written();
+      const float mb = bytes / (1024.f * 1024.f);
+      stream_total += stream_ms;
+      serial_total += serial_ms;
+      parallel_total += parallel_ms;
+      reload_total += reload_ms;
+      bytes_total += bytes;
+      stream_bytes_total += stream_bytes;
+      std::cout << "## round trip (" << str << "): " << mb << " MiB written, " << (exact ? "bit exact" : "MISMATCH") << '\n';
+      std::cout << std::tab << "ofstream: " << stream_ms / rounds << "ms (" << (stream_bytes / (1024.f * 1024.f)) * rounds * 1000.f / stream_ms << " MB/s)" << '\n';
+      std::cout << std::tab << "writer: " << serial_ms / rounds << "ms (" << mb * rounds * 1000.f / serial_ms << " MB/s), "
+                << "pool: " << parallel_ms / rounds << "ms (" << mb * rounds * 1000.f / parallel_ms << " MB/s)" << '\n';
+      std::cout << std::tab << "reload: " << reload_ms / rounds << "ms (" << mb * rounds * 1000.f / reload_ms << " MB/s)" << '\n';
+    }
+    const float mb = bytes_total / (1024.f * 1024.f), stream_mb = stream_bytes_total / (1024.f * 1024.f);
+    std::cout << "## round trip over every file: " << mb << " MiB (ofstream " << stream_mb << " MiB)" << '\n';
+    std::cout << std::tab << "ofstream " << stream_mb * rounds * 1000.f / stream_total << " MB/s, writer " << mb * rounds * 1000.f / serial_total
+              << " MB/s, pool (" << pool.size() << " threads) " << mb * rounds * 1000.f / parallel_total << " MB/s, reload "
+              << mb * rounds * 1000.f / reload_total << " MB/s" << '\n';
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef TEXTURE_PROFILE
+  // decoding the texture maps of a material set, serial against the pool, then through the disk cache
+  {
+#if defined(OBJ_LOADER_PNG) && defined(OBJ_LOADER_JPEG)
+    struct TextureSet {
+      std::string obj;
+      std::vector<std::string> extra; // maps the mtl does not name, relative to the obj
+    };
+    // officebot.obj has no mtllib and slime.mtl only names mouth.jpg, their other maps are listed by hand
+    const std::vector<TextureSet> sets = {
+      {"nanosuit/nanosuit.obj", {}},
+      {"slime/slime.obj", {"eyes.jpg"}},
+      {"officebot/officebot.obj", {"emissive.tga.png", "metalness.tga.png"}},
+    };
+    const int rounds = 3;
+    const std::string cache_dir = "texture_cache";
+    ThreadPool pool;
+    for (const TextureSet& set : sets) {
+      obj_loader::Scene scene;
+      if (!obj_loader::loadObj("../res/" + set.obj, scene, obj_loader::ParseOption::NONE)) {
+        continue;
+      }
+      std::vector<std::string> paths = scene.textures;
+      for (auto& name : set.extra) paths.emplace_back(scene.base_dir + name);
+
+      std::vector<obj_loader::Image> images;
+      obj_loader::TextureLoadStats stats;
+      float serial_ms = 0.f, pool_ms = 0.f;
+      for (int i = 0; i < rounds; i++) {
+        profiler.Start();
+        stats = obj_loader::loadTextures(paths, images, nullptr);
+        serial_ms += profiler.Stop();
+        profiler.Start();
+        obj_loader::loadTextures(paths, images, &pool);
+        pool_ms += profiler.Stop();
+      }
+
+      mkdir(cache_dir.c_str(), 0755);
+      obj_loader::TextureDiskCache cache(cache_dir);
+      for (auto& path : paths) std::remove(cache.entryPath(path).c_str());
+      profiler.Start();
+      obj_loader::loadTextures(paths, images, &pool, &cache);
+      float cold_ms = profiler.Stop();
+      float warm_ms = 0.f;
+      obj_loader::TextureLoadStats warm;
+      for (int i = 0; i < rounds; i++) {
+        profiler.Start();
+        warm = obj_loader::loadTextures(paths, images, &pool, &cache);
+        warm_ms += profiler.Stop();
+      }
+      profiler.Reset();
+      for (auto& path : paths) std::remove(cache.entryPath(path).c_str());
+      std::remove(cache_dir.c_str());
+
+      size_t decoded_bytes = 0;
+      for (const obj_loader::Image& image : images) decoded_bytes += image.pixels.size();
+      float source_mb = stats.source_bytes / (1024.f * 1024.f);
+      std::cout << "## textures (" << set.obj << "): " << stats.decoded << " decoded, " << stats.failed << " failed, "
+                << source_mb << " MiB encoded -> " << decoded_bytes / (1024.f * 1024.f) << " MiB rgba with mips" << '\n';
+      // throughput in decoded bytes, the encoded size says little across png and jpg
+      const float decoded_mb = decoded_bytes / (1024.f * 1024.f);
+      std::cout << std::tab << "serial: " << serial_ms / rounds << "ms (" << decoded_mb * rounds * 1000.f / serial_ms << " MB/s)" << '\n';
+      std::cout << std::tab << "pool (" << pool.size() << " threads): " << pool_ms / rounds << "ms ("
+                << decoded_mb * rounds * 1000.f / pool_ms << " MB/s)" << '\n';
+      std::cout << std::tab << "disk cache: " << cold_ms << "ms cold, " << warm_ms / rounds << "ms warm ("
+                << warm.cache_hits << " hits)" << '\n';
+    }
+#else
+    std::cout << "## textures: built without libpng and libjpeg" << '\n';
+#endif
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef LARGE_PROFILE
+  // 32 bit fast path against LARGE_INDICES, and how much the narrowed index buffers save on the sample models
+  {
+    // 2^22 corners keeps the run short. past 2^31 corners (side ~ 19000, a ~30 GB file) is where LARGE_INDICES
+    // is required, which needs a machine with well over 32 GB of memory for the parse and the mesh.
+    const size_t side = 837;
+    const int rounds = 3;
+    const std::string path = "large_grid.obj";
+    size_t bytes = write_position_grid_obj(path, side);
+    float fast_ms = 0.f, large_ms = 0.f;
+    size_t corners = 0;
+    bool same = true;
+    for (int i = 0; i < rounds; i++) {
+      obj_loader::Scene fast, large;
+      profiler.Start();
+      obj_loader::loadObj(path, fast, obj_loader::ParseOption::TRIANGULATE);
+      fast_ms += profiler.Stop();
+      profiler.Start();
+      obj_loader::loadObj(path, large, obj_loader::ParseOption::TRIANGULATE | obj_loader::ParseOption::LARGE_INDICES);
+      large_ms += profiler.Stop();
+      same = same && fast.meshes.size() == 1 && large.meshes.size() == 1 && fast.meshes[0].indices == large.meshes[0].indices;
+      corners = fast.meshes.empty() ? 0 : fast.meshes[0].indices.size();
+    }
+    profiler.Reset();
+    std::remove(path.c_str());
+    float mb = bytes / (1024.f * 1024.f);
+    std::cout << "## large indices (" << path << "): " << corners << " corners, " << mb << " MiB" << (same ? "" : ", MISMATCH") << '\n';
+    std::cout << std::tab << "32 bit: " << fast_ms / rounds << "ms (" << mb * rounds * 1000.f / fast_ms << " MB/s)" << '\n';
+    std::cout << std::tab << "64 bit: " << large_ms / rounds << "ms (" << mb * rounds * 1000.f / large_ms << " MB/s)" << '\n';
+
+    // indices past INT_MAX without generating a file that large: only the wide path resolves them
+    const char* face = "3000000000/7/-1";
+    const char* token = face;
+    obj_loader::BasicVertexIndex<int64_t> wide;
+    bool wide_ok = obj_loader::parseIndices(&token, size_t(3000000000), size_t(1), size_t(7), &wide);
+    token = face;
+    obj_loader::VertexIndex narrow;
+    bool narrow_ok = obj_loader::parseIndices(&token, size_t(3000000000), size_t(1), size_t(7), &narrow);
+    std::cout << std::tab << "f " << face << ": 64 bit " << (wide_ok ? "v " + std::to_string(wide.v_idx) : std::string("rejected"))
+              << ", 32 bit " << (narrow_ok ? "accepted" : "rejected") << '\n';
+
+    size_t histogram[3] = {0, 0, 0};
+    size_t wide_bytes = 0, narrow_bytes = 0;
+    for (auto& str : file_list) {
+      obj_loader::Scene scene;
+      if (!obj_loader::loadObj("../res/" + str, scene, obj_loader::ParseOption::TRIANGULATE)) {
+        continue;
+      }
+      for (const obj_loader::Mesh& mesh : scene.meshes) {
+        obj_loader::IndexBuffer buffer;
+        obj_loader::buildIndexBuffer(mesh, buffer);
+        histogram[static_cast<int>(buffer.type)]++;
+        wide_bytes += mesh.indices.size() * sizeof(unsigned int);
+        narrow_bytes += buffer.data.size();
+      }
+    }
+    std::cout << "## index width over every file: " << histogram[0] << " u16, " << histogram[1] << " u32, " << histogram[2] << " u64 meshes" << '\n';
+    std::cout << std::tab << "index bytes: " << wide_bytes / 1024 << " KiB as u32, " << narrow_bytes / 1024 << " KiB narrowed" << '\n';
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef WELD_PROFILE
+  // tolerance welding of the per corner vertices the loader emits, epsilon relative to the model size
+  {
+    ThreadPool pool;
+    const float tolerance = 1e-5f;
+    for (auto& str : file_list) {
+      obj_loader::Scene scene;
+      profiler.Start();
+      bool res = obj_loader::loadObj("../res/" + str, scene, obj_loader::ParseOption::TRIANGULATE);
+      float load_ms = profiler.Stop();
+      if (!res) {
+        continue;
+      }
+      const float epsilon = std::max(scene.bounds.radius, 1.f) * tolerance;
+      size_t before = 0;
+      for (const obj_loader::Mesh& mesh : scene.meshes) before += mesh.vertices.size();
+
+      obj_loader::Scene pooled = scene;
+      profiler.Start();
+      size_t removed = obj_loader::weldVertices(scene, epsilon);
+      float serial_ms = profiler.Stop();
+      profiler.Start();
+      size_t pool_removed = obj_loader::weldVertices(pooled, epsilon, &pool);
+      float pool_ms = profiler.Stop();
+      profiler.Reset();
+
+      std::cout << "## weld (" << str << "): " << before << " -> " << before - removed << " vertices ("
+                << (before ? removed * 100.f / before : 0.f) << "% removed, epsilon " << epsilon << ")" << '\n';
+      std::cout << std::tab << "load: " << load_ms << "ms, weld: " << serial_ms << "ms, weld (" << pool.size() << " threads): "
+                << pool_ms << "ms" << (pool_removed == removed ? "" : " MISMATCH") << '\n';
+    }
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef TRACE_PROFILE
+  // every file loaded, welded and put in a bvh on a pool, timed with recording off and on, the second run saved as a trace
+#ifdef OBJ_LOADER_TRACE
+  {
+    ThreadPool pool;
+    obj_loader::Tracer& tracer = obj_loader::Tracer::instance();
+    tracer.nameThread("main");
+    auto run = [&]() {
+      pool.parallel_for(file_list.size(), [&](size_t i) {
+        obj_loader::Scene scene;
+        if (obj_loader::loadObj("../res/" + file_list[i], scene, obj_loader::ParseOption::TRIANGULATE)) {
+          obj_loader::weldVertices(scene, std::max(scene.bounds.radius, 1.f) * 1e-5f, &pool);
+          obj_loader::Bvh bvh;
+          bvh.build(scene, &pool);
+        }
+      });
+    };
+    tracer.enable(false);
+    profiler.Start();
+    run();
+    float off_ms = profiler.Stop();
+    tracer.clear();
+    tracer.enable(true);
+    profiler.Start();
+    run();
+    float on_ms = profiler.Stop();
+    tracer.enable(false);
+    profiler.Reset();
+
+    const std::string trace_path = "obj_loader_trace.json";
+    bool written = tracer.write(trace_path);
+    std::ifstream written_file(trace_path, std::ios::binary | std::ios::ate);
+    std::cout << "## trace (" << file_list.size() << " files, " << pool.size() << " threads): " << tracer.event_count() << " events" << '\n';
+    std::cout << std::tab << "recording off: " << off_ms << "ms, on: " << on_ms << "ms" << '\n';
+    std::cout << std::tab << (written ? trace_path + ": " + std::to_string(written_file.tellg() / 1024) + " KB" : "could not write " + trace_path) << '\n';
+  }
+#else
+  std::cout << "## trace: built without OBJ_LOADER_TRACE" << '\n';
+#endif
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef BVH_PROFILE
+  // bvh build against the load itself, serial and on a pool, then closest hit rays through the bounding sphere
+  {
+    ThreadPool pool;
+    const int ray_count = 200000;
+    for (auto& str : file_list) {
+      obj_loader::Scene scene;
+      profiler.Start();
+      bool res = obj_loader::loadObj("../res/" + str, scene, obj_loader::ParseOption::TRIANGULATE);
+      float load_ms = profiler.Stop();
+      if (!res) {
+        continue;
+      }
+
+      obj_loader::Bvh bvh;
+      profiler.Start();
+      bool built = bvh.build(scene);
+      float serial_ms = profiler.Stop();
+      profiler.Start();
+      built = built && bvh.build(scene, &pool);
+      float pool_ms = profiler.Stop();
+      if (!built) {
+        profiler.Reset();
+        continue;
+      }
+
+      // rays from points on a sphere around the model to points near its center
+      std::vector<vec3> origins(ray_count), directions(ray_count);
+      const vec3 c = scene.bounds.center;
+      const float r = scene.bounds.radius;
+      unsigned int seed = 12345;
+      auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / 16777216.f * 2.f - 1.f;
+      };
+      for (int i = 0; i < ray_count; i++) {
+        vec3 d(random(), random(), random());
+        float len = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z) + 1e-6f;
+        origins[i] = vec3(c.x + d.x / len * r * 2.f, c.y + d.y / len * r * 2.f, c.z + d.z / len * r * 2.f);
+        vec3 target(c.x + random() * r * 0.5f, c.y + random() * r * 0.5f, c.z + random() * r * 0.5f);
+        directions[i] = vec3(target.x - origins[i].x, target.y - origins[i].y, target.z - origins[i].z);
+      }
+      size_t hits = 0;
+      profiler.Start();
+      for (int i = 0; i < ray_count; i++) {
+        obj_loader::BvhHit hit;
+        hits += bvh.intersect(origins[i], directions[i], hit);
+      }
+      float query_ms = profiler.Stop();
+      std::vector<size_t> pool_hits(ray_count);
+      profiler.Start();
+      pool.parallel_for(ray_count / 1024, [&](size_t block) {
+        for (size_t i = block * 1024; i < (block + 1) * 1024; i++) {
+          obj_loader::BvhHit hit;
+          pool_hits[i] = bvh.intersect(origins[i], directions[i], hit);
+        }
+      });
+      float pool_query_ms = profiler.Stop();
+      profiler.Reset();
+
+      std::cout << "## bvh (" << str << "): " << bvh.triangles().size() << " triangles, " << bvh.nodes().size() << " nodes" << '\n';
+      std::cout << std::tab << "load: " << load_ms << "ms, build: " << serial_ms << "ms, build (" << pool.size() << " threads): " << pool_ms << "ms" << '\n';
+      std::cout << std::tab << "rays: " << ray_count / (query_ms / 1000.f) / 1e6f << " M rays/s, on the pool: "
+                << (ray_count / 1024 * 1024) / (pool_query_ms / 1000.f) / 1e6f << " M rays/s (" << hits * 100 / ray_count << "% hit)" << '\n';
+    }
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef LAZY_PROFILE
+  // section index: time to the first materialized mesh against a full load, then every section on a pool
+  {
+    ThreadPool pool;
+    for (auto& str : file_list) {
+      obj_loader::Scene scene;
+      profiler.Start();
+      bool res = obj_loader::loadObj("../res/" + str, scene, obj_loader::ParseOption::NONE);
+      float full_ms = profiler.Stop();
+      if (!res) {
+        continue;
+      }
+
+      obj_loader::ObjIndex index;
+      profiler.Start();
+      index.open("../res/" + str);
+      float index_ms = profiler.Stop();
+      obj_loader::Mesh first;
+      profiler.Start();
+      index.loadMesh(0, first, obj_loader::ParseOption::NONE);
+      float first_ms = profiler.Stop();
+
+      std::vector<obj_loader::Mesh> meshes(index.sections().size());
+      profiler.Start();
+      pool.parallel_for(meshes.size(), [&](size_t i) {
+        index.loadMesh(i, meshes[i], obj_loader::ParseOption::NONE);
+      });
+      float all_ms = profiler.Stop();
+      profiler.Reset();
+
+      std::cout << "## lazy (" << str << "): " << index.sections().size() << " sections" << '\n';
+      std::cout << std::tab << "full load: " << full_ms << "ms, index: " << index_ms << "ms, first mesh: " << first_ms
+                << "ms, all sections: " << all_ms << "ms" << '\n';
+    }
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef HOT_RELOAD_PROFILE
+  // latency from the end of a file write to the swap of the reloaded scene, for obj and mtl edits
+  {
+    struct watched {
+      std::string obj_source, obj_copy;
+      std::vector<std::pair<std::string, std::string>> libraries; // source, copy
+      size_t id;
+    };
+    std::vector<watched> files;
+    obj_loader::HotReloader reloader;
+    for (auto& str : file_list) {
+      obj_loader::Scene scene;
+      if (!obj_loader::loadObj("../res/" + str, scene, obj_loader::ParseOption::TRIANGULATE)) {
+        continue;
+      }
+      watched file;
+      file.obj_source = "../res/" + str;
+      file.obj_copy = "hot_reload_" + obj_loader::splitDelims(str, "\\/").second;
+      bool copied = copy_file(file.obj_source, file.obj_copy);
+      // the copy references its libraries by the same relative names, so they land next to it
+      for (const std::string& lib : scene.material_libraries) {
+        std::string name = lib.substr(scene.base_dir.size());
+        file.libraries.emplace_back(lib, name);
+        copied = copied && copy_file(lib, name);
+      }
+      if (copied && reloader.watch(file.obj_copy, obj_loader::ParseOption::TRIANGULATE, file.id)) {
+        files.emplace_back(file);
+      }
+    }
+
+    // reload count and swap time per watched id, written by the listener under the mutex
+    struct reload_state {
+      size_t reloads;
+      std::chrono::steady_clock::time_point swapped;
+    };
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<reload_state> states(files.size(), reload_state{0, std::chrono::steady_clock::time_point()});
+    reloader.setListener([&](size_t id, const std::shared_ptr<const obj_loader::HotReloader::Snapshot>&) {
+      std::lock_guard<std::mutex> lock(mutex);
+      states[id].reloads++;
+      states[id].swapped = std::chrono::steady_clock::now();
+      cv.notify_all();
+    });
+    reloader.start();
+
+    // returns the write-to-swap latency in ms, or -1 when no reload arrived
+    auto measure = [&](const std::string& src, const std::string& dst, size_t id) {
+      size_t reloads;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        reloads = states[id].reloads;
+      }
+      std::chrono::steady_clock::time_point written;
+      copy_file(src, dst, &written);
+      std::unique_lock<std::mutex> lock(mutex);
+      if (!cv.wait_for(lock, std::chrono::seconds(10), [&] { return states[id].reloads != reloads; })) {
+        return -1.f;
+      }
+      return std::chrono::duration<float, std::milli>(states[id].swapped - written).count();
+    };
+
+    // timeouts are reported but kept out of the averages
+    float obj_total = 0.f, mtl_total = 0.f;
+    size_t obj_count = 0, mtl_count = 0;
+    auto print_latency = [](float ms) {
+      if (ms < 0.f) {
+        std::cout << "timeout";
+      } else {
+        std::cout << ms << "ms";
+      }
+    };
+    for (auto& file : files) {
+      float obj_ms = measure(file.obj_source, file.obj_copy, file.id);
+      if (obj_ms >= 0.f) {
+        obj_total += obj_ms;
+        obj_count++;
+      }
+      std::cout << "## hot reload (" << file.obj_copy << "): " << reloader.snapshot(file.id)->scene->meshes.size() << " meshes" << '\n';
+      std::cout << std::tab << "obj: ";
+      print_latency(obj_ms);
+      if (!file.libraries.empty()) {
+        std::shared_ptr<const obj_loader::Scene> geometry = reloader.snapshot(file.id)->scene;
+        float mtl_ms = measure(file.libraries[0].first, file.libraries[0].second, file.id);
+        if (mtl_ms >= 0.f) {
+          mtl_total += mtl_ms;
+          mtl_count++;
+        }
+        std::cout << ", mtl: ";
+        print_latency(mtl_ms);
+        std::cout << (reloader.snapshot(file.id)->scene == geometry ? " (geometry shared)" : " (geometry copied)");
+      }
+      std::cout << '\n';
+    }
+    reloader.stop();
+    std::cout << "average obj reload: " << (obj_count ? obj_total / obj_count : 0.f) << " ms, average mtl reload: "
+              << (mtl_count ? mtl_total / mtl_count : 0.f) << " ms" << '\n';
+
+    for (auto& file : files) {
+      std::remove(file.obj_copy.c_str());
+      for (auto& lib : file.libraries) std::remove(lib.second.c_str());
+    }
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef SCENE_PROFILE
+  // scene graph flattening, ReadFile and our conversion timed apart
+  {
+    ThreadPool pool;
+    float read_total = 0.f, convert_total = 0.f;
+    for (auto& str : file_list) {
+      flat_scene scene;
+      bool res = load_scene_flat("../res/" + str, scene, pool);
+      if (res) {
+        std::cout << "## scene (" << str << "): " << scene.model.meshes.size() << " meshes, " << scene.instances.size() << " instances" << '\n';
+        std::cout << std::tab << "read: " << scene.read_ms << "ms, convert: " << scene.convert_ms << "ms" << '\n';
+        read_total += scene.read_ms;
+        convert_total += scene.convert_ms;
+      }
+    }
+    std::cout << "total read: " << read_total << " ms, total convert: " << convert_total << " ms (" << pool.size() << " threads)" << '\n';
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
+#ifdef POSTPROCESS_PROFILE
+  // same post-processing for every loader, per row of the matrix
+  for (const auto& setting : post_process_matrix()) {
+    std::cout << "## post process (" << setting.name << ")" << '\n';
+    for (auto& str : file_list) {
+      flat_model model;
+      profiler.Start();
+      load_model_flat("../res/" + str, model, setting.assimp_flags);
+      profiler.Stop();
+    }
+    std::cout << std::tab << "ASSIMP: " << profiler.Average() << " ms" << '\n';
+#ifdef TBJ_PROFILE
+    for (auto& str : file_list) {
+      tinyobj::attrib_t tb_attrib;
+      std::vector<tinyobj::shape_t> tb_shapes;
+      std::vector<tinyobj::material_t> tb_materials;
+      std::string tb_warn, tb_err;
+      profiler.Start();
+      tinyobj::LoadObj(&tb_attrib, &tb_shapes, &tb_materials, &tb_warn, &tb_err, ("../res/" + str).c_str(), nullptr, setting.tinyobj_triangulate);
+      profiler.Stop();
+    }
+    std::cout << std::tab << "TBL: " << profiler.Average() << " ms" << (setting.tinyobj_exact ? "" : " *") << '\n';
+#endif
+    for (auto& str : file_list) {
+      obj_loader::Scene scene;
+      profiler.Start();
+      if (obj_loader::loadObj("../res/" + str, scene, setting.obj_option) && setting.obj_weld) {
+        // identical vertices only, the tolerance just absorbs float noise at the model's scale
+        obj_loader::weldVertices(scene, std::max(scene.bounds.radius, 1.f) * 1e-6f);
+      }
+      profiler.Stop();
+    }
+    std::cout << std::tab << "OBJ: " << profiler.Average() << " ms" << '\n';
+  }
+  std::cout << "===========================================================" << '\n';
+#endif
+
 #ifdef OBJL_PROFILE
   // OBJ Loader
   for (auto& str : file_list) {
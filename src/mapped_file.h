@@ -0,0 +1,93 @@
+#ifndef MODEL_LOAD_MAPPED_FILE_H
+#define MODEL_LOAD_MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// read only memory map of a whole file
+class MappedFile {
+public:
+  MappedFile() : ptr(nullptr), length(0) {}
+  explicit MappedFile(const std::string& path) : ptr(nullptr), length(0) { open(path); }
+  ~MappedFile() { close(); }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+      CloseHandle(file);
+      return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+      return false;
+    }
+    ptr = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(mapping);
+    if (!ptr) {
+      return false;
+    }
+    length = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      return false;
+    }
+    void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+      return false;
+    }
+    madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    ptr = static_cast<const char*>(p);
+    length = static_cast<size_t>(st.st_size);
+#endif
+    return true;
+  }
+
+  void close() {
+    if (!ptr) {
+      return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(ptr);
+#else
+    munmap(const_cast<char*>(ptr), length);
+#endif
+    ptr = nullptr;
+    length = 0;
+  }
+
+  bool is_open() const { return ptr != nullptr; }
+  const char* data() const { return ptr; }
+  size_t size() const { return length; }
+
+private:
+  const char* ptr;
+  size_t length;
+};
+
+#endif //MODEL_LOAD_MAPPED_FILE_H
@@ -0,0 +1,245 @@
+#ifndef MODEL_LOAD_MESH_CACHE_H
+#define MODEL_LOAD_MESH_CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "obj_loader.h"
+
+namespace obj_loader {
+  struct MeshHash {
+    MeshHash() : lo(0), hi(0) {}
+    bool operator==(const MeshHash& rhs) const { return lo == rhs.lo && hi == rhs.hi; }
+    uint64_t lo, hi;
+  };
+
+  struct MeshHashHasher {
+    size_t operator()(const MeshHash& h) const { return static_cast<size_t>(h.lo); }
+  };
+
+  namespace mesh_hash_detail {
+    inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    inline uint64_t fmix(uint64_t k) {
+      k ^= k >> 33;
+      k *= 0xff51afd7ed558ccdULL;
+      k ^= k >> 33;
+      k *= 0xc4ceb9fe1a85ec53ULL;
+      k ^= k >> 33;
+      return k;
+    }
+
+    // MurmurHash3 x64 128, continued from the state in h so several buffers hash as one
+    inline void murmur3(const void* data, size_t len, MeshHash& h) {
+      const uint64_t c1 = 0x87c37b91114253d5ULL, c2 = 0x4cf5ad432745937fULL;
+      const unsigned char* p = static_cast<const unsigned char*>(data);
+      uint64_t h1 = h.lo, h2 = h.hi;
+      const size_t blocks = len / 16;
+      for (size_t i = 0; i < blocks; i++) {
+        uint64_t k1, k2;
+        memcpy(&k1, p + i * 16, 8);
+        memcpy(&k2, p + i * 16 + 8, 8);
+        k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+        k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+      }
+      const unsigned char* tail = p + blocks * 16;
+      uint64_t k1 = 0, k2 = 0;
+      switch (len & 15) {
+        case 15: k2 ^= static_cast<uint64_t>(tail[14]) << 48; // fall through
+        case 14: k2 ^= static_cast<uint64_t>(tail[13]) << 40; // fall through
+        case 13: k2 ^= static_cast<uint64_t>(tail[12]) << 32; // fall through
+        case 12: k2 ^= static_cast<uint64_t>(tail[11]) << 24; // fall through
+        case 11: k2 ^= static_cast<uint64_t>(tail[10]) << 16; // fall through
+        case 10: k2 ^= static_cast<uint64_t>(tail[9]) << 8; // fall through
+        case 9: k2 ^= static_cast<uint64_t>(tail[8]);
+          k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2; // fall through
+        case 8: k1 ^= static_cast<uint64_t>(tail[7]) << 56; // fall through
+        case 7: k1 ^= static_cast<uint64_t>(tail[6]) << 48; // fall through
+        case 6: k1 ^= static_cast<uint64_t>(tail[5]) << 40; // fall through
+        case 5: k1 ^= static_cast<uint64_t>(tail[4]) << 32; // fall through
+        case 4: k1 ^= static_cast<uint64_t>(tail[3]) << 24; // fall through
+        case 3: k1 ^= static_cast<uint64_t>(tail[2]) << 16; // fall through
+        case 2: k1 ^= static_cast<uint64_t>(tail[1]) << 8; // fall through
+        case 1: k1 ^= static_cast<uint64_t>(tail[0]);
+          k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+          break;
+        default:
+          break;
+      }
+      h1 ^= len; h2 ^= len;
+      h1 += h2; h2 += h1;
+      h1 = fmix(h1); h2 = fmix(h2);
+      h1 += h2; h2 += h1;
+      h.lo = h1;
+      h.hi = h2;
+    }
+  }
+
+  // 128 bit content hash of the vertex and index data of a mesh. name, material and bounds are not part of it.
+  inline MeshHash hashMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+    static_assert(sizeof(Vertex) == 11 * sizeof(float), "Vertex must have no padding to be hashed as bytes");
+    MeshHash h;
+    uint64_t counts[2] = {vertices.size(), indices.size()};
+    mesh_hash_detail::murmur3(counts, sizeof(counts), h);
+    if (!vertices.empty()) mesh_hash_detail::murmur3(vertices.data(), vertices.size() * sizeof(Vertex), h);
+    if (!indices.empty()) mesh_hash_detail::murmur3(indices.data(), indices.size() * sizeof(unsigned int), h);
+    return h;
+  }
+
+  // immutable geometry shared by every mesh with the same content
+  struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    Bounds bounds;
+    MeshHash hash;
+    size_t bytes() const { return vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int); }
+  };
+
+  // a mesh of a scene whose geometry lives in a MeshCache
+  struct MeshInstance {
+    MeshInstance() : name(), material_id(-1), data() {}
+    std::string name;
+    int material_id;
+    std::shared_ptr<const MeshData> data;
+  };
+
+  // Content addressed mesh storage shared across loads (and threads). A mesh whose vertex and index bytes
+  // match one already interned gets the existing storage; the cache only holds weak references,
+  // so geometry is freed with its last user.
+  // NOTE: meshes loaded into a packed VertexBuffer (vertices live in the buffer) or with 64 bit indices
+  // are passed through untouched, only meshes owning their vertices and 32 bit indices are deduplicated.
+  class MeshCache {
+  public:
+    MeshCache() : entries(), mutex(), hits(0), misses(0), saved(0) {}
+
+    // takes the geometry out of mesh (its vertices and indices are left empty) and returns the shared copy,
+    // or returns null and leaves the mesh as it is when it can't be cached
+    std::shared_ptr<const MeshData> intern(Mesh& mesh) {
+      if (!cacheable(mesh)) {
+        return nullptr;
+      }
+      MeshHash hash = hashMesh(mesh.vertices, mesh.indices);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<const MeshData> found = findLocked(hash, mesh);
+        if (found) {
+          hits++;
+          saved += found->bytes();
+          mesh.vertices = std::vector<Vertex>();
+          mesh.indices = std::vector<unsigned int>();
+          return found;
+        }
+      }
+
+      std::shared_ptr<MeshData> data = std::make_shared<MeshData>();
+      data->vertices.swap(mesh.vertices);
+      data->indices.swap(mesh.indices);
+      data->bounds = mesh.bounds;
+      data->hash = hash;
+
+      std::lock_guard<std::mutex> lock(mutex);
+      // a racing intern of the same content may have won meanwhile, keep one copy
+      std::shared_ptr<const MeshData> found = findLocked(hash, *data);
+      if (found) {
+        hits++;
+        saved += found->bytes();
+        return found;
+      }
+      misses++;
+      entries[hash].emplace_back(data);
+      return data;
+    }
+
+    // moves every cacheable mesh of the scene into the cache, only the others are left in scene.meshes
+    void intern(Scene& scene, std::vector<MeshInstance>& instances) {
+      instances.reserve(instances.size() + scene.meshes.size());
+      std::vector<Mesh> kept;
+      for (Mesh& mesh : scene.meshes) {
+        if (!cacheable(mesh)) {
+          kept.emplace_back(std::move(mesh));
+          continue;
+        }
+        MeshInstance instance;
+        instance.name = mesh.name;
+        instance.material_id = mesh.material_id;
+        instance.data = intern(mesh);
+        instances.emplace_back(std::move(instance));
+      }
+      scene.meshes.swap(kept);
+    }
+
+    static bool cacheable(const Mesh& mesh) {
+      return !(mesh.vertices.empty() && mesh.vertex_count) && mesh.indices64.empty();
+    }
+
+    size_t hit_count() const { std::lock_guard<std::mutex> lock(mutex); return hits; }
+    size_t miss_count() const { std::lock_guard<std::mutex> lock(mutex); return misses; }
+    // geometry bytes that matched existing storage instead of being kept a second time
+    size_t bytes_saved() const { std::lock_guard<std::mutex> lock(mutex); return saved; }
+
+    // geometry bytes of the meshes still alive
+    size_t bytes_stored() const {
+      std::lock_guard<std::mutex> lock(mutex);
+      size_t bytes = 0;
+      for (const auto& it : entries) {
+        for (const auto& weak : it.second) {
+          std::shared_ptr<const MeshData> data = weak.lock();
+          if (data) bytes += data->bytes();
+        }
+      }
+      return bytes;
+    }
+
+    void clear() {
+      std::lock_guard<std::mutex> lock(mutex);
+      entries.clear();
+    }
+
+  private:
+    // a hash match is confirmed byte for byte, a collision only costs a second entry under the key
+    template <typename T>
+    std::shared_ptr<const MeshData> findLocked(const MeshHash& hash, const T& mesh) {
+      auto it = entries.find(hash);
+      if (it == entries.end()) {
+        return nullptr;
+      }
+      std::vector<std::weak_ptr<const MeshData>>& list = it->second;
+      for (size_t i = 0; i < list.size();) {
+        std::shared_ptr<const MeshData> data = list[i].lock();
+        if (!data) {
+          list[i] = list.back(); // freed by its last user
+          list.pop_back();
+          continue;
+        }
+        if (sameGeometry(*data, mesh)) {
+          return data;
+        }
+        i++;
+      }
+      if (list.empty()) {
+        entries.erase(it);
+      }
+      return nullptr;
+    }
+
+    template <typename T>
+    static bool sameGeometry(const MeshData& data, const T& mesh) {
+      return data.vertices.size() == mesh.vertices.size() && data.indices.size() == mesh.indices.size() &&
+             (data.vertices.empty() || 0 == memcmp(data.vertices.data(), mesh.vertices.data(), data.vertices.size() * sizeof(Vertex))) &&
+             (data.indices.empty() || 0 == memcmp(data.indices.data(), mesh.indices.data(), data.indices.size() * sizeof(unsigned int)));
+    }
+
+    std::unordered_map<MeshHash, std::vector<std::weak_ptr<const MeshData>>, MeshHashHasher> entries;
+    mutable std::mutex mutex;
+    size_t hits;
+    size_t misses;
+    size_t saved;
+  };
+}
+
+#endif //MODEL_LOAD_MESH_CACHE_H
@@ -0,0 +1,425 @@
+#ifndef MODEL_LOAD_MESH_SIMPLIFY_H
+#define MODEL_LOAD_MESH_SIMPLIFY_H
+
+#include <vector>
+#include <cstring>
+#include <cfloat>
+#include <algorithm>
+#include "obj_loader.h"
+
+namespace obj_loader {
+  enum class SimplifyOption {
+    NONE = 0,
+    LOCK_BORDER = 1 << 0, // keep open mesh borders (material boundaries between meshes) fixed
+  };
+
+  inline bool operator&(const SimplifyOption a, const SimplifyOption b) {
+    return static_cast<SimplifyOption>(static_cast<unsigned int>(a) & static_cast<unsigned int>(b)) == b;
+  }
+
+  inline SimplifyOption operator|(const SimplifyOption a, const SimplifyOption b) {
+    return static_cast<SimplifyOption>(static_cast<unsigned int>(a) | static_cast<unsigned int>(b));
+  }
+
+  // one level of a lod chain. indices refer to the vertex buffer of the source mesh.
+  struct LodLevel {
+    LodLevel() : indices(), ratio(1.f), error(0.f) { indices.clear(); }
+    std::vector<unsigned int> indices;
+    float ratio; // requested fraction of the source triangle count
+    float error; // achieved deviation, relative to the mesh extent
+  };
+
+  namespace simplify_detail {
+    // symmetric 4x4 plane quadric
+    struct Quadric {
+      Quadric() : a00(0), a11(0), a22(0), a10(0), a20(0), a21(0), b0(0), b1(0), b2(0), c(0), w(0) {}
+      float a00, a11, a22, a10, a20, a21, b0, b1, b2, c;
+      float w; // accumulated weight, keeps the error in distance units
+    };
+
+    enum VertexKind : unsigned char {
+      KIND_MANIFOLD, // interior vertex with a single attribute wedge
+      KIND_BORDER, // vertex on an open border
+      KIND_SEAM, // vertex on an attribute seam (exactly two wedges)
+      KIND_LOCKED, // anything else, never moves
+    };
+
+    struct Collapse {
+      unsigned int v0, v1; // v0 moves onto v1 (position ids)
+      float error;
+    };
+
+    inline void addPlane(Quadric& q, float a, float b, float c, float d, float w) {
+      q.a00 += w * a * a; q.a11 += w * b * b; q.a22 += w * c * c;
+      q.a10 += w * b * a; q.a20 += w * c * a; q.a21 += w * c * b;
+      q.b0 += w * d * a; q.b1 += w * d * b; q.b2 += w * d * c;
+      q.c += w * d * d;
+      q.w += w;
+    }
+
+    inline void addQuadric(Quadric& q, const Quadric& r) {
+      q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+      q.a10 += r.a10; q.a20 += r.a20; q.a21 += r.a21;
+      q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+      q.c += r.c;
+      q.w += r.w;
+    }
+
+    inline float quadricError(const Quadric& q, const vec3& p) {
+      float rx = q.a00 * p.x + q.a10 * p.y + q.a20 * p.z;
+      float ry = q.a10 * p.x + q.a11 * p.y + q.a21 * p.z;
+      float rz = q.a20 * p.x + q.a21 * p.y + q.a22 * p.z;
+      float r = rx * p.x + ry * p.y + rz * p.z + 2 * (q.b0 * p.x + q.b1 * p.y + q.b2 * p.z) + q.c;
+      r = q.w > 0.f ? r / q.w : 0.f;
+      return r < 0.f ? 0.f : r;
+    }
+
+    inline vec3 cross(const vec3& a, const vec3& b) {
+      return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+    }
+
+    inline float dot(const vec3& a, const vec3& b) {
+      return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    inline unsigned int hashWords(const unsigned int* words, size_t count) {
+      // murmur2 style mixing, enough for an open addressing table
+      unsigned int h = 0;
+      for (size_t i = 0; i < count; i++) {
+        unsigned int k = words[i] * 0x5bd1e995;
+        k ^= k >> 24;
+        h = (h * 0x5bd1e995) ^ (k * 0x5bd1e995);
+      }
+      return h ^ (h >> 13);
+    }
+
+    // maps every vertex to the first vertex whose leading `words` 32-bit words are bitwise equal.
+    // Vertex starts with position, texcoord, normal so words = 3 keys on position only, 8 on all attributes.
+    inline void buildRemap(const std::vector<Vertex>& vertices, size_t words, std::vector<unsigned int>& remap) {
+      static_assert(sizeof(vec3) == 12 && sizeof(vec2) == 8, "tightly packed vectors expected");
+      size_t table_size = 1;
+      while (table_size < vertices.size() * 2) table_size *= 2;
+      std::vector<unsigned int> table(table_size, ~0u);
+      remap.resize(vertices.size());
+
+      for (size_t i = 0; i < vertices.size(); i++) {
+        const unsigned int* key = reinterpret_cast<const unsigned int*>(&vertices[i]);
+        size_t bucket = hashWords(key, words) & (table_size - 1);
+        for (;;) {
+          unsigned int slot = table[bucket];
+          if (slot == ~0u) {
+            table[bucket] = static_cast<unsigned int>(i);
+            remap[i] = static_cast<unsigned int>(i);
+            break;
+          }
+          if (0 == memcmp(key, &vertices[slot], words * sizeof(unsigned int))) {
+            remap[i] = slot;
+            break;
+          }
+          bucket = (bucket + 1) & (table_size - 1);
+        }
+      }
+    }
+
+    // compressed adjacency: triangles incident to each position id
+    struct Adjacency {
+      std::vector<unsigned int> offsets;
+      std::vector<unsigned int> triangles;
+    };
+
+    inline void buildAdjacency(Adjacency& adj, const std::vector<unsigned int>& indices, const std::vector<unsigned int>& pos, size_t vertex_count) {
+      adj.offsets.assign(vertex_count + 1, 0);
+      for (unsigned int i : indices) {
+        adj.offsets[pos[i] + 1]++;
+      }
+      for (size_t i = 0; i < vertex_count; i++) {
+        adj.offsets[i + 1] += adj.offsets[i];
+      }
+      adj.triangles.resize(indices.size());
+      std::vector<unsigned int> fill(adj.offsets.begin(), adj.offsets.end() - 1);
+      for (size_t i = 0; i < indices.size(); i++) {
+        adj.triangles[fill[pos[indices[i]]]++] = static_cast<unsigned int>(i / 3);
+      }
+    }
+
+    inline bool hasHalfEdge(const Adjacency& adj, const std::vector<unsigned int>& indices, const std::vector<unsigned int>& pos, unsigned int a, unsigned int b) {
+      for (unsigned int k = adj.offsets[a]; k < adj.offsets[a + 1]; k++) {
+        const unsigned int* tri = &indices[adj.triangles[k] * 3];
+        for (int e = 0; e < 3; e++) {
+          if (pos[tri[e]] == a && pos[tri[(e + 1) % 3]] == b) return true;
+        }
+      }
+      return false;
+    }
+
+    // find the wedge of v1 that shares an edge with wedge w0 of v0, or ~0u.
+    inline unsigned int matchWedge(const Adjacency& adj, const std::vector<unsigned int>& indices, const std::vector<unsigned int>& pos,
+                                   unsigned int w0, unsigned int v1) {
+      unsigned int v0 = pos[w0];
+      for (unsigned int k = adj.offsets[v0]; k < adj.offsets[v0 + 1]; k++) {
+        const unsigned int* tri = &indices[adj.triangles[k] * 3];
+        if (tri[0] != w0 && tri[1] != w0 && tri[2] != w0) continue;
+        for (int e = 0; e < 3; e++) {
+          if (pos[tri[e]] == v1) return tri[e];
+        }
+      }
+      return ~0u;
+    }
+
+    inline bool hasTriangleFlip(const Adjacency& adj, const std::vector<unsigned int>& indices, const std::vector<unsigned int>& pos,
+                                const std::vector<vec3>& positions, unsigned int v0, unsigned int v1) {
+      const vec3& target = positions[v1];
+      for (unsigned int k = adj.offsets[v0]; k < adj.offsets[v0 + 1]; k++) {
+        const unsigned int* tri = &indices[adj.triangles[k] * 3];
+        unsigned int a = pos[tri[0]], b = pos[tri[1]], c = pos[tri[2]];
+        if (a == v1 || b == v1 || c == v1) continue; // collapses away
+        // rotate so that v0 comes first
+        if (b == v0) { std::swap(a, b); std::swap(b, c); }
+        else if (c == v0) { std::swap(a, c); std::swap(b, c); }
+        vec3 pb = positions[b], pc = positions[c];
+        vec3 n0 = cross(pb - positions[a], pc - positions[a]);
+        vec3 n1 = cross(pb - target, pc - target);
+        if (dot(n0, n1) <= 0.f) return true;
+      }
+      return false;
+    }
+  }
+
+  // Simplifies a triangle list by half-edge collapses onto existing vertices, so the result keeps indexing mesh.vertices.
+  // Vertices that share a position but differ in texcoord/normal are seam wedges; a seam only collapses along itself.
+  // Stops at target_index_count or when the next collapse exceeds target_error (relative to the mesh extent).
+  // Returns the achieved error, or a negative value when indices is not a triangle list.
+  inline float simplify(const Mesh& mesh, const std::vector<unsigned int>& indices, size_t target_index_count, float target_error,
+                        SimplifyOption option, std::vector<unsigned int>& out) {
+    using namespace simplify_detail;
+    out.clear();
+    if (indices.size() % 3 != 0) {
+      return -1.f;
+    }
+
+    const std::vector<Vertex>& vertices = mesh.vertices;
+    size_t vertex_count = vertices.size();
+
+    // canonical wedge (all attributes equal, tangent ignored) and canonical position per vertex
+    std::vector<unsigned int> wedge_remap, pos;
+    buildRemap(vertices, 8, wedge_remap);
+    buildRemap(vertices, 3, pos);
+
+    out.resize(indices.size());
+    for (size_t i = 0; i < indices.size(); i++) {
+      out[i] = wedge_remap[indices[i]];
+    }
+
+    // normalized positions keep the quadrics well conditioned
+    vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    for (unsigned int i : out) {
+      const vec3& p = vertices[i].position;
+      lo.x = std::min(lo.x, p.x); lo.y = std::min(lo.y, p.y); lo.z = std::min(lo.z, p.z);
+      hi.x = std::max(hi.x, p.x); hi.y = std::max(hi.y, p.y); hi.z = std::max(hi.z, p.z);
+    }
+    float extent = std::max(hi.x - lo.x, std::max(hi.y - lo.y, hi.z - lo.z));
+    float scale = extent > 0.f ? 1.f / extent : 0.f;
+    std::vector<vec3> positions(vertex_count);
+    for (size_t i = 0; i < vertex_count; i++) {
+      if (pos[i] != i) continue;
+      const vec3& p = vertices[i].position;
+      positions[i] = vec3((p.x - lo.x) * scale, (p.y - lo.y) * scale, (p.z - lo.z) * scale);
+    }
+
+    // wedge count per position
+    std::vector<unsigned int> wedge_count(vertex_count, 0);
+    std::vector<unsigned char> wedge_seen(vertex_count, 0);
+    for (unsigned int w : out) {
+      if (!wedge_seen[w]) {
+        wedge_seen[w] = 1;
+        wedge_count[pos[w]]++;
+      }
+    }
+
+    Adjacency adj;
+    buildAdjacency(adj, out, pos, vertex_count);
+
+    // classify and accumulate quadrics
+    std::vector<unsigned char> kind(vertex_count, KIND_MANIFOLD);
+    std::vector<Quadric> quadrics(vertex_count);
+    for (size_t t = 0; t < out.size(); t += 3) {
+      unsigned int v[3] = {pos[out[t]], pos[out[t + 1]], pos[out[t + 2]]};
+      vec3 n = cross(positions[v[1]] - positions[v[0]], positions[v[2]] - positions[v[0]]);
+      float area = std::sqrt(dot(n, n));
+      if (area > 0.f) {
+        n = vec3(n.x / area, n.y / area, n.z / area);
+        for (int e = 0; e < 3; e++) {
+          addPlane(quadrics[v[e]], n.x, n.y, n.z, -dot(n, positions[v[0]]), area);
+        }
+      }
+
+      for (int e = 0; e < 3; e++) {
+        unsigned int a = v[e], b = v[(e + 1) % 3];
+        if (hasHalfEdge(adj, out, pos, b, a)) continue;
+        // open edge: constrain movement away from the border with a perpendicular plane
+        kind[a] = kind[b] = KIND_BORDER;
+        vec3 edge = positions[b] - positions[a];
+        vec3 pn = cross(edge, n);
+        float len = std::sqrt(dot(pn, pn));
+        if (len > 0.f) {
+          pn = vec3(pn.x / len, pn.y / len, pn.z / len);
+          float w = 10.f * std::sqrt(dot(edge, edge));
+          addPlane(quadrics[a], pn.x, pn.y, pn.z, -dot(pn, positions[a]), w);
+          addPlane(quadrics[b], pn.x, pn.y, pn.z, -dot(pn, positions[a]), w);
+        }
+      }
+    }
+    for (size_t i = 0; i < vertex_count; i++) {
+      if (wedge_count[i] == 2 && kind[i] == KIND_MANIFOLD) kind[i] = KIND_SEAM;
+      else if (wedge_count[i] > 1) kind[i] = KIND_LOCKED;
+      else if (kind[i] == KIND_BORDER && (option & SimplifyOption::LOCK_BORDER)) kind[i] = KIND_LOCKED;
+    }
+
+    // wedges of each position, needed to move seam vertices as a whole
+    std::vector<unsigned int> wedge_next(vertex_count);
+    for (size_t i = 0; i < vertex_count; i++) wedge_next[i] = static_cast<unsigned int>(i);
+    for (size_t i = 0; i < vertex_count; i++) {
+      if (!wedge_seen[i] || pos[i] == i) continue;
+      unsigned int head = pos[i];
+      wedge_next[i] = wedge_next[head];
+      wedge_next[head] = static_cast<unsigned int>(i);
+    }
+
+    float error_limit = target_error * target_error;
+    float result_error = 0.f;
+    std::vector<Collapse> collapses;
+    std::vector<unsigned int> order;
+    std::vector<unsigned char> touched(vertex_count);
+    std::vector<unsigned int> wedge_target(vertex_count);
+
+    while (out.size() > target_index_count) {
+      // candidate edges, each interior edge once
+      collapses.clear();
+      for (size_t t = 0; t < out.size(); t += 3) {
+        for (int e = 0; e < 3; e++) {
+          unsigned int a = pos[out[t + e]], b = pos[out[t + (e + 1) % 3]];
+          if (a > b && hasHalfEdge(adj, out, pos, b, a)) continue;
+
+          Collapse c;
+          c.error = FLT_MAX;
+          unsigned char ka = kind[a], kb = kind[b];
+          bool a_movable = ka != KIND_LOCKED && (ka == KIND_MANIFOLD || kb == ka || kb == KIND_LOCKED);
+          bool b_movable = kb != KIND_LOCKED && (kb == KIND_MANIFOLD || ka == kb || ka == KIND_LOCKED);
+          if (a_movable) {
+            c.v0 = a; c.v1 = b; c.error = quadricError(quadrics[a], positions[b]);
+          }
+          if (b_movable) {
+            float eb = quadricError(quadrics[b], positions[a]);
+            if (eb < c.error) {
+              c.v0 = b; c.v1 = a; c.error = eb;
+            }
+          }
+          if (c.error != FLT_MAX) collapses.emplace_back(c);
+        }
+      }
+      if (collapses.empty()) break;
+
+      order.resize(collapses.size());
+      for (size_t i = 0; i < order.size(); i++) order[i] = static_cast<unsigned int>(i);
+      std::sort(order.begin(), order.end(), [&collapses](unsigned int l, unsigned int r) {
+        return collapses[l].error < collapses[r].error;
+      });
+
+      std::fill(touched.begin(), touched.end(), 0);
+      for (size_t i = 0; i < vertex_count; i++) wedge_target[i] = static_cast<unsigned int>(i);
+
+      size_t triangles = out.size() / 3;
+      size_t target_triangles = target_index_count / 3;
+      size_t removed = 0;
+      size_t applied = 0;
+
+      for (unsigned int ci : order) {
+        const Collapse& c = collapses[ci];
+        if (c.error > error_limit) break;
+        if (triangles - removed <= target_triangles) break;
+        if (touched[c.v0] || touched[c.v1]) continue;
+
+        // every wedge of v0 must have a distinct partner wedge on v1, otherwise the collapse tears a seam
+        bool valid = true;
+        unsigned int w = c.v0;
+        unsigned int first_match = ~0u;
+        do {
+          if (wedge_seen[w]) {
+            unsigned int m = matchWedge(adj, out, pos, w, c.v1);
+            if (m == ~0u || m == first_match) {
+              valid = false;
+              break;
+            }
+            if (first_match == ~0u) first_match = m;
+            wedge_target[w] = m;
+          }
+          w = wedge_next[w];
+        } while (w != c.v0);
+
+        // border vertices only slide along their own border edge
+        if (valid && kind[c.v0] == KIND_BORDER && hasHalfEdge(adj, out, pos, c.v0, c.v1) == hasHalfEdge(adj, out, pos, c.v1, c.v0)) {
+          valid = false;
+        }
+        if (valid && hasTriangleFlip(adj, out, pos, positions, c.v0, c.v1)) {
+          valid = false;
+        }
+        if (!valid) {
+          w = c.v0;
+          do { wedge_target[w] = w; w = wedge_next[w]; } while (w != c.v0);
+          continue;
+        }
+
+        addQuadric(quadrics[c.v1], quadrics[c.v0]);
+        touched[c.v0] = touched[c.v1] = 1;
+        removed += kind[c.v0] == KIND_BORDER ? 1 : 2;
+        result_error = std::max(result_error, c.error);
+        applied++;
+      }
+      if (applied == 0) break;
+
+      // remap and drop degenerate triangles
+      size_t write = 0;
+      for (size_t t = 0; t < out.size(); t += 3) {
+        unsigned int a = wedge_target[out[t]], b = wedge_target[out[t + 1]], c = wedge_target[out[t + 2]];
+        if (pos[a] == pos[b] || pos[b] == pos[c] || pos[c] == pos[a]) continue;
+        out[write++] = a; out[write++] = b; out[write++] = c;
+      }
+      out.resize(write);
+      buildAdjacency(adj, out, pos, vertex_count);
+    }
+
+    return std::sqrt(result_error);
+  }
+
+  // Builds a chain of lod index buffers over mesh.vertices, each level simplified from the previous one.
+  inline bool generateLods(const Mesh& mesh, const std::vector<float>& ratios, std::vector<LodLevel>& lods,
+                           SimplifyOption option = SimplifyOption::LOCK_BORDER, float target_error = FLT_MAX) {
+    OBJ_LOADER_TRACE_SCOPE("lods");
+    lods.clear();
+    if (mesh.indices.size() % 3 != 0) {
+      return false;
+    }
+
+    const std::vector<unsigned int>* source = &mesh.indices;
+    float error = 0.f;
+    lods.reserve(ratios.size());
+    for (float ratio : ratios) {
+      LodLevel lod;
+      lod.ratio = ratio;
+      size_t target = static_cast<size_t>(mesh.indices.size() / 3 * ratio) * 3;
+      float e = simplify(mesh, *source, target, target_error, option, lod.indices);
+      if (e < 0.f) {
+        lods.clear();
+        return false;
+      }
+      error = std::max(error, e);
+      lod.error = error;
+      lods.emplace_back(std::move(lod));
+      source = &lods.back().indices;
+    }
+
+    return true;
+  }
+}
+
+#endif //MODEL_LOAD_MESH_SIMPLIFY_H
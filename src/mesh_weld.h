@@ -0,0 +1,279 @@
+#ifndef MODEL_LOAD_MESH_WELD_H
+#define MODEL_LOAD_MESH_WELD_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "obj_loader.h"
+#include "thread_pool.h"
+
+namespace obj_loader {
+  namespace weld_detail {
+    // one vertex in the grid with its position, sorted by cell key then vertex index
+    struct Entry {
+      uint64_t key;
+      uint32_t vertex;
+      float position[3];
+      bool operator<(const Entry& rhs) const { return key < rhs.key || (key == rhs.key && vertex < rhs.vertex); }
+    };
+
+    static const float cell_scale = 32.f; // grid cell size in epsilons, large enough that most cells have no vertex near a border
+    static const float border = 1.125f; // distance to a cell border, in epsilons, below which the next cell is searched too
+    static const size_t min_chunk = 16 * 1024; // smaller meshes build their grid on the calling thread
+
+    // integer cell of a coordinate, clamped so huge or non finite values still land in some cell
+    inline int32_t cellOf(float v, float inv_cell) {
+      float c = std::floor(v * inv_cell);
+      if (!(c > -2e9f)) c = c != c ? 0.f : -2e9f;
+      if (c > 2e9f) c = 2e9f;
+      return static_cast<int32_t>(c);
+    }
+
+    inline uint64_t cellKey(int32_t x, int32_t y, int32_t z) {
+      uint64_t k = static_cast<uint32_t>(x) * 0x9e3779b97f4a7c15ULL;
+      k ^= static_cast<uint32_t>(y) * 0xc2b2ae3d27d4eb4fULL;
+      k ^= static_cast<uint32_t>(z) * 0x165667b19e3779f9ULL;
+      k ^= k >> 29;
+      k *= 0xbf58476d1ce4e5b9ULL;
+      return k ^ (k >> 32);
+    }
+
+    // cell of a position and, per axis, the neighbouring cell (-1, +1) a vertex within epsilon may lie in, 0 if none.
+    // the border margin covers rounding, so every vertex within epsilon is in one of the cells. true if only the own cell is.
+    inline bool cellRange(const float* p, float inv_cell, int32_t* base, int32_t* step) {
+      bool inside = true;
+      for (int a = 0; a < 3; a++) {
+        base[a] = cellOf(p[a], inv_cell);
+        float frac = (p[a] * inv_cell - std::floor(p[a] * inv_cell)) * cell_scale;
+        step[a] = frac < border ? -1 : (cell_scale - frac < border ? 1 : 0);
+        inside = inside && step[a] == 0;
+      }
+      return inside;
+    }
+
+    inline bool sameAttributes(const Vertex& a, const Vertex& b) {
+      return float_comapre(a.texcoord.x, b.texcoord.x) && float_comapre(a.texcoord.y, b.texcoord.y) &&
+             float_comapre(a.normal.x, b.normal.x) && float_comapre(a.normal.y, b.normal.y) && float_comapre(a.normal.z, b.normal.z);
+    }
+
+    inline bool within(const float* a, const float* b, float eps2) {
+      float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+      return dx * dx + dy * dy + dz * dz <= eps2;
+    }
+
+    // spatial hash over the cells of a mesh, stored as one sorted entry array plus a bucket offset table
+    // (indexed by the top bits of the cell key). a cell is a contiguous run of entries, so welding walks
+    // the array front to back and a lookup is a table read and a short search.
+    class Grid {
+    public:
+      Grid() : entries(), offsets(), shift(64), inv_cell(0.f) {}
+
+      // buckets are counted and scattered per chunk, then sorted per bucket range, both on the pool
+      void build(const std::vector<Vertex>& vertices, float cell, ThreadPool* pool) {
+        const size_t count = vertices.size();
+        inv_cell = 1.f / cell;
+        unsigned int bits = 8;
+        while (bits < 16 && (size_t(1) << bits) * 4 < count) bits++;
+        shift = 64 - bits;
+        const size_t bucket_count = size_t(1) << bits;
+
+        const size_t chunks = chunkCount(count, pool);
+        std::vector<uint64_t> keys(count);
+        std::vector<uint32_t> histogram(chunks * bucket_count, 0);
+        each(chunks, pool, [&](size_t c) {
+          uint32_t* counts = &histogram[c * bucket_count];
+          for (size_t i = count * c / chunks, end = count * (c + 1) / chunks; i < end; i++) {
+            const vec3& p = vertices[i].position;
+            keys[i] = cellKey(cellOf(p.x, inv_cell), cellOf(p.y, inv_cell), cellOf(p.z, inv_cell));
+            counts[keys[i] >> shift]++;
+          }
+        });
+
+        // bucket major prefix sum, each chunk then owns a disjoint slice of every bucket
+        offsets.assign(bucket_count + 1, 0);
+        uint32_t total = 0;
+        for (size_t b = 0; b < bucket_count; b++) {
+          offsets[b] = total;
+          for (size_t c = 0; c < chunks; c++) {
+            uint32_t n = histogram[c * bucket_count + b];
+            histogram[c * bucket_count + b] = total;
+            total += n;
+          }
+        }
+        offsets[bucket_count] = total;
+
+        entries.resize(count);
+        each(chunks, pool, [&](size_t c) {
+          uint32_t* cursor = &histogram[c * bucket_count];
+          for (size_t i = count * c / chunks, end = count * (c + 1) / chunks; i < end; i++) {
+            Entry& e = entries[cursor[keys[i] >> shift]++];
+            e.key = keys[i];
+            e.vertex = static_cast<uint32_t>(i);
+            e.position[0] = vertices[i].position.x;
+            e.position[1] = vertices[i].position.y;
+            e.position[2] = vertices[i].position.z;
+          }
+        });
+
+        // chunks scatter in vertex order, so within a bucket only the keys are out of order
+        each(chunks, pool, [&](size_t c) {
+          for (size_t b = bucket_count * c / chunks, end = bucket_count * (c + 1) / chunks; b < end; b++) {
+            std::sort(entries.begin() + offsets[b], entries.begin() + offsets[b + 1]);
+          }
+        });
+      }
+
+      // calls fn for the entries of the cell in vertex order until it returns false
+      template <typename F>
+      void visit(int32_t x, int32_t y, int32_t z, const F& fn) const {
+        Entry probe;
+        probe.key = cellKey(x, y, z);
+        probe.vertex = 0;
+        size_t bucket = static_cast<size_t>(probe.key >> shift);
+        const Entry* end = entries.data() + offsets[bucket + 1];
+        for (const Entry* it = std::lower_bound(entries.data() + offsets[bucket], end, probe); it != end && it->key == probe.key; ++it) {
+          if (!fn(*it)) return;
+        }
+      }
+
+      // entry ranges of whole buckets, a cell never spans two
+      size_t bucket_count() const { return offsets.size() - 1; }
+      const Entry* bucket_begin(size_t b) const { return entries.data() + offsets[b]; }
+      const Entry* bucket_end(size_t b) const { return entries.data() + offsets[b + 1]; }
+      float inverse_cell() const { return inv_cell; }
+
+      static size_t chunkCount(size_t count, ThreadPool* pool) {
+        return pool && count >= 2 * min_chunk ? std::min<size_t>(pool->size() + 1, count / min_chunk) : 1;
+      }
+
+      static void each(size_t n, ThreadPool* pool, const std::function<void(size_t)>& fn) {
+        if (pool && n > 1) {
+          pool->parallel_for(n, fn);
+        } else {
+          for (size_t i = 0; i < n; i++) fn(i);
+        }
+      }
+
+    private:
+      std::vector<Entry> entries;
+      std::vector<uint32_t> offsets;
+      unsigned int shift;
+      float inv_cell;
+    };
+  }
+
+  // Merges vertices whose positions lie within epsilon of each other and whose texcoord and normal are equal
+  // (up to float_comapre), so uv and normal seams stay split. Every vertex maps to the lowest index kept vertex
+  // it matches, the result does not depend on the pool. Indices are remapped, vertices compacted in their
+  // original order and the bounds recomputed. Triangles smaller than epsilon collapse and stay as degenerates.
+  // The tangent of the kept vertex is used. Returns the number of vertices removed.
+  // NOTE: meshes loaded into a packed VertexBuffer and an epsilon <= 0 are left untouched.
+  inline size_t weldVertices(Mesh& mesh, float epsilon, ThreadPool* pool = nullptr) {
+    using weld_detail::Entry;
+    OBJ_LOADER_TRACE_SCOPE("weld");
+    const size_t count = mesh.vertices.size();
+    if (count < 2 || !(epsilon > 0.f) || count > 0xffffffffu) {
+      return 0;
+    }
+
+    weld_detail::Grid grid;
+    grid.build(mesh.vertices, weld_detail::cell_scale * epsilon, pool);
+    const float inv_cell = grid.inverse_cell();
+    const float eps2 = epsilon * epsilon;
+    std::vector<uint32_t> remap(count);
+
+    // a cell whose vertices are all away from its border can only match among themselves. those are welded
+    // in grid order, bucket ranges on the pool; vertices of the other cells are left for a second pass.
+    const size_t chunks = weld_detail::Grid::chunkCount(count, pool);
+    std::vector<std::vector<uint32_t>> border_vertices(chunks);
+    weld_detail::Grid::each(chunks, pool, [&](size_t c) {
+      int32_t base[3], step[3];
+      for (size_t b = grid.bucket_count() * c / chunks, b_end = grid.bucket_count() * (c + 1) / chunks; b < b_end; b++) {
+        const Entry* end = grid.bucket_end(b);
+        for (const Entry* first = grid.bucket_begin(b); first != end;) {
+          const Entry* last = first;
+          bool inside = true;
+          for (; last != end && last->key == first->key; ++last) {
+            inside = weld_detail::cellRange(last->position, inv_cell, base, step) && inside;
+          }
+          if (!inside) {
+            for (const Entry* e = first; e != last; ++e) border_vertices[c].push_back(e->vertex);
+            first = last;
+            continue;
+          }
+          for (const Entry* e = first; e != last; ++e) {
+            uint32_t best = e->vertex;
+            for (const Entry* k = first; k != e; ++k) {
+              if (remap[k->vertex] == k->vertex && weld_detail::within(k->position, e->position, eps2) &&
+                  weld_detail::sameAttributes(mesh.vertices[k->vertex], mesh.vertices[e->vertex])) {
+                best = k->vertex;
+                break;
+              }
+            }
+            remap[e->vertex] = best;
+          }
+          first = last;
+        }
+      }
+    });
+
+    // the rest in vertex order, searching the neighbouring cells as well
+    std::vector<uint32_t> pending;
+    for (const std::vector<uint32_t>& list : border_vertices) pending.insert(pending.end(), list.begin(), list.end());
+    std::sort(pending.begin(), pending.end());
+    for (uint32_t i : pending) {
+      const Vertex& v = mesh.vertices[i];
+      const float p[3] = {v.position.x, v.position.y, v.position.z};
+      int32_t base[3], step[3];
+      weld_detail::cellRange(p, inv_cell, base, step);
+      uint32_t best = i;
+      for (int n = 0; n < 8; n++) {
+        if (((n & 1) && !step[0]) || ((n & 2) && !step[1]) || ((n & 4) && !step[2])) continue;
+        grid.visit(base[0] + ((n & 1) ? step[0] : 0), base[1] + ((n & 2) ? step[1] : 0), base[2] + ((n & 4) ? step[2] : 0), [&](const Entry& e) {
+          if (e.vertex >= best) return false; // only earlier kept vertices are candidates
+          if (remap[e.vertex] == e.vertex && weld_detail::within(e.position, p, eps2) && weld_detail::sameAttributes(v, mesh.vertices[e.vertex])) {
+            best = e.vertex;
+            return false;
+          }
+          return true;
+        });
+      }
+      remap[i] = best;
+    }
+
+    // compact the kept vertices and point every removed one at its kept copy
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+      if (remap[i] == i) {
+        if (kept != i) mesh.vertices[kept] = mesh.vertices[i];
+        remap[i] = static_cast<uint32_t>(kept++);
+      } else {
+        remap[i] = remap[remap[i]];
+      }
+    }
+    mesh.vertices.resize(kept);
+    mesh.vertices.shrink_to_fit();
+    for (unsigned int& index : mesh.indices) {
+      index = remap[index];
+    }
+
+    mesh.bounds = Bounds();
+    for (const Vertex& v : mesh.vertices) {
+      mesh.bounds.expand(v.position);
+    }
+    return count - kept;
+  }
+
+  // welds every mesh of the scene, meshes on the pool and large ones building their grid on it too
+  inline size_t weldVertices(Scene& scene, float epsilon, ThreadPool* pool = nullptr) {
+    std::vector<size_t> removed(scene.meshes.size(), 0);
+    weld_detail::Grid::each(scene.meshes.size(), pool, [&](size_t i) { removed[i] = weldVertices(scene.meshes[i], epsilon, pool); });
+    size_t total = 0;
+    for (size_t n : removed) total += n;
+    return total;
+  }
+}
+
+#endif //MODEL_LOAD_MESH_WELD_H
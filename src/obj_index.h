@@ -0,0 +1,311 @@
+#ifndef MODEL_LOAD_OBJ_INDEX_H
+#define MODEL_LOAD_OBJ_INDEX_H
+
+#include <algorithm>
+#include "obj_loader.h"
+#include "mapped_file.h"
+
+namespace obj_loader {
+  // one `o`/`g`/`usemtl` section of an obj file
+  struct ObjSection {
+    ObjSection() : name(), material_name(), material_id(-1), begin(0), end(0), vertex_base(0), texcoord_base(0), normal_base(0), face_count(0) {}
+    std::string name;
+    std::string material_name;
+    int material_id;
+    size_t begin; // byte range of the section lines
+    size_t end;
+    size_t vertex_base; // `v`/`vt`/`vn` records before the section, to resolve relative indices
+    size_t texcoord_base;
+    size_t normal_base;
+    size_t face_count;
+  };
+
+  // Byte ranges of the sections of a mapped obj, from one pass that only looks at line keywords.
+  // loadMesh parses a single section and just the attribute records its faces reference.
+  // The index is immutable after open, so meshes may be loaded from any thread.
+  class ObjIndex {
+  public:
+    ObjIndex() : file(), base_dir(), filename(), section_list(), material_list(), material_map(), runs() {}
+
+    bool open(const std::string& path) {
+      if (!endsWith(path, ".obj") || !file.open(path)) {
+        return false;
+      }
+      std::pair<std::string, std::string> pair = splitDelims(path, "\\/");
+      base_dir = pair.first;
+      filename = pair.second;
+      section_list.clear();
+      material_list.clear();
+      material_map.clear();
+      for (auto& r : runs) r.clear();
+
+      const size_t size = file.size();
+      size_t counts[3] = {0, 0, 0};
+      int last_kind = -1;
+      std::string object_name, material_name;
+      ObjSection current;
+      auto close_section = [&](size_t at) {
+        current.end = at;
+        if (current.face_count > 0) {
+          section_list.emplace_back(current);
+        }
+        current = ObjSection();
+        current.name = object_name.empty() ? material_name : object_name;
+        current.material_name = material_name;
+        current.begin = at;
+        current.vertex_base = counts[VERTEX];
+        current.texcoord_base = counts[TEXCOORD];
+        current.normal_base = counts[NORMAL];
+      };
+
+      std::string line_buf, tail_buf;
+      for (size_t pos = 0; pos < size;) {
+        size_t next;
+        const char* line = lineAt(pos, size, next, tail_buf);
+        const char* token = line + strspn(line, " \t");
+        int kind = -1;
+        if (token[0] == 'v') {
+          if (is_space(token[1])) kind = VERTEX;
+          else if (token[1] == 't' && is_space(token[2])) kind = TEXCOORD;
+          else if (token[1] == 'n' && is_space(token[2])) kind = NORMAL;
+        }
+
+        if (kind >= 0) {
+          // a new run starts wherever another record interrupts this kind, and every 64 records
+          // so a lookup never skips more than that many lines
+          if (last_kind != kind || counts[kind] % 64 == 0) {
+            runs[kind].emplace_back(pos, counts[kind]);
+          }
+          counts[kind]++;
+          last_kind = kind;
+        } else if (token[0] == 'f' && is_space(token[1])) {
+          current.face_count++;
+          last_kind = -1;
+        } else if (token[0] != '#' && !is_new_line(token[0])) {
+          last_kind = -1;
+          bool is_group = (token[0] == 'g' || token[0] == 'o') && is_space(token[1]);
+          bool is_usemtl = 0 == strncmp(token, "usemtl", 6) && is_space(token[6]);
+          bool is_mtllib = 0 == strncmp(token, "mtllib", 6) && is_space(token[6]);
+          if (is_group || is_usemtl || is_mtllib) {
+            line_buf.assign(token, token + strcspn(token, "\n"));
+            const char* t = line_buf.c_str();
+            if (is_group) {
+              t += 2;
+              std::string name;
+              while (!is_new_line(t[0])) {
+                name += (name.empty() ? "" : " ") + parseString(&t);
+                t += strspn(t, " \t\r");
+              }
+              object_name = name;
+              close_section(pos);
+            } else if (is_usemtl) {
+              t += 7;
+              std::string name = parseString(&t);
+              if (name != material_name) {
+                material_name = name;
+                close_section(pos);
+              }
+            } else {
+              t += 7;
+              std::vector<std::string> names;
+              split(names, " ", &t);
+              for (const std::string& name : names) {
+                if (parseMtl(base_dir + name, material_list, material_map)) break;
+              }
+            }
+          }
+        }
+        pos = next;
+      }
+      close_section(size);
+
+      for (ObjSection& s : section_list) {
+        auto it = material_map.find(s.material_name);
+        s.material_id = it == material_map.end() ? -1 : it->second;
+      }
+      return true;
+    }
+
+    const std::vector<ObjSection>& sections() const { return section_list; }
+    const std::vector<Material>& materials() const { return material_list; }
+
+    // first section with the given name, -1 when there is none
+    int findSection(const std::string& name) const {
+      for (size_t i = 0; i < section_list.size(); i++) {
+        if (section_list[i].name == name) return static_cast<int>(i);
+      }
+      return -1;
+    }
+
+    bool loadMesh(size_t index, Mesh& mesh, ParseOption parse_option) const {
+      if (index >= section_list.size()) {
+        return false;
+      }
+      const ObjSection& section = section_list[index];
+
+      // faces first: resolve indices with the counts at each face line, remember the referenced range
+      PrimitiveGroup prim(nullptr);
+      prim.faces.reserve(section.face_count);
+      int counts[3] = {static_cast<int>(section.vertex_base), static_cast<int>(section.texcoord_base), static_cast<int>(section.normal_base)};
+      int lo[3] = {INT_MAX, INT_MAX, INT_MAX};
+      int hi[3] = {-1, -1, -1};
+      std::vector<int> referenced[3];
+      std::string line_buf, tail_buf;
+      for (size_t pos = section.begin; pos < section.end;) {
+        const char* token = lineAt(pos, section.end, pos, tail_buf);
+        token += strspn(token, " \t");
+        if (token[0] == 'v') {
+          if (is_space(token[1])) counts[VERTEX]++;
+          else if (token[1] == 't' && is_space(token[2])) counts[TEXCOORD]++;
+          else if (token[1] == 'n' && is_space(token[2])) counts[NORMAL]++;
+          continue;
+        }
+        if (token[0] != 'f' || !is_space(token[1])) {
+          continue;
+        }
+
+        line_buf.assign(token + 2, token + 2 + strcspn(token + 2, "\n"));
+        const char* t = line_buf.c_str();
+        t += strspn(t, " \t");
+        Face f(nullptr);
+        f.vertex_indices.reserve(3);
+        while (!is_new_line(t[0])) {
+          VertexIndex vi;
+          if (!parseIndices(&t, counts[VERTEX], counts[NORMAL], counts[TEXCOORD], &vi)) {
+            return false;
+          }
+          int idx[3] = {vi.v_idx, vi.vt_idx, vi.vn_idx};
+          for (int k = 0; k < 3; k++) {
+            if (idx[k] < 0) continue;
+            lo[k] = std::min(lo[k], idx[k]);
+            hi[k] = std::max(hi[k], idx[k]);
+            referenced[k].push_back(idx[k]);
+          }
+          f.vertex_indices.emplace_back(vi);
+          t += strspn(t, " \t\r");
+        }
+        prim.faces.emplace_back(std::move(f));
+      }
+
+      // only the referenced records of each attribute are parsed, into a window rebased at lo
+      std::vector<char> used[3];
+      for (int k = 0; k < 3; k++) {
+        if (hi[k] < 0) continue;
+        used[k].assign(static_cast<size_t>(hi[k] - lo[k] + 1), 0);
+        for (int idx : referenced[k]) used[k][idx - lo[k]] = 1;
+      }
+      ScratchVector<vec3> vertices{ArenaAllocator<vec3>(nullptr)};
+      ScratchVector<vec2> texcoords{ArenaAllocator<vec2>(nullptr)};
+      ScratchVector<vec3> normals{ArenaAllocator<vec3>(nullptr)};
+      if (!readRange(VERTEX, lo[VERTEX], hi[VERTEX], used[VERTEX], vertices, parse_option) ||
+          !readRange(TEXCOORD, lo[TEXCOORD], hi[TEXCOORD], used[TEXCOORD], texcoords, parse_option) ||
+          !readRange(NORMAL, lo[NORMAL], hi[NORMAL], used[NORMAL], normals, parse_option)) {
+        return false;
+      }
+      for (Face& f : prim.faces) {
+        for (VertexIndex& vi : f.vertex_indices) {
+          vi.v_idx -= lo[VERTEX];
+          if (vi.vt_idx >= 0) vi.vt_idx -= lo[TEXCOORD];
+          if (vi.vn_idx >= 0) vi.vn_idx -= lo[NORMAL];
+        }
+      }
+
+      mesh = Mesh();
+      return parsePrimitive(mesh, prim, parse_option, section.material_id, vertices, texcoords, normals, section.name, filename);
+    }
+
+  private:
+    enum { VERTEX = 0, TEXCOORD = 1, NORMAL = 2 };
+
+    // the line starting at pos, readable up to its '\n'. the mapping is not null terminated,
+    // so only a last line without newline is copied out.
+    const char* lineAt(size_t pos, size_t limit, size_t& next, std::string& tail_buf) const {
+      const char* line = file.data() + pos;
+      const char* nl = static_cast<const char*>(memchr(line, '\n', limit - pos));
+      if (nl) {
+        next = static_cast<size_t>(nl - file.data()) + 1;
+        return line;
+      }
+      next = limit;
+      tail_buf.assign(line, limit - pos);
+      return tail_buf.c_str();
+    }
+
+    // parses the records of [lo, hi] flagged in used. sparse references jump between run starts
+    // instead of walking every line of the window.
+    template <typename T>
+    bool readRange(int kind, int lo, int hi, const std::vector<char>& used, ScratchVector<T>& out, ParseOption parse_option) const {
+      if (hi < 0) {
+        return true;
+      }
+      const std::vector<std::pair<size_t, size_t>>& list = runs[kind];
+      out.resize(static_cast<size_t>(hi - lo + 1));
+      std::string line_buf, tail_buf;
+      size_t i = 0;
+      while (i < used.size()) {
+        if (!used[i]) {
+          i++;
+          continue;
+        }
+        // last run starting at or before the next wanted record
+        size_t target = static_cast<size_t>(lo) + i;
+        auto run = std::upper_bound(list.begin(), list.end(), target,
+                                    [](size_t t, const std::pair<size_t, size_t>& r) { return t < r.second; });
+        if (run == list.begin()) {
+          return false;
+        }
+        --run;
+
+        size_t counter = run->second;
+        size_t pos = run->first;
+        while (i < used.size()) {
+          if (pos >= file.size()) {
+            return false;
+          }
+          const char* token = lineAt(pos, file.size(), pos, tail_buf);
+          token += strspn(token, " \t");
+          bool match = kind == VERTEX ? token[0] == 'v' && is_space(token[1])
+                                      : token[0] == 'v' && token[1] == (kind == TEXCOORD ? 't' : 'n') && is_space(token[2]);
+          if (!match) {
+            continue;
+          }
+          if (counter++ != static_cast<size_t>(lo) + i) {
+            continue;
+          }
+          if (used[i]) {
+            const char* record = token + (kind == VERTEX ? 2 : 3);
+            line_buf.assign(record, record + strcspn(record, "\n"));
+            const char* t = line_buf.c_str();
+            parseRecord(out[i], &t, parse_option);
+          }
+          i++;
+          // past a long gap of unused records, seek again rather than scan through it
+          size_t next = i;
+          while (next < used.size() && !used[next] && next - i <= 64) next++;
+          if (next - i > 64) {
+            break;
+          }
+        }
+      }
+      return true;
+    }
+
+    static void parseRecord(vec3& v, const char** token, ParseOption) { parseReal3(v, token); }
+    static void parseRecord(vec2& v, const char** token, ParseOption parse_option) {
+      parseReal2(v, token);
+      if (parse_option & ParseOption::FLIP_UV) {
+        v.y = 1.f - v.y;
+      }
+    }
+
+    MappedFile file;
+    std::string base_dir;
+    std::string filename;
+    std::vector<ObjSection> section_list;
+    std::vector<Material> material_list;
+    std::unordered_map<std::string, int> material_map;
+    std::vector<std::pair<size_t, size_t>> runs[3]; // per attribute kind: byte offset and index of a run's first record
+  };
+}
+
+#endif //MODEL_LOAD_OBJ_INDEX_H
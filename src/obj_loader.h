@@ -6,12 +6,31 @@
 #include <fstream>
 #include <cstring>
 #include <cassert>
+#include <cfloat>
 #include <vector>
 #include <sstream>
 #include <algorithm>
 #include <unordered_map>
 #include <type_traits>
+#include <memory>
+#include <mutex>
+#include <climits>
+#include <cstdint>
+#include <limits>
+#include <cstdlib>
+#include <sys/stat.h>
 #include "common.h"
+#include "arena.h"
+#include "compressed_stream.h"
+#include "trace.h"
+#include "vertex_layout.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OBJ_LOADER_SSE
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace obj_loader {
   constexpr bool is_space(char x) {
@@ -42,32 +61,168 @@ namespace obj_loader {
     vec3 tangent;
   };
 
-  struct VertexIndex {
-    VertexIndex() : v_idx(-1), vt_idx(-1), vn_idx(-1) {}
-    explicit VertexIndex(int idx) : v_idx(idx), vt_idx(idx), vn_idx(idx) {}
-    VertexIndex(int vidx, int vtidx, int vnidx) : v_idx(vidx), vt_idx(vtidx), vn_idx(vnidx) {}
-    int v_idx, vt_idx, vn_idx;
+  // Index is int for a default load and int64_t with ParseOption::LARGE_INDICES
+  template <typename Index>
+  struct BasicVertexIndex {
+    BasicVertexIndex() : v_idx(-1), vt_idx(-1), vn_idx(-1) {}
+    explicit BasicVertexIndex(Index idx) : v_idx(idx), vt_idx(idx), vn_idx(idx) {}
+    BasicVertexIndex(Index vidx, Index vtidx, Index vnidx) : v_idx(vidx), vt_idx(vtidx), vn_idx(vnidx) {}
+    Index v_idx, vt_idx, vn_idx;
   };
+  typedef BasicVertexIndex<int> VertexIndex;
 
-  struct Face {
-    Face() : vertex_indices() { vertex_indices.clear(); }
-    std::vector<VertexIndex> vertex_indices;
+  // parse temporaries, backed by an Arena when one is given to loadObj
+  template <typename T>
+  using ScratchVector = std::vector<T, ArenaAllocator<T>>;
+
+  template <typename Index>
+  struct BasicFace {
+    BasicFace() : vertex_indices() { vertex_indices.clear(); }
+    explicit BasicFace(Arena* arena) : vertex_indices(ArenaAllocator<BasicVertexIndex<Index>>(arena)) {}
+    ScratchVector<BasicVertexIndex<Index>> vertex_indices;
   };
+  typedef BasicFace<int> Face;
 
-  struct PrimitiveGroup {
-    PrimitiveGroup() : faces() { faces.clear(); }
+  template <typename Index>
+  struct BasicPrimitiveGroup {
+    BasicPrimitiveGroup() : faces() { faces.clear(); }
+    explicit BasicPrimitiveGroup(Arena* arena) : faces(ArenaAllocator<BasicFace<Index>>(arena)) {}
     bool is_empty() const { return faces.empty(); }
-    std::vector<Face> faces;
+    ScratchVector<BasicFace<Index>> faces;
+  };
+  typedef BasicPrimitiveGroup<int> PrimitiveGroup;
+
+  // axis aligned box and bounding sphere, grown one point at a time while parsing.
+  struct Bounds {
+    Bounds() : aabb_min(FLT_MAX), aabb_max(-FLT_MAX), center(), radius(-1.f) {}
+    bool is_empty() const { return radius < 0.f; }
+
+    void expand(const vec3& p) {
+      aabb_min.x = std::min(aabb_min.x, p.x); aabb_min.y = std::min(aabb_min.y, p.y); aabb_min.z = std::min(aabb_min.z, p.z);
+      aabb_max.x = std::max(aabb_max.x, p.x); aabb_max.y = std::max(aabb_max.y, p.y); aabb_max.z = std::max(aabb_max.z, p.z);
+      if (radius < 0.f) {
+        center = p;
+        radius = 0.f;
+        return;
+      }
+      // ritter style growth: only points outside the sphere pay for a sqrt
+      float dx = p.x - center.x, dy = p.y - center.y, dz = p.z - center.z;
+      float dist2 = dx * dx + dy * dy + dz * dz;
+      if (dist2 > radius * radius) {
+        float dist = std::sqrt(dist2);
+        float new_radius = (radius + dist) * 0.5f;
+        float k = (new_radius - radius) / dist;
+        center = vec3(center.x + dx * k, center.y + dy * k, center.z + dz * k);
+        radius = new_radius;
+      }
+    }
+
+    void merge(const Bounds& other) {
+      if (other.is_empty()) return;
+      if (is_empty()) {
+        *this = other;
+        return;
+      }
+      aabb_min.x = std::min(aabb_min.x, other.aabb_min.x); aabb_min.y = std::min(aabb_min.y, other.aabb_min.y); aabb_min.z = std::min(aabb_min.z, other.aabb_min.z);
+      aabb_max.x = std::max(aabb_max.x, other.aabb_max.x); aabb_max.y = std::max(aabb_max.y, other.aabb_max.y); aabb_max.z = std::max(aabb_max.z, other.aabb_max.z);
+      float dx = other.center.x - center.x, dy = other.center.y - center.y, dz = other.center.z - center.z;
+      float dist = std::sqrt(dx * dx + dy * dy + dz * dz);
+      if (dist + other.radius <= radius) return; // other is inside
+      if (dist + radius <= other.radius) {
+        center = other.center;
+        radius = other.radius;
+        return;
+      }
+      float new_radius = (dist + radius + other.radius) * 0.5f;
+      float k = (new_radius - radius) / dist;
+      center = vec3(center.x + dx * k, center.y + dy * k, center.z + dz * k);
+      radius = new_radius;
+    }
+
+    vec3 aabb_min;
+    vec3 aabb_max;
+    vec3 center;
+    float radius; // negative when nothing has been added yet
+  };
+
+  // a source group inside a mesh merged by material (ParseOption::MERGE_MATERIALS)
+  struct MeshRange {
+    MeshRange() : name(), first_index(0), index_count(0), first_vertex(0), vertex_count(0) {}
+    std::string name; // the name the group would have had as its own mesh
+    size_t first_index, index_count;
+    size_t first_vertex, vertex_count;
   };
 
   struct Mesh {
-    Mesh() : name(), vertices(), material_id(-1) { vertices.clear(); }
+    Mesh() : name(), vertices(), indices(), indices64(), material_id(-1), bounds(), first_vertex(0), vertex_count(0), ranges() { vertices.clear(); }
+    bool empty() const { return vertices.empty() && vertex_count == 0; }
+    size_t index_count() const { return indices64.empty() ? indices.size() : indices64.size(); }
     std::string name;
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
+    // LARGE_INDICES only: a mesh with more than 2^32 - 1 vertices keeps its indices here and indices stays empty.
+    // weld, lods, bvh and MeshCache only read indices.
+    std::vector<uint64_t> indices64;
     int material_id;
+    Bounds bounds; // filled while the primitive is assembled
+    // range in the VertexBuffer given to loadObj; vertices stays empty then and indices are relative to first_vertex
+    size_t first_vertex;
+    size_t vertex_count;
+    std::vector<MeshRange> ranges; // only filled with MERGE_MATERIALS
+  };
+
+  enum class IndexType {
+    UINT16,
+    UINT32,
+    UINT64
   };
 
+  // smallest index type that can address vertex_count vertices
+  inline IndexType indexTypeFor(size_t vertex_count) {
+    if (vertex_count <= 0x10000u) return IndexType::UINT16;
+    if (vertex_count <= 0x100000000ull) return IndexType::UINT32;
+    return IndexType::UINT64;
+  }
+
+  // the indices of a mesh narrowed for upload, e.g. a GL_UNSIGNED_SHORT element buffer
+  struct IndexBuffer {
+    IndexBuffer() : type(IndexType::UINT32), count(0), data() {}
+    size_t stride() const { return type == IndexType::UINT16 ? 2 : type == IndexType::UINT32 ? 4 : 8; }
+    IndexType type;
+    size_t count;
+    std::vector<unsigned char> data;
+  };
+
+  namespace index_detail {
+    template <typename Dst, typename Src>
+    inline void narrow(const std::vector<Src>& src, IndexBuffer& out) {
+      out.data.resize(src.size() * sizeof(Dst));
+      Dst* dst = reinterpret_cast<Dst*>(out.data.data());
+      for (size_t i = 0; i < src.size(); i++) dst[i] = static_cast<Dst>(src[i]);
+    }
+  }
+
+  // writes the indices of mesh with the narrowest type its vertex count allows
+  inline void buildIndexBuffer(const Mesh& mesh, IndexBuffer& out) {
+    out.type = indexTypeFor(std::max(mesh.vertices.size(), mesh.vertex_count));
+    out.count = mesh.index_count();
+    const bool wide = !mesh.indices64.empty();
+    switch (out.type) {
+      case IndexType::UINT16:
+        if (wide) index_detail::narrow<uint16_t>(mesh.indices64, out);
+        else index_detail::narrow<uint16_t>(mesh.indices, out);
+        break;
+      case IndexType::UINT32:
+        if (wide) index_detail::narrow<uint32_t>(mesh.indices64, out);
+        else index_detail::narrow<uint32_t>(mesh.indices, out);
+        break;
+      case IndexType::UINT64:
+        if (wide) index_detail::narrow<uint64_t>(mesh.indices64, out);
+        else index_detail::narrow<uint64_t>(mesh.indices, out);
+        break;
+    }
+  }
+
   enum class TextureFace {
     TEX_2D,
     TEX_3D_SPHERE,
@@ -125,9 +280,10 @@ namespace obj_loader {
   };
 
   struct Texture {
-    Texture() : name(), option() {}
+    Texture() : name(), option(), id(-1) {}
     std::string name;
     TextureOption option;
+    int id; // index into Scene::textures
   };
 
   struct Material {
@@ -153,32 +309,107 @@ namespace obj_loader {
     TRIANGULATE = 1 << 0,
     FLIP_UV = 1 << 1,
     CALC_TANGENT = 1 << 2,
+    PRESCAN = 1 << 3, // count records first and reserve every buffer once
+    MERGE_MATERIALS = 1 << 4, // one mesh per material, the source groups are kept as its ranges
+    LARGE_INDICES = 1 << 5, // 64 bit face indices and element counts, for inputs past 2^31 records or 2^32 corners per mesh
   };
 
-  inline bool operator&(const ParseOption a, const ParseOption b) {
+  constexpr bool operator&(const ParseOption a, const ParseOption b) {
     return static_cast<ParseOption>(static_cast<unsigned int>(a) & static_cast<unsigned int>(b)) == b;
   }
 
-  inline ParseOption operator|(const ParseOption a, const ParseOption b) {
+  constexpr ParseOption operator|(const ParseOption a, const ParseOption b) {
     return static_cast<ParseOption>(static_cast<unsigned int>(a) | static_cast<unsigned int>(b));
   }
 
+  // parse flags fixed at compile time, each test is a constant the loops are specialized on
+  template <ParseOption Option>
+  struct StaticParseOption {
+    constexpr bool operator()(ParseOption flag) const { return Option & flag; }
+  };
+
+  // the same flags tested at run time per element, what loadObjDynamic uses
+  struct DynamicParseOption {
+    explicit DynamicParseOption(ParseOption option) : option(option) {}
+    bool operator()(ParseOption flag) const { return option & flag; }
+    ParseOption option;
+  };
+
   struct Scene {
-    Scene() : meshes(), materials(), base_dir() {
+    Scene() : meshes(), materials(), base_dir(), bounds() {
       meshes.clear();
       materials.clear();
+      textures.clear();
+      material_libraries.clear();
     }
     std::vector<Mesh> meshes;
     std::vector<Material> materials;
+    std::vector<std::string> textures; // unique texture paths of all materials, resolved against base_dir
+    std::vector<std::string> material_libraries; // mtl files the materials were read from, in order
     std::string base_dir;
+    Bounds bounds; // covers every `v` record of the file
   };
 
-  inline void calcTangent(Mesh& mesh, unsigned int offset) {
-    unsigned int offset_start = offset * 3;
-    Vertex v1 = mesh.vertices.at(offset_start);
-    Vertex v2 = mesh.vertices.at(offset_start + 1);
-    Vertex v3 = mesh.vertices.at(offset_start + 2);
+  inline vec3 transformPoint(const float* m, const vec3& p) {
+    return vec3(m[0] * p.x + m[4] * p.y + m[8] * p.z + m[12],
+                m[1] * p.x + m[5] * p.y + m[9] * p.z + m[13],
+                m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14]);
+  }
 
+  // Recomputes the box of the mesh positions under an affine transform (column major 4x4, opengl layout).
+  // The sphere is carried over from mesh.bounds, scaled by the largest axis scale, so no second pass is needed.
+  // A packed mesh has no vertices of its own, its box is the transformed corners of mesh.bounds instead.
+  inline Bounds transformBounds(const Mesh& mesh, const float* m) {
+    Bounds result;
+    if (mesh.vertices.empty() && mesh.bounds.is_empty()) {
+      return result;
+    }
+
+    auto expand_box = [&result](const vec3& t) {
+      result.aabb_min.x = std::min(result.aabb_min.x, t.x); result.aabb_min.y = std::min(result.aabb_min.y, t.y); result.aabb_min.z = std::min(result.aabb_min.z, t.z);
+      result.aabb_max.x = std::max(result.aabb_max.x, t.x); result.aabb_max.y = std::max(result.aabb_max.y, t.y); result.aabb_max.z = std::max(result.aabb_max.z, t.z);
+    };
+    if (mesh.vertices.empty()) {
+      const vec3& lo = mesh.bounds.aabb_min;
+      const vec3& hi = mesh.bounds.aabb_max;
+      for (int i = 0; i < 8; i++) {
+        expand_box(transformPoint(m, vec3(i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z)));
+      }
+    } else {
+#ifdef OBJ_LOADER_SSE
+      __m128 c0 = _mm_setr_ps(m[0], m[1], m[2], 0.f);
+      __m128 c1 = _mm_setr_ps(m[4], m[5], m[6], 0.f);
+      __m128 c2 = _mm_setr_ps(m[8], m[9], m[10], 0.f);
+      __m128 c3 = _mm_setr_ps(m[12], m[13], m[14], 0.f);
+      __m128 lo = _mm_set1_ps(FLT_MAX);
+      __m128 hi = _mm_set1_ps(-FLT_MAX);
+      for (const Vertex& v : mesh.vertices) {
+        __m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(v.position.x)), _mm_mul_ps(c1, _mm_set1_ps(v.position.y))),
+                              _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(v.position.z)), c3));
+        lo = _mm_min_ps(lo, p);
+        hi = _mm_max_ps(hi, p);
+      }
+      float out_lo[4], out_hi[4];
+      _mm_storeu_ps(out_lo, lo);
+      _mm_storeu_ps(out_hi, hi);
+      result.aabb_min = vec3(out_lo[0], out_lo[1], out_lo[2]);
+      result.aabb_max = vec3(out_hi[0], out_hi[1], out_hi[2]);
+#else
+      for (const Vertex& v : mesh.vertices) {
+        expand_box(transformPoint(m, v.position));
+      }
+#endif
+    }
+
+    result.center = transformPoint(m, mesh.bounds.center);
+    float sx = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+    float sy = m[4] * m[4] + m[5] * m[5] + m[6] * m[6];
+    float sz = m[8] * m[8] + m[9] * m[9] + m[10] * m[10];
+    result.radius = mesh.bounds.radius * std::sqrt(std::max(sx, std::max(sy, sz)));
+    return result;
+  }
+
+  inline vec3 triangleTangent(Vertex v1, Vertex v2, Vertex v3) {
     vec3 e1 = v2.position - v1.position;
     vec3 e2 = v3.position - v1.position;
     vec2 delta1 = v2.texcoord - v1.texcoord;
@@ -190,8 +421,16 @@ namespace obj_loader {
     tangent.x = f * (delta2.y * e1.x - delta1.y * e2.x);
     tangent.y = f * (delta2.y * e1.y - delta1.y * e2.y);
     tangent.z = f * (delta2.y * e1.z - delta1.y * e2.z);
-    tangent = normalize(tangent);
+    return normalize(tangent);
+  }
 
+  // tangent of the triangle whose corners start at vertex offset_start
+  inline void calcTangent(Mesh& mesh, size_t offset_start) {
+    Vertex v1 = mesh.vertices.at(offset_start);
+    Vertex v2 = mesh.vertices.at(offset_start + 1);
+    Vertex v3 = mesh.vertices.at(offset_start + 2);
+
+    vec3 tangent = triangleTangent(v1, v2, v3);
     v1.tangent = tangent;
     v2.tangent = tangent;
     v3.tangent = tangent;
@@ -201,21 +440,153 @@ namespace obj_loader {
     mesh.vertices[offset_start + 2] = v3;
   }
 
-  inline void triangulate(Mesh& mesh, const std::vector<vec3>& verts, size_t npolys) {
-    // @TODO
+  // a planar polygon of npolys corners from offset_start, every corner takes the tangent of its first triangle
+  inline void calcTangent(Mesh& mesh, size_t offset_start, size_t npolys) {
+    vec3 tangent = triangleTangent(mesh.vertices[offset_start], mesh.vertices[offset_start + 1], mesh.vertices[offset_start + 2]);
+    for (size_t k = 0; k < npolys; k++) {
+      mesh.vertices[offset_start + k].tangent = tangent;
+    }
   }
 
-  inline bool parsePrimitive(Mesh& mesh, const PrimitiveGroup& primitive, ParseOption option, const int material_id,
-                             const std::vector<vec3>& verts, const std::vector<vec2>& texcoords, const std::vector<vec3>& normals,
-                             const std::string& name, const std::string& default_name) {
+  // room for extra more elements. grows at least geometrically, so appending many groups to one merged mesh stays linear
+  template <typename T>
+  inline void reserveMore(std::vector<T>& v, size_t extra) {
+    if (v.capacity() - v.size() < extra) {
+      v.reserve(std::max(v.size() + extra, v.capacity() * 2));
+    }
+  }
+
+  // appends corner indices to a mesh. a default load always writes 32 bit indices.
+  template <typename Index>
+  struct IndexSink {
+    static void reserve(Mesh& mesh, size_t extra) { reserveMore(mesh.indices, extra); }
+    static void push(Mesh& mesh, size_t index) { mesh.indices.emplace_back(static_cast<unsigned int>(index)); }
+  };
+
+  // LARGE_INDICES: 32 bit until the mesh outgrows them, then every index moves to indices64
+  template <>
+  struct IndexSink<int64_t> {
+    static void reserve(Mesh& mesh, size_t extra) {
+      if (mesh.indices64.empty()) reserveMore(mesh.indices, extra);
+      else reserveMore(mesh.indices64, extra);
+    }
+
+    static void push(Mesh& mesh, size_t index) {
+      if (mesh.indices64.empty()) {
+        if (index <= 0xffffffffu) {
+          mesh.indices.emplace_back(static_cast<unsigned int>(index));
+          return;
+        }
+        mesh.indices64.reserve(std::max<size_t>(mesh.indices.capacity(), mesh.indices.size() + 1));
+        mesh.indices64.assign(mesh.indices.begin(), mesh.indices.end());
+        mesh.indices = std::vector<unsigned int>();
+      }
+      mesh.indices64.emplace_back(index);
+    }
+  };
+
+  // fan triangulation of the convex polygon whose npolys corners are the vertices from first on,
+  // so the corners are stored once and only the indices repeat
+  template <typename Index>
+  inline void triangulate(Mesh& mesh, size_t first, size_t npolys) {
+    for (size_t k = 2; k < npolys; k++) {
+      IndexSink<Index>::push(mesh, first);
+      IndexSink<Index>::push(mesh, first + k - 1);
+      IndexSink<Index>::push(mesh, first + k);
+    }
+  }
+
+  // parsePrimitive into a VertexBuffer: same faces and corner order, written straight in the buffer layout
+  template <VertexFormat F, typename Index, typename Flags>
+  inline void emitPrimitive(Mesh& mesh, const BasicPrimitiveGroup<Index>& primitive, Flags flags, const int material_id,
+                            const ScratchVector<vec3>& verts, const ScratchVector<vec2>& texcoords, const ScratchVector<vec3>& normals,
+                            size_t corners, size_t index_count, VertexBuffer& packed) {
+    const VertexLayout& layout = packed.layout;
+    if (mesh.vertex_count == 0) {
+      mesh.first_vertex = packed.vertex_count();
+    }
+    size_t begin = packed.data.size();
+    packed.data.resize(begin + corners * layout.stride);
+    unsigned char* dst = packed.data.data() + begin;
+    IndexSink<Index>::reserve(mesh, index_count);
+    const bool tangents = flags(ParseOption::CALC_TANGENT);
+    const bool fan = flags(ParseOption::TRIANGULATE);
+
+    for (const BasicFace<Index>& face : primitive.faces) {
+      size_t npolys = face.vertex_indices.size();
+      if (npolys < 3) {
+        continue;
+      }
+      Vertex corner[3];
+      vec3 tangent;
+      // a triangulated polygon takes the tangent of its first triangle for every corner
+      if (tangents && (npolys == 3 || fan)) {
+        for (int k = 0; k < 3; k++) {
+          BasicVertexIndex<Index> idx = face.vertex_indices[k];
+          corner[k].position = verts[idx.v_idx];
+          corner[k].texcoord = (idx.vt_idx == -1 ? vec2() : texcoords[idx.vt_idx]);
+        }
+        tangent = triangleTangent(corner[0], corner[1], corner[2]);
+      }
+      for (size_t f = 0; f < npolys; f++) {
+        BasicVertexIndex<Index> idx = face.vertex_indices[f];
+        const vec3& position = verts[idx.v_idx];
+        mesh.bounds.expand(position);
+        VertexEmitter<F>::emit(layout, dst, position, idx.vn_idx == -1 ? vec3() : normals[idx.vn_idx],
+                               idx.vt_idx == -1 ? vec2() : texcoords[idx.vt_idx], tangent);
+        dst += layout.stride;
+      }
+      if (fan && npolys != 3) {
+        triangulate<Index>(mesh, mesh.vertex_count, npolys);
+      } else {
+        for (size_t f = 0; f < npolys; f++) {
+          IndexSink<Index>::push(mesh, mesh.vertex_count + f);
+        }
+      }
+      mesh.vertex_count += npolys;
+      mesh.material_id = material_id;
+    }
+  }
+
+  // with packed, vertices go to the buffer in its layout instead of mesh.vertices.
+  // with StaticParseOption flags every flag test below folds away, parsePrimitive picks the instantiation.
+  template <typename Index, typename Flags>
+  inline bool assemblePrimitive(Mesh& mesh, const BasicPrimitiveGroup<Index>& primitive, Flags flags, const int material_id,
+                                const ScratchVector<vec3>& verts, const ScratchVector<vec2>& texcoords, const ScratchVector<vec3>& normals,
+                                const std::string& name, const std::string& default_name, VertexBuffer* packed = nullptr) {
     if (primitive.is_empty()) {
       return false;
     }
+    OBJ_LOADER_TRACE_SCOPE("assemble");
     mesh.name = name.empty() ? default_name : name;
 
+    // size the output once instead of growing it per corner
+    size_t corners = 0, index_count = 0;
+    for (const BasicFace<Index>& face : primitive.faces) {
+      size_t npolys = face.vertex_indices.size();
+      if (npolys >= 3) {
+        corners += npolys;
+        index_count += flags(ParseOption::TRIANGULATE) ? (npolys - 2) * 3 : npolys;
+      }
+    }
+
+    if (packed) {
+      // one dispatch per primitive, the emit loop itself is specialized for the layout
+      switch (packed->layout.format) {
+        case VertexFormat::P3F_N3F_T2F: emitPrimitive<VertexFormat::P3F_N3F_T2F, Index, Flags>(mesh, primitive, flags, material_id, verts, texcoords, normals, corners, index_count, *packed); break;
+        case VertexFormat::P3F_T2F_N3F: emitPrimitive<VertexFormat::P3F_T2F_N3F, Index, Flags>(mesh, primitive, flags, material_id, verts, texcoords, normals, corners, index_count, *packed); break;
+        case VertexFormat::P3F_N4B_T2H: emitPrimitive<VertexFormat::P3F_N4B_T2H, Index, Flags>(mesh, primitive, flags, material_id, verts, texcoords, normals, corners, index_count, *packed); break;
+        case VertexFormat::P3F: emitPrimitive<VertexFormat::P3F, Index, Flags>(mesh, primitive, flags, material_id, verts, texcoords, normals, corners, index_count, *packed); break;
+        default: emitPrimitive<VertexFormat::CUSTOM, Index, Flags>(mesh, primitive, flags, material_id, verts, texcoords, normals, corners, index_count, *packed); break;
+      }
+      return true;
+    }
+
+    reserveMore(mesh.vertices, corners);
+    IndexSink<Index>::reserve(mesh, index_count);
+
     // make polygon
-    unsigned int count = 0;
-    for (const Face& face : primitive.faces) {
+    for (const BasicFace<Index>& face : primitive.faces) {
       size_t npolys = face.vertex_indices.size();
 
       if (npolys < 3) {
@@ -223,59 +594,115 @@ namespace obj_loader {
         continue;
       }
 
+      for (size_t f = 0; f < npolys; f++) {
+        Vertex vtx;
+        BasicVertexIndex<Index> idx = face.vertex_indices[f];
+        vtx.position = verts[idx.v_idx];
+        mesh.bounds.expand(vtx.position);
+        vtx.texcoord = (idx.vt_idx == -1 ? vec2() : texcoords[idx.vt_idx]);
+        vtx.normal = (idx.vn_idx == -1 ? vec3() : normals[idx.vn_idx]);
+        mesh.vertices.emplace_back(vtx);
+      }
+
+      size_t preCompute = mesh.vertices.size() - npolys;
       // triangulate only parsing flag is set and polygon has more than 3.
-      if ((option & ParseOption::TRIANGULATE) && npolys != 3) {
-        triangulate(mesh, verts, npolys);
-      } else {
-        for (size_t f = 0; f < npolys; f++) {
-          Vertex vtx;
-          VertexIndex idx = face.vertex_indices[f];
-          vtx.position = verts[idx.v_idx];
-          vtx.texcoord = (idx.vt_idx == -1 ? vec2() : texcoords[idx.vt_idx]);
-          vtx.normal = (idx.vn_idx == -1 ? vec3() : normals[idx.vn_idx]);
-          mesh.vertices.emplace_back(vtx);
+      if (flags(ParseOption::TRIANGULATE) && npolys != 3) {
+        if (flags(ParseOption::CALC_TANGENT)) {
+          calcTangent(mesh, preCompute, npolys);
         }
-
-        if ((option & ParseOption::CALC_TANGENT) && npolys == 3) {
-          calcTangent(mesh, count);
+        triangulate<Index>(mesh, preCompute, npolys);
+      } else {
+        if (flags(ParseOption::CALC_TANGENT) && npolys == 3) {
+          calcTangent(mesh, preCompute);
         }
-
-        auto preCompute = (unsigned int)((mesh.vertices.size()) - npolys);
         for (size_t ff = 0; ff < npolys; ff++) {
-          mesh.indices.emplace_back(preCompute + ff);
+          IndexSink<Index>::push(mesh, preCompute + ff);
         }
-        mesh.material_id = material_id;
-        count++;
       }
+      mesh.material_id = material_id;
+    }
+
+    return true;
+  }
+
+  // picks the instantiation for the per element flags once per call
+  inline bool parsePrimitive(Mesh& mesh, const PrimitiveGroup& primitive, ParseOption option, const int material_id,
+                             const ScratchVector<vec3>& verts, const ScratchVector<vec2>& texcoords, const ScratchVector<vec3>& normals,
+                             const std::string& name, const std::string& default_name, VertexBuffer* packed = nullptr) {
+    const ParseOption T = ParseOption::TRIANGULATE, F = ParseOption::FLIP_UV, C = ParseOption::CALC_TANGENT;
+    switch (static_cast<unsigned int>(option) & static_cast<unsigned int>(T | F | C)) {
+      case 1: return assemblePrimitive(mesh, primitive, StaticParseOption<T>(), material_id, verts, texcoords, normals, name, default_name, packed);
+      case 2: return assemblePrimitive(mesh, primitive, StaticParseOption<F>(), material_id, verts, texcoords, normals, name, default_name, packed);
+      case 3: return assemblePrimitive(mesh, primitive, StaticParseOption<T | F>(), material_id, verts, texcoords, normals, name, default_name, packed);
+      case 4: return assemblePrimitive(mesh, primitive, StaticParseOption<C>(), material_id, verts, texcoords, normals, name, default_name, packed);
+      case 5: return assemblePrimitive(mesh, primitive, StaticParseOption<T | C>(), material_id, verts, texcoords, normals, name, default_name, packed);
+      case 6: return assemblePrimitive(mesh, primitive, StaticParseOption<F | C>(), material_id, verts, texcoords, normals, name, default_name, packed);
+      case 7: return assemblePrimitive(mesh, primitive, StaticParseOption<T | F | C>(), material_id, verts, texcoords, normals, name, default_name, packed);
+      default: return assemblePrimitive(mesh, primitive, StaticParseOption<ParseOption::NONE>(), material_id, verts, texcoords, normals, name, default_name, packed);
     }
+  }
 
+  // the integer at token as an Index: optional blanks and sign, then digits. false without digits or when it does not fit.
+  template <typename Index>
+  inline bool parseIndexValue(const char* token, Index* value) {
+    token += strspn(token, " \t");
+    const bool negative = token[0] == '-';
+    if (token[0] == '-' || token[0] == '+') token++;
+    if (token[0] < '0' || token[0] > '9') {
+      return false;
+    }
+    const uint64_t limit = static_cast<uint64_t>(std::numeric_limits<Index>::max());
+    uint64_t v = 0;
+    for (; token[0] >= '0' && token[0] <= '9'; token++) {
+      v = v * 10 + static_cast<uint64_t>(token[0] - '0');
+      if (v > limit) {
+        return false;
+      }
+    }
+    *value = negative ? -static_cast<Index>(v) : static_cast<Index>(v);
     return true;
   }
 
-  inline bool fixIndex(int idx, int n, int* ret) {
+  // 1 based or negative (relative to the n records read so far) obj index to a 0 based one.
+  // false for 0, for indices past the records read so far (either direction) and for results Index cannot hold.
+  template <typename Index>
+  inline bool fixIndex(Index idx, size_t n, Index* ret) {
     if (!ret || idx == 0) {
       return false;
     }
 
     if (idx > 0) {
+      if (static_cast<uint64_t>(idx) > n) {
+        return false; // references an element not read yet
+      }
       (*ret) = idx - 1;
+      return true;
     }
 
-    if (idx < 0) {
-      (*ret) = n + idx;
+    int64_t fixed = static_cast<int64_t>(n) + static_cast<int64_t>(idx);
+    if (fixed < 0 || static_cast<uint64_t>(fixed) > static_cast<uint64_t>(std::numeric_limits<Index>::max())) {
+      return false;
     }
-
+    (*ret) = static_cast<Index>(fixed);
     return true;
   }
 
-  inline bool parseIndices(const char** token, int vsize, int vnsize, int vtsize, VertexIndex* ret) {
+  template <typename Index>
+  inline bool parseIndex(const char* token, size_t n, Index* ret) {
+    Index idx;
+    return parseIndexValue(token, &idx) && fixIndex(idx, n, ret);
+  }
+
+  // i, i/j, i//k or i/j/k. with int indices a value past INT_MAX fails the face instead of wrapping.
+  template <typename Index>
+  inline bool parseIndices(const char** token, size_t vsize, size_t vnsize, size_t vtsize, BasicVertexIndex<Index>* ret) {
     if (!ret) {
       return false;
     }
 
-    VertexIndex vi(-1);
+    BasicVertexIndex<Index> vi(-1);
     // i
-    if (!fixIndex(atoi((*token)), vsize, &(vi.v_idx))) {
+    if (!parseIndex(*token, vsize, &(vi.v_idx))) {
       return false;
     }
     (*token) += strcspn((*token), "/ \t\r"); // go to next slash
@@ -290,7 +717,7 @@ namespace obj_loader {
     //   +--- here
     if ((*token)[0] == '/') {
       (*token)++; // now then, token is pointing at 'k'
-      if (!fixIndex(atoi((*token)), vnsize, &(vi.vn_idx))) {
+      if (!parseIndex(*token, vnsize, &(vi.vn_idx))) {
         return false;
       }
       (*token) += strcspn((*token), "/ \t\r"); // go to next slash (although, it's not exist)
@@ -300,7 +727,7 @@ namespace obj_loader {
 
     // i/j/k or i/j
     //   +--- here
-    if (!fixIndex(atoi((*token)), vtsize, &(vi.vt_idx))) {
+    if (!parseIndex(*token, vtsize, &(vi.vt_idx))) {
       return false;
     }
     (*token) += strcspn((*token), "/ \t\r"); // go to next slash
@@ -313,7 +740,7 @@ namespace obj_loader {
     // process last case
     // i/j/k
     (*token)++; // now then, token is pointing at 'k'
-    if (!fixIndex(atoi((*token)), vnsize, &(vi.vn_idx))) {
+    if (!parseIndex(*token, vnsize, &(vi.vn_idx))) {
       return false;
     }
     (*token) += strcspn((*token), "/ \t\r"); // go to next slash (although, it's not exist)
@@ -376,38 +803,260 @@ namespace obj_loader {
     return i;
   }
 
-  inline std::istream& getLine(std::istream& is, std::string& t) {
-    t.clear();
-
-    // The characters in the stream are read one-by-one using a std::streambuf.
-    // That is faster than reading them one-by-one using the std::istream.
-    // Code that uses streambuf this way must be guarded by a sentry object.
-    // The sentry object performs various tasks,
-    // such as thread synchronization and updating the stream state.
-
-    std::istream::sentry se(is, true);
-    std::streambuf* sb = is.rdbuf();
-
-    for(;;) {
-      int c = sb->sbumpc();
-      switch (c) {
-        case '\n':
-          return is;
-        case '\r':
-          if(sb->sgetc() == '\n')
-            sb->sbumpc();
-          return is;
-        case std::streambuf::traits_type::eof():
-          // Also handle the case when the last line has no line ending
-          if(t.empty())
-            is.setstate(std::ios::eofbit);
-          return is;
-        default:
-          t += static_cast<char>(c);
+  // record counts gathered by prescanObj
+  struct ObjCounts {
+    ObjCounts() : vertices(0), texcoords(0), normals(0), faces(0) {}
+    size_t vertices, texcoords, normals, faces;
+  };
+
+  inline unsigned int countTrailingZeros(unsigned int x) {
+#if defined(_MSC_VER)
+    unsigned long r;
+    _BitScanForward(&r, x);
+    return r;
+#else
+    return __builtin_ctz(x);
+#endif
+  }
+
+  // classify the line starting at p. the buffer must stay readable two bytes past the line.
+  inline void countLine(const char* p, ObjCounts& counts) {
+    while (is_space(*p)) p++;
+    if (p[0] == 'v') {
+      if (is_space(p[1])) counts.vertices++;
+      else if (p[1] == 't' && is_space(p[2])) counts.texcoords++;
+      else if (p[1] == 'n' && is_space(p[2])) counts.normals++;
+    } else if (p[0] == 'f' && is_space(p[1])) {
+      counts.faces++;
+    }
+  }
+
+  // counts the lines of [data, data + size) that are v/vt/vn/f records. line starts are found 16 bytes at a time.
+  inline void countLines(const char* data, size_t size, bool at_line_start, ObjCounts& counts) {
+    if (at_line_start && size > 0) {
+      countLine(data, counts);
+    }
+
+    size_t i = 0;
+#ifdef OBJ_LOADER_SSE
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16) {
+      unsigned int mask = static_cast<unsigned int>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), newline)));
+      while (mask) {
+        size_t start = i + countTrailingZeros(mask) + 1;
+        if (start < size) {
+          countLine(data + start, counts);
+        }
+        mask &= mask - 1;
+      }
+    }
+#endif
+    for (; i < size; i++) {
+      if (data[i] == '\n' && i + 1 < size) {
+        countLine(data + i + 1, counts);
       }
     }
   }
 
+  // cheap first pass over the stream, OBJ has no header telling how much to reserve.
+  // the stream is rewound afterwards.
+  inline void prescanObj(std::istream& is, ObjCounts& counts) {
+    const size_t chunk = 1 << 16;
+    const size_t padding = 16;
+    std::vector<char> buf(chunk + padding);
+    size_t carry = 0;
+    bool at_line_start = true;
+
+    for (;;) {
+      is.read(buf.data() + carry, static_cast<std::streamsize>(chunk - carry));
+      size_t read = static_cast<size_t>(is.gcount());
+      size_t n = carry + read;
+      bool eof = !is;
+      if (n == 0) {
+        break;
+      }
+      memset(buf.data() + n, 0, padding);
+
+      // a partial last line is carried into the next chunk so that its head can be classified
+      size_t end = n;
+      if (!eof) {
+        size_t last = n;
+        while (last > 0 && buf[last - 1] != '\n') last--;
+        if (last > 0) {
+          end = last;
+        }
+      }
+      countLines(buf.data(), end, at_line_start, counts);
+      at_line_start = buf[end - 1] == '\n';
+
+      carry = n - end;
+      memmove(buf.data(), buf.data() + end, carry);
+      if (eof) {
+        break;
+      }
+    }
+
+    is.clear();
+    is.seekg(0);
+  }
+
+  // Lines of a stream, read in 64 KiB blocks and handed out in place: the line end ("\n", "\r\n" or "\r")
+  // is overwritten with a null, so no line is copied. a line stays valid until the next call.
+  class LineReader {
+  public:
+    explicit LineReader(std::istream& is) : is(is), buf(64 * 1024 + 1), begin(0), end(0), eof(false) {}
+
+    // nullptr once the stream is exhausted
+    char* next(size_t& length) {
+      for (;;) {
+        char* line = &buf[begin];
+        size_t avail = end - begin;
+        char* stop = static_cast<char*>(memchr(line, '\n', avail));
+        char* cr = static_cast<char*>(memchr(line, '\r', stop ? static_cast<size_t>(stop - line) : avail));
+        // a '\r' at the end of the block may still be followed by '\n'
+        if (cr && (cr + 1 < line + avail || eof)) {
+          stop = cr;
+        }
+        if (stop || (eof && avail > 0)) {
+          length = stop ? static_cast<size_t>(stop - line) : avail;
+          size_t consumed = stop ? length + 1 : avail;
+          if (stop && *stop == '\r' && consumed < avail && line[consumed] == '\n') {
+            consumed++;
+          }
+          line[length] = '\0';
+          begin += consumed;
+          return line;
+        }
+        if (eof) {
+          return nullptr;
+        }
+        fill();
+      }
+    }
+
+  private:
+    void fill() {
+      size_t rest = end - begin;
+      memmove(&buf[0], &buf[begin], rest);
+      begin = 0;
+      end = rest;
+      if (end + 1 >= buf.size()) {
+        buf.resize(buf.size() * 2); // a line longer than the block
+      }
+      is.read(&buf[end], static_cast<std::streamsize>(buf.size() - 1 - end));
+      end += static_cast<size_t>(is.gcount());
+      eof = !is;
+    }
+
+    std::istream& is;
+    std::vector<char> buf; // one spare byte, so a last line without line end can be terminated too
+    size_t begin;
+    size_t end;
+    bool eof;
+  };
+
+  enum class ObjKeyword {
+    UNKNOWN,
+    VERTEX,
+    NORMAL,
+    TEXCOORD,
+    FACE,
+    USEMTL,
+    MTLLIB,
+    GROUP,
+    OBJECT,
+  };
+
+  // the statement at token, by a jump on its first byte. a keyword only counts when a space or tab follows it.
+  inline ObjKeyword objKeyword(const char* token) {
+    switch (token[0]) {
+      case 'v':
+        if (is_space(token[1])) return ObjKeyword::VERTEX;
+        if (token[1] == 'n') return is_space(token[2]) ? ObjKeyword::NORMAL : ObjKeyword::UNKNOWN;
+        if (token[1] == 't') return is_space(token[2]) ? ObjKeyword::TEXCOORD : ObjKeyword::UNKNOWN;
+        return ObjKeyword::UNKNOWN;
+      case 'f': return is_space(token[1]) ? ObjKeyword::FACE : ObjKeyword::UNKNOWN;
+      case 'g': return is_space(token[1]) ? ObjKeyword::GROUP : ObjKeyword::UNKNOWN;
+      case 'o': return is_space(token[1]) ? ObjKeyword::OBJECT : ObjKeyword::UNKNOWN;
+      case 'u': return 0 == strncmp(token, "usemtl", 6) && is_space(token[6]) ? ObjKeyword::USEMTL : ObjKeyword::UNKNOWN;
+      case 'm': return 0 == strncmp(token, "mtllib", 6) && is_space(token[6]) ? ObjKeyword::MTLLIB : ObjKeyword::UNKNOWN;
+      default: return ObjKeyword::UNKNOWN;
+    }
+  }
+
+  enum class MtlKeyword {
+    UNKNOWN,
+    NEWMTL,
+    KA,
+    KD,
+    KS,
+    KT, // also Tf
+    KE,
+    NI,
+    NS,
+    ILLUM,
+    D,
+    TR,
+    MAP_KA,
+    MAP_KD,
+    MAP_KS,
+    MAP_NS,
+    MAP_BUMP, // also map_Bump
+    BUMP,
+    MAP_D,
+    DISP,
+    REFL,
+  };
+
+  // the statement at token. keyword length and one or two bytes tell every mtl keyword apart,
+  // so this is a jump on the length and at most one short compare.
+  inline MtlKeyword mtlKeyword(const char* token) {
+    size_t n = strcspn(token, " \t");
+    if (token[n] == '\0') {
+      return MtlKeyword::UNKNOWN; // a keyword only counts when a space or tab follows it
+    }
+    switch (n) {
+      case 1:
+        return token[0] == 'd' ? MtlKeyword::D : MtlKeyword::UNKNOWN;
+      case 2:
+        switch ((token[0] << 8) | token[1]) {
+          case ('K' << 8) | 'a': return MtlKeyword::KA;
+          case ('K' << 8) | 'd': return MtlKeyword::KD;
+          case ('K' << 8) | 's': return MtlKeyword::KS;
+          case ('K' << 8) | 't': case ('T' << 8) | 'f': return MtlKeyword::KT;
+          case ('K' << 8) | 'e': return MtlKeyword::KE;
+          case ('N' << 8) | 'i': return MtlKeyword::NI;
+          case ('N' << 8) | 's': return MtlKeyword::NS;
+          case ('T' << 8) | 'r': return MtlKeyword::TR;
+          default: return MtlKeyword::UNKNOWN;
+        }
+      case 4:
+        if (0 == memcmp(token, "bump", 4)) return MtlKeyword::BUMP;
+        if (0 == memcmp(token, "disp", 4)) return MtlKeyword::DISP;
+        if (0 == memcmp(token, "refl", 4)) return MtlKeyword::REFL;
+        return MtlKeyword::UNKNOWN;
+      case 5:
+        if (0 == memcmp(token, "map_d", 5)) return MtlKeyword::MAP_D;
+        if (0 == memcmp(token, "illum", 5)) return MtlKeyword::ILLUM;
+        return MtlKeyword::UNKNOWN;
+      case 6:
+        if (0 == memcmp(token, "newmtl", 6)) return MtlKeyword::NEWMTL;
+        if (0 != memcmp(token, "map_", 4)) return MtlKeyword::UNKNOWN;
+        switch ((token[4] << 8) | token[5]) {
+          case ('K' << 8) | 'a': return MtlKeyword::MAP_KA;
+          case ('K' << 8) | 'd': return MtlKeyword::MAP_KD;
+          case ('K' << 8) | 's': return MtlKeyword::MAP_KS;
+          case ('N' << 8) | 's': return MtlKeyword::MAP_NS;
+          default: return MtlKeyword::UNKNOWN;
+        }
+      case 8:
+        return 0 == memcmp(token, "map_bump", 8) || 0 == memcmp(token, "map_Bump", 8) ? MtlKeyword::MAP_BUMP : MtlKeyword::UNKNOWN;
+      default:
+        return MtlKeyword::UNKNOWN;
+    }
+  }
+
   inline bool endsWith(const std::string& str, const std::string& suffix) {
     return str.size() >= suffix.size() && 0 == str.compare(str.size()-suffix.size(), suffix.size(), suffix);
   }
@@ -537,233 +1186,218 @@ namespace obj_loader {
   inline bool loadMtl(std::vector<Material>& materials, std::unordered_map<std::string, int>& material_map, std::istream& ifs) {
     Material current_mat;
     bool has_d = false;
-    std::string line_buf;
-
-    // preventing a empty file
-    while(ifs.peek() != -1) {
-      getLine(ifs, line_buf);
+    LineReader reader(ifs);
+    size_t length;
 
-      // Trim trailing whitespace.
-      if (!line_buf.empty()) {
-        line_buf = line_buf.substr(0, line_buf.find_last_not_of(" \t") + 1);
-      }
-
-      // Trim newline '\r\n' or '\n'
-      if (!line_buf.empty()) {
-        if (line_buf[line_buf.size() - 1] == '\n')
-          line_buf.erase(line_buf.size() - 1);
-      }
-      if (!line_buf.empty()) {
-        if (line_buf[line_buf.size() - 1] == '\r')
-          line_buf.erase(line_buf.size() - 1);
-      }
-
-      // Skip if empty line.
-      if (line_buf.empty()) {
-        continue;
+    while (char* line = reader.next(length)) {
+      // Trim trailing whitespace in place.
+      while (length > 0 && is_space(line[length - 1])) {
+        line[--length] = '\0';
       }
 
       // Skip leading space.
-      const char *token = line_buf.c_str(); // read only token
+      const char *token = line; // read only token
       token += strspn(token, " \t");
 
-      if (token == nullptr) return false;
       if (token[0] == '\0') continue;  // empty line
       if (token[0] == '#') continue;  // comment line
 
-      // new mtl
-      if ((0 == strncmp(token, "newmtl", 6)) && is_space((token[6]))) {
-        // save previous material
-        if (!current_mat.name.empty()) {
-          material_map.insert(std::make_pair(current_mat.name, static_cast<int>(materials.size())));
-          materials.emplace_back(current_mat);
-        }
+      switch (mtlKeyword(token)) {
+        // new mtl
+        case MtlKeyword::NEWMTL: {
+          // save previous material
+          if (!current_mat.name.empty()) {
+            material_map.insert(std::make_pair(current_mat.name, static_cast<int>(materials.size())));
+            materials.emplace_back(current_mat);
+          }
 
-        // reset material
-        current_mat = Material();
-        has_d = false;
+          // reset material
+          current_mat = Material();
+          has_d = false;
 
-        // parse new mat name
-        token += 7;
-        current_mat.name = parseString(&token);
-        continue;
-      }
+          // parse new mat name
+          token += 7;
+          current_mat.name = parseString(&token);
+          continue;
+        }
 
-      // ambient
-      if (token[0] == 'K' && token[1] == 'a' && is_space((token[2]))) {
-        token += 2;
-        vec3 ambient;
-        parseReal3(ambient, &token);
-        current_mat.ambient = ambient;
-        continue;
-      }
+        // ambient
+        case MtlKeyword::KA: {
+          token += 2;
+          vec3 ambient;
+          parseReal3(ambient, &token);
+          current_mat.ambient = ambient;
+          continue;
+        }
 
-      // diffuse
-      if (token[0] == 'K' && token[1] == 'd' && is_space((token[2]))) {
-        token += 2;
-        vec3 diffuse;
-        parseReal3(diffuse, &token);
-        current_mat.diffuse = diffuse;
-        continue;
-      }
+        // diffuse
+        case MtlKeyword::KD: {
+          token += 2;
+          vec3 diffuse;
+          parseReal3(diffuse, &token);
+          current_mat.diffuse = diffuse;
+          continue;
+        }
 
-      // specular
-      if (token[0] == 'K' && token[1] == 's' && is_space((token[2]))) {
-        token += 2;
-        vec3 specular;
-        parseReal3(specular, &token);
-        current_mat.specular = specular;
-        continue;
-      }
+        // specular
+        case MtlKeyword::KS: {
+          token += 2;
+          vec3 specular;
+          parseReal3(specular, &token);
+          current_mat.specular = specular;
+          continue;
+        }
 
-      // transmittance
-      if ((token[0] == 'K' && token[1] == 't' && is_space((token[2]))) ||
-          (token[0] == 'T' && token[1] == 'f' && is_space((token[2])))) {
-        token += 2;
-        vec3 transmittance;
-        parseReal3(transmittance, &token);
-        current_mat.transmittance = transmittance;
-        continue;
-      }
+        // transmittance
+        case MtlKeyword::KT: {
+          token += 2;
+          vec3 transmittance;
+          parseReal3(transmittance, &token);
+          current_mat.transmittance = transmittance;
+          continue;
+        }
 
-      // ior(index of refraction)
-      if (token[0] == 'N' && token[1] == 'i' && is_space((token[2]))) {
-        token += 2;
-        current_mat.ior = parseReal(&token, 0.f);
-        continue;
-      }
+        // ior(index of refraction)
+        case MtlKeyword::NI: {
+          token += 2;
+          current_mat.ior = parseReal(&token, 0.f);
+          continue;
+        }
 
-      // emission
-      if (token[0] == 'K' && token[1] == 'e' && is_space(token[2])) {
-        token += 2;
-        vec3 emission;
-        parseReal3(emission, &token);
-        current_mat.emission = emission;
-        continue;
-      }
+        // emission
+        case MtlKeyword::KE: {
+          token += 2;
+          vec3 emission;
+          parseReal3(emission, &token);
+          current_mat.emission = emission;
+          continue;
+        }
 
-      // shininess
-      if (token[0] == 'N' && token[1] == 's' && is_space(token[2])) {
-        token += 2;
-        current_mat.shininess = parseReal(&token, 0.f);
-        continue;
-      }
+        // shininess
+        case MtlKeyword::NS: {
+          token += 2;
+          current_mat.shininess = parseReal(&token, 0.f);
+          continue;
+        }
 
-      // illum model
-      if (0 == strncmp(token, "illum", 5) && is_space(token[5])) {
-        token += 6;
-        current_mat.illum = parseInt(&token);
-        continue;
-      }
+        // illum model
+        case MtlKeyword::ILLUM: {
+          token += 6;
+          current_mat.illum = parseInt(&token);
+          continue;
+        }
 
-      // dissolve (the non-transparency of the material), The default is 1.0 (not transparent at all)
-      if ((token[0] == 'd' && is_space(token[1]))) {
-        token += 1;
-        current_mat.dissolve = parseReal(&token, 1.f);
-        has_d = true;
-        continue;
-      }
+        // dissolve (the non-transparency of the material), The default is 1.0 (not transparent at all)
+        case MtlKeyword::D: {
+          token += 1;
+          current_mat.dissolve = parseReal(&token, 1.f);
+          has_d = true;
+          continue;
+        }
 
-      // dissolve (the transparency of the material): 1.0 - Tr, The default is 0.0 (not transparent at all)
-      if (token[0] == 'T' && token[1] == 'r' && is_space(token[2])) {
-        token += 2;
-        if (!has_d) {
-          current_mat.dissolve = 1.f - parseReal(&token, 0.f);
+        // dissolve (the transparency of the material): 1.0 - Tr, The default is 0.0 (not transparent at all)
+        case MtlKeyword::TR: {
+          token += 2;
+          if (!has_d) {
+            current_mat.dissolve = 1.f - parseReal(&token, 0.f);
+          }
+          continue;
         }
-        continue;
-      }
 
-      // ambient texture
-      if ((0 == strncmp(token, "map_Ka", 6)) && is_space(token[6])) {
-        token += 7;
-        Texture ambient;
-        if (parseTexture(ambient, token)) {
-          current_mat.texture_map.insert(std::make_pair(TextureType::AMBIENT, ambient));
+        // ambient texture
+        case MtlKeyword::MAP_KA: {
+          token += 7;
+          Texture ambient;
+          if (parseTexture(ambient, token)) {
+            current_mat.texture_map.insert(std::make_pair(TextureType::AMBIENT, ambient));
+          }
+          continue;
         }
-        continue;
-      }
 
-      // diffuse texture
-      if ((0 == strncmp(token, "map_Kd", 6)) && is_space(token[6])) {
-        token += 7;
-        Texture diffuse;
-        if (parseTexture(diffuse, token)) {
-          current_mat.texture_map.insert(std::make_pair(TextureType::DIFFUSE, diffuse));
+        // diffuse texture
+        case MtlKeyword::MAP_KD: {
+          token += 7;
+          Texture diffuse;
+          if (parseTexture(diffuse, token)) {
+            current_mat.texture_map.insert(std::make_pair(TextureType::DIFFUSE, diffuse));
+          }
+          continue;
         }
-        continue;
-      }
 
-      // specular texture
-      if ((0 == strncmp(token, "map_Ks", 6)) && is_space(token[6])) {
-        token += 7;
-        Texture specular;
-        if (parseTexture(specular, token)) {
-          current_mat.texture_map.insert(std::make_pair(TextureType::SPECULAR, specular));
+        // specular texture
+        case MtlKeyword::MAP_KS: {
+          token += 7;
+          Texture specular;
+          if (parseTexture(specular, token)) {
+            current_mat.texture_map.insert(std::make_pair(TextureType::SPECULAR, specular));
+          }
+          continue;
         }
-        continue;
-      }
 
-      // specular highlight texture
-      if ((0 == strncmp(token, "map_Ns", 6)) && is_space(token[6])) {
-        token += 7;
-        Texture specular_highlight;
-        if (parseTexture(specular_highlight, token)) {
-          current_mat.texture_map.insert(std::make_pair(TextureType::SPECULAR_HIGHLIGHT, specular_highlight));
+        // specular highlight texture
+        case MtlKeyword::MAP_NS: {
+          token += 7;
+          Texture specular_highlight;
+          if (parseTexture(specular_highlight, token)) {
+            current_mat.texture_map.insert(std::make_pair(TextureType::SPECULAR_HIGHLIGHT, specular_highlight));
+          }
+          continue;
         }
-        continue;
-      }
 
-      // bump texture
-      if (((0 == strncmp(token, "map_bump", 8)) && is_space(token[8])) ||
-          ((0 == strncmp(token, "map_Bump", 8)) && is_space(token[8]))) {
-        token += 9;
-        Texture bump;
-        if (parseTexture(bump, token)) {
-          bump.option.imfchan = 'l';
-          current_mat.texture_map.insert(std::make_pair(TextureType::BUMP, bump));
+        // bump texture
+        case MtlKeyword::MAP_BUMP: {
+          token += 9;
+          Texture bump;
+          if (parseTexture(bump, token)) {
+            bump.option.imfchan = 'l';
+            current_mat.texture_map.insert(std::make_pair(TextureType::BUMP, bump));
+          }
+          continue;
         }
-        continue;
-      }
 
-      // another name of bump map texture
-      if ((0 == strncmp(token, "bump", 4)) && is_space(token[4])) {
-        token += 5;
-        Texture bump;
-        if (parseTexture(bump, token)) {
-          bump.option.imfchan = 'l';
-          current_mat.texture_map.insert(std::make_pair(TextureType::BUMP, bump));
+        // another name of bump map texture
+        case MtlKeyword::BUMP: {
+          token += 5;
+          Texture bump;
+          if (parseTexture(bump, token)) {
+            bump.option.imfchan = 'l';
+            current_mat.texture_map.insert(std::make_pair(TextureType::BUMP, bump));
+          }
+          continue;
         }
-        continue;
-      }
 
-      // alpha texture
-      if ((0 == strncmp(token, "map_d", 5)) && is_space(token[5])) {
-        token += 6;
-        Texture alpha;
-        if (parseTexture(alpha, token)) {
-          current_mat.texture_map.insert(std::make_pair(TextureType::ALPHA, alpha));
+        // alpha texture
+        case MtlKeyword::MAP_D: {
+          token += 6;
+          Texture alpha;
+          if (parseTexture(alpha, token)) {
+            current_mat.texture_map.insert(std::make_pair(TextureType::ALPHA, alpha));
+          }
+          continue;
         }
-        continue;
-      }
 
-      // displacement texture
-      if ((0 == strncmp(token, "disp", 4)) && is_space(token[4])) {
-        token += 5;
-        Texture displacement;
-        if (parseTexture(displacement, token)) {
-          current_mat.texture_map.insert(std::make_pair(TextureType::DISPLACEMENT, displacement));
+        // displacement texture
+        case MtlKeyword::DISP: {
+          token += 5;
+          Texture displacement;
+          if (parseTexture(displacement, token)) {
+            current_mat.texture_map.insert(std::make_pair(TextureType::DISPLACEMENT, displacement));
+          }
+          continue;
         }
-        continue;
-      }
 
-      // reflection map
-      if ((0 == strncmp(token, "refl", 4)) && is_space(token[4])) {
-        token += 5;
-        Texture reflection;
-        if (parseTexture(reflection, token)) {
-          current_mat.texture_map.insert(std::make_pair(TextureType::REFLECTION, reflection));
+        // reflection map
+        case MtlKeyword::REFL: {
+          token += 5;
+          Texture reflection;
+          if (parseTexture(reflection, token)) {
+            current_mat.texture_map.insert(std::make_pair(TextureType::REFLECTION, reflection));
+          }
+          continue;
         }
-        continue;
+
+        default:
+          continue;
       }
     }
 
@@ -774,32 +1408,209 @@ namespace obj_loader {
     return true;
   }
 
-  inline bool parseMtl(const std::string& mtl_dir, std::vector<Material>& materials, std::unordered_map<std::string, int>& material_map) {
-    std::ifstream ifs(mtl_dir);
-    if (!ifs) {
+  // mtl_dir may name a .gz/.zst file, or one of the preloaded files
+  inline bool parseMtl(const std::string& mtl_dir, std::vector<Material>& materials, std::unordered_map<std::string, int>& material_map,
+                       const PreloadedFiles* preloaded = nullptr) {
+    OBJ_LOADER_TRACE_SCOPE("mtl");
+    InputFile input(mtl_dir, preloaded);
+    if (!input.is_open()) {
       return false;
     }
-    loadMtl(materials, material_map, ifs);
+    loadMtl(materials, material_map, input.stream());
+    return !input.failed();
+  }
+
+  // resolves a path to an absolute one with symlinks removed, and reads its modification time in nanoseconds
+  // (whole seconds on windows) and optionally its size.
+  inline bool canonicalPath(const std::string& path, std::string& canonical, long long& mtime, long long* size = nullptr) {
+#ifdef _WIN32
+    char buf[_MAX_PATH];
+    struct _stat64 st;
+    if (!_fullpath(buf, path.c_str(), _MAX_PATH) || _stat64(buf, &st) != 0) {
+      return false;
+    }
+#else
+    char buf[PATH_MAX];
+    struct stat st;
+    if (!realpath(path.c_str(), buf) || stat(buf, &st) != 0) {
+      return false;
+    }
+#endif
+    canonical.assign(buf);
+#if defined(_WIN32)
+    mtime = static_cast<long long>(st.st_mtime) * 1000000000ll;
+#elif defined(__APPLE__)
+    mtime = static_cast<long long>(st.st_mtimespec.tv_sec) * 1000000000ll + st.st_mtimespec.tv_nsec;
+#else
+    mtime = static_cast<long long>(st.st_mtim.tv_sec) * 1000000000ll + st.st_mtim.tv_nsec;
+#endif
+    if (size) {
+      *size = static_cast<long long>(st.st_size);
+    }
     return true;
   }
 
-  // NOTE: Geometry entities other than "facets" (including "points", "lines", "curves", etc.) and smooth group are not supported.
-  // make sure to check loadObj function return value is true or not.
-  bool loadObj(const std::string& path, Scene& scene, ParseOption parse_option) {
-    if (!endsWith(path, ".obj")) {
+  struct MaterialLibrary {
+    std::vector<Material> materials;
+    std::unordered_map<std::string, int> material_map;
+  };
+
+  // Parsed mtl files shared across loadObj calls (and threads), keyed by canonical path, mtime and size.
+  // Texture paths of every cached library are interned into one table, so a batch loads each texture once.
+  // the table spells paths like Scene::textures (base_dir + name), so textureId takes those as they are.
+  class MaterialCache {
+  public:
+    MaterialCache() : entries(), texture_ids(), texture_paths(), hits(0), misses(0) {}
+
+    // base_dir is what texture names are resolved against, the directory of the obj loading the library
+    std::shared_ptr<const MaterialLibrary> load(const std::string& path, const std::string& base_dir) {
+      std::string canonical;
+      long long mtime = 0, size = 0;
+      if (!canonicalPath(path, canonical, mtime, &size)) {
+        return nullptr;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(canonical);
+        if (it != entries.end() && it->second.mtime == mtime && it->second.size == size) {
+          hits++;
+          internTexturesLocked(*it->second.library, base_dir);
+          return it->second.library;
+        }
+        misses++;
+      }
+
+      // parse outside the lock, a racing load of the same file just wastes one parse
+      std::shared_ptr<MaterialLibrary> library = std::make_shared<MaterialLibrary>();
+      if (!parseMtl(canonical, library->materials, library->material_map)) {
+        return nullptr;
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      internTexturesLocked(*library, base_dir);
+      Entry& entry = entries[canonical];
+      entry.mtime = mtime;
+      entry.size = size;
+      entry.library = library;
+      return library;
+    }
+
+    // id of a resolved texture path in the shared table, -1 when no cached library references it
+    int textureId(const std::string& path) const {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = texture_ids.find(path);
+      return it == texture_ids.end() ? -1 : it->second;
+    }
+
+    std::vector<std::string> textures() const {
+      std::lock_guard<std::mutex> lock(mutex);
+      return texture_paths;
+    }
+
+    size_t hit_count() const { std::lock_guard<std::mutex> lock(mutex); return hits; }
+    size_t miss_count() const { std::lock_guard<std::mutex> lock(mutex); return misses; }
+
+    void clear() {
+      std::lock_guard<std::mutex> lock(mutex);
+      entries.clear();
+    }
+
+  private:
+    struct Entry {
+      long long mtime;
+      long long size;
+      std::shared_ptr<const MaterialLibrary> library;
+    };
+
+    // the same library loaded from objs in different directories resolves its textures once per directory
+    void internTexturesLocked(const MaterialLibrary& library, const std::string& base_dir) {
+      for (const Material& m : library.materials) {
+        for (const auto& t : m.texture_map) {
+          internLocked(base_dir + t.second.name);
+        }
+      }
+    }
+
+    int internLocked(const std::string& path) {
+      auto it = texture_ids.find(path);
+      if (it != texture_ids.end()) {
+        return it->second;
+      }
+      int id = static_cast<int>(texture_paths.size());
+      texture_ids.insert(std::make_pair(path, id));
+      texture_paths.emplace_back(path);
+      return id;
+    }
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<std::string, int> texture_ids;
+    std::vector<std::string> texture_paths;
+    size_t hits;
+    size_t misses;
+  };
+
+  inline bool appendMaterialLibrary(const MaterialLibrary& library, std::vector<Material>& materials, std::unordered_map<std::string, int>& material_map) {
+    int base = static_cast<int>(materials.size());
+    materials.insert(materials.end(), library.materials.begin(), library.materials.end());
+    for (const auto& it : library.material_map) {
+      material_map.insert(std::make_pair(it.first, base + it.second));
+    }
+    return true;
+  }
+
+  // assigns Texture::id, every distinct resolved path appears once in scene.textures
+  inline void internTextures(Scene& scene) {
+    OBJ_LOADER_TRACE_SCOPE("intern textures");
+    std::unordered_map<std::string, int> ids;
+    scene.textures.clear();
+    for (Material& m : scene.materials) {
+      for (auto& t : m.texture_map) {
+        std::string path = scene.base_dir + t.second.name;
+        auto it = ids.find(path);
+        if (it == ids.end()) {
+          it = ids.insert(std::make_pair(path, static_cast<int>(scene.textures.size()))).first;
+          scene.textures.emplace_back(path);
+        }
+        t.second.id = it->second;
+      }
+    }
+  }
+
+  // the loadObj body. flags answers the per element tests (TRIANGULATE, FLIP_UV, CALC_TANGENT),
+  // PRESCAN and MERGE_MATERIALS are read from parse_option since they only act around the parse loop.
+  // Index is the face index type: int for the default path, int64_t with LARGE_INDICES.
+  template <typename Index, typename Flags>
+  bool loadObjWith(const std::string& path, Scene& scene, Flags flags, ParseOption parse_option, Arena* scratch,
+                   MaterialCache* material_cache, VertexBuffer* packed, const PreloadedFiles* preloaded) {
+    if (!endsWith(stripCompression(path), ".obj")) {
       return false;
     }
+    OBJ_LOADER_TRACE_SCOPE("parse obj");
 
-    std::ifstream ifs(path);
-    if(!ifs) {
+    InputFile input(path, preloaded);
+    if (!input.is_open()) {
       return false;
     }
+    std::istream& ifs = input.stream();
 
-    std::vector<vec3> vertices;
-    std::vector<vec2> texcoords;
-    std::vector<vec3> normals;
+    ArenaScope scratch_scope(scratch);
+    ScratchVector<vec3> vertices{ArenaAllocator<vec3>(scratch)};
+    ScratchVector<vec2> texcoords{ArenaAllocator<vec2>(scratch)};
+    ScratchVector<vec3> normals{ArenaAllocator<vec3>(scratch)};
     std::unordered_map<std::string, int> material_map;
-    PrimitiveGroup current_prim;
+    BasicPrimitiveGroup<Index> current_prim(scratch);
+    const bool prescan = parse_option & ParseOption::PRESCAN;
+    if (prescan && input.seekable()) {
+      ObjCounts counts;
+      prescanObj(ifs, counts);
+      vertices.reserve(counts.vertices);
+      texcoords.reserve(counts.texcoords);
+      normals.reserve(counts.normals);
+      // faces are cleared, not freed, between groups, so this is the only face allocation
+      current_prim.faces.reserve(counts.faces);
+    }
     std::string current_object_name;
     std::string current_material_name;
     Mesh current_mesh;
@@ -807,193 +1618,287 @@ namespace obj_loader {
     std::pair<std::string, std::string> pair = splitDelims(path, "\\/");
     scene.base_dir = pair.first;
     std::string filename = pair.second;
-    std::string line_buf;
 
-    // preventing a empty file
-    while(ifs.peek() != -1) {
-      getLine(ifs, line_buf);
-
-      // Trim newline '\r\n' or '\n'
-      if (!line_buf.empty()) {
-        if (line_buf[line_buf.size() - 1] == '\n')
-          line_buf.erase(line_buf.size() - 1);
+    // a packed mesh is one contiguous range of the buffer, so merging only applies to meshes with their own vertices
+    const bool merge = (parse_option & ParseOption::MERGE_MATERIALS) && !packed;
+    std::unordered_map<int, size_t> material_meshes; // material id -> its mesh in scene.meshes when merging
+    // without LARGE_INDICES a mesh past 2^32 - 1 vertices cannot be indexed, the load fails instead of wrapping
+    const bool wide = sizeof(Index) > sizeof(int);
+    bool overflow = false;
+    auto fits = [&](const Mesh& mesh) {
+      if (!wide && std::max(mesh.vertices.size(), mesh.vertex_count) > 0xffffffffu) overflow = true;
+    };
+    // assembles the pending faces, as a mesh of its own or appended to the mesh of its material.
+    // returns whether a mesh or range came out of them.
+    auto flushPrimitive = [&](bool keep_empty) -> bool {
+      if (!merge) {
+        bool assembled = assemblePrimitive(current_mesh, current_prim, flags, current_material_id, vertices, texcoords, normals, current_object_name, filename, packed);
+        fits(current_mesh);
+        bool emitted = !current_mesh.empty() || (keep_empty && assembled);
+        if (emitted) {
+          scene.meshes.emplace_back(std::move(current_mesh));
+        }
+        current_prim.faces.clear();
+        current_mesh = Mesh();
+        return emitted;
       }
-      if (!line_buf.empty()) {
-        if (line_buf[line_buf.size() - 1] == '\r')
-          line_buf.erase(line_buf.size() - 1);
+      if (current_prim.is_empty()) {
+        return false;
       }
 
-      // Skip if empty line.
-      if (line_buf.empty()) {
-        continue;
+      auto it = material_meshes.find(current_material_id);
+      const bool created = it == material_meshes.end();
+      if (created) {
+        it = material_meshes.emplace(current_material_id, scene.meshes.size()).first;
+        scene.meshes.emplace_back();
+      }
+      Mesh& mesh = scene.meshes[it->second];
+      MeshRange range;
+      range.first_index = mesh.index_count();
+      range.first_vertex = mesh.vertices.size();
+      std::string merged_name = mesh.name;
+      assemblePrimitive(mesh, current_prim, flags, current_material_id, vertices, texcoords, normals, current_object_name, filename);
+      fits(mesh);
+      current_prim.faces.clear();
+      range.name = mesh.name;
+      range.index_count = mesh.index_count() - range.first_index;
+      range.vertex_count = mesh.vertices.size() - range.first_vertex;
+      if (range.vertex_count == 0) {
+        if (created) {
+          scene.meshes.pop_back();
+          material_meshes.erase(it);
+        } else {
+          mesh.name = merged_name;
+        }
+        return false;
+      }
+      if (created) {
+        bool named = current_material_id >= 0 && current_material_id < static_cast<int>(scene.materials.size());
+        merged_name = named ? scene.materials[current_material_id].name : range.name;
       }
+      mesh.name = merged_name;
+      mesh.ranges.emplace_back(std::move(range));
+      return true;
+    };
 
+    LineReader reader(ifs);
+    size_t length;
+
+    while (const char* line = reader.next(length)) {
       // Skip leading space.
-      const char *token = line_buf.c_str(); // read only token
+      const char *token = line; // read only token
       token += strspn(token, " \t");
 
-      if (token == nullptr) return false;
       if (token[0] == '\0') continue;  // empty line
       if (token[0] == '#') continue;  // comment line
 
-      // vertex
-      if (token[0] == 'v' && is_space((token[1]))) {
-        token += 2;
-        vec3 v;
-        parseReal3(v, &token);
-        vertices.emplace_back(v);
-        continue;
-      }
+      switch (objKeyword(token)) {
+        // vertex
+        case ObjKeyword::VERTEX: {
+          token += 2;
+          vec3 v;
+          parseReal3(v, &token);
+          scene.bounds.expand(v);
+          vertices.emplace_back(v);
+          continue;
+        }
 
-      // normal
-      if (token[0] == 'v' && token[1] == 'n' && is_space((token[2]))) {
-        token += 3;
-        vec3 vn;
-        parseReal3(vn, &token);
-        normals.emplace_back(vn);
-        continue;
-      }
+        // normal
+        case ObjKeyword::NORMAL: {
+          token += 3;
+          vec3 vn;
+          parseReal3(vn, &token);
+          normals.emplace_back(vn);
+          continue;
+        }
 
-      // texcoord
-      if (token[0] == 'v' && token[1] == 't' && is_space((token[2]))) {
-        token += 3;
-        vec2 vt;
-        parseReal2(vt, &token);
-        if (parse_option & ParseOption::FLIP_UV) {
-          vt.y = 1.f - vt.y;
+        // texcoord
+        case ObjKeyword::TEXCOORD: {
+          token += 3;
+          vec2 vt;
+          parseReal2(vt, &token);
+          if (flags(ParseOption::FLIP_UV)) {
+            vt.y = 1.f - vt.y;
+          }
+          texcoords.emplace_back(vt);
+          continue;
         }
-        texcoords.emplace_back(vt);
-        continue;
-      }
 
-      // face
-      if (token[0] == 'f' && is_space((token[1]))) {
-        token += 2;
-        token += strspn(token, " \t"); // Skip leading space.
+        // face
+        case ObjKeyword::FACE: {
+          token += 2;
+          token += strspn(token, " \t"); // Skip leading space.
+
+          BasicFace<Index> f(scratch);
+          if (prescan) {
+            // exact corner count of this face
+            size_t corners = 0;
+            for (const char* p = token; !is_new_line(p[0]); p += strspn(p, " \t")) {
+              p += strcspn(p, " \t\r");
+              corners++;
+            }
+            f.vertex_indices.reserve(corners);
+          } else {
+            f.vertex_indices.reserve(3);
+          }
 
-        Face f;
-        f.vertex_indices.reserve(3);
+          while (!is_new_line(token[0])) {
+            BasicVertexIndex<Index> vi;
+            if (!parseIndices(&token, vertices.size(), normals.size(), texcoords.size(), &vi)) {
+              return false;
+            }
 
-        while (!is_new_line(token[0])) {
-          VertexIndex vi;
-          if (!parseIndices(&token, vertices.size(), normals.size(), texcoords.size(), &vi)) {
-            return false;
+            // finish parse indices
+            f.vertex_indices.emplace_back(vi);
+            token += strspn(token, " \t\r"); // skip space
           }
 
-          // finish parse indices
-          f.vertex_indices.emplace_back(vi);
-          token += strspn(token, " \t\r"); // skip space
+          current_prim.faces.emplace_back(std::move(f));
+          continue;
         }
 
-        current_prim.faces.emplace_back(f);
-        continue;
-      }
-
-      // use mtl
-      if ((0 == strncmp(token, "usemtl", 6)) && is_space((token[6]))) {
-        token += 7;
-        std::string new_material_name = parseString(&token);
-        int new_material_id = -1;
-        // find material id
-        if (material_map.find(new_material_name) != material_map.end()) {
-          new_material_id = material_map[new_material_name];
-        }
-
-        // check current material and previous
-        if (new_material_name != current_material_name) {
-          // when current object name is empty, then assign current material name as alternatives.
-          if (current_object_name.empty()) {
-            current_object_name = new_material_name;
+        // use mtl
+        case ObjKeyword::USEMTL: {
+          token += 7;
+          std::string new_material_name = parseString(&token);
+          int new_material_id = -1;
+          // find material id
+          if (material_map.find(new_material_name) != material_map.end()) {
+            new_material_id = material_map[new_material_name];
           }
-          parsePrimitive(current_mesh, current_prim, parse_option, current_material_id, vertices, texcoords, normals, current_object_name, filename); // return value not used
-          if (!current_mesh.vertices.empty()) {
-            scene.meshes.emplace_back(current_mesh);
-            // when successfully push a new mesh, then cache current material name.
-            current_object_name = new_material_name;
+
+          // check current material and previous
+          if (new_material_name != current_material_name) {
+            // when current object name is empty, then assign current material name as alternatives.
+            if (current_object_name.empty()) {
+              current_object_name = new_material_name;
+            }
+            if (flushPrimitive(false)) {
+              // when successfully push a new mesh, then cache current material name.
+              current_object_name = new_material_name;
+            }
+            // cache new material id
+            current_material_id = new_material_id;
+            current_material_name = new_material_name;
           }
-          // reset
-          current_prim = PrimitiveGroup();
-          current_mesh = Mesh();
-          // cache new material id
-          current_material_id = new_material_id;
-          current_material_name = new_material_name;
+          continue;
         }
-        continue;
-      }
 
-      // load mtl
-      if ((0 == strncmp(token, "mtllib", 6)) && is_space((token[6]))) {
-        token += 7;
-        std::vector<std::string> mtl_file_names;
-        // parse multiple mtl filenames split by whitespace
-        split(mtl_file_names, " ", &token);
-        // load just one available mtl file in the list
-        for (std::string& name : mtl_file_names) {
-          if (parseMtl(scene.base_dir + name, scene.materials, material_map)) {
-            break;
+        // load mtl
+        case ObjKeyword::MTLLIB: {
+          token += 7;
+          std::vector<std::string> mtl_file_names;
+          // parse multiple mtl filenames split by whitespace
+          split(mtl_file_names, " ", &token);
+          // load just one available mtl file in the list
+          for (std::string& name : mtl_file_names) {
+            std::string mtl_path = scene.base_dir + name;
+            if (!preloaded || preloaded->find(mtl_path) == preloaded->end()) {
+              mtl_path = resolveInput(mtl_path);
+            }
+            if (material_cache) {
+              std::shared_ptr<const MaterialLibrary> library = material_cache->load(mtl_path, scene.base_dir);
+              if (library && appendMaterialLibrary(*library, scene.materials, material_map)) {
+                scene.material_libraries.emplace_back(mtl_path);
+                break;
+              }
+            } else if (parseMtl(mtl_path, scene.materials, material_map, preloaded)) {
+              scene.material_libraries.emplace_back(mtl_path);
+              break;
+            }
           }
+          continue;
         }
-        continue;
-      }
 
-      // group name
-      if (token[0] == 'g' && is_space((token[1]))) {
-        parsePrimitive(current_mesh, current_prim, parse_option, current_material_id, vertices, texcoords, normals, current_object_name, filename); // return value not used
-        if (!current_mesh.vertices.empty()) {
-          scene.meshes.emplace_back(current_mesh);
-          current_object_name = "";
-        }
+        // group name
+        case ObjKeyword::GROUP: {
+          if (flushPrimitive(false)) {
+            current_object_name = "";
+          }
 
-        // reset
-        current_prim = PrimitiveGroup();
-        current_mesh = Mesh();
+          token += 2;
 
-        token += 2;
+          // assemble multi group name
+          std::vector<std::string> names;
+          while (!is_new_line(token[0])) {
+            names.emplace_back(parseString(&token));
+            token += strspn(token, " \t\r"); // skip space
+          }
+
+          if (!names.empty()) {
+            std::stringstream ss;
+            std::vector<std::string>::const_iterator it = names.begin();
+            ss << *it++;
+            for (; it != names.end(); it++) {
+              ss << " " << *it;
+            }
+            current_object_name = ss.str();
+          }
 
-        // assemble multi group name
-        std::vector<std::string> names;
-        while (!is_new_line(token[0])) {
-          names.emplace_back(parseString(&token));
-          token += strspn(token, " \t\r"); // skip space
+          continue;
         }
 
-        if (!names.empty()) {
-          std::stringstream ss;
-          std::vector<std::string>::const_iterator it = names.begin();
-          ss << *it++;
-          for (; it != names.end(); it++) {
-            ss << " " << *it;
+        // object name
+        case ObjKeyword::OBJECT: {
+          if (flushPrimitive(false)) {
+            current_object_name = "";
           }
-          current_object_name = ss.str();
+
+          token += 2;
+          current_object_name = parseString(&token);
+          continue;
         }
 
-        continue;
+        default:
+          continue;
       }
+    }
 
-      // object name
-      if (token[0] == 'o' && is_space((token[1]))) {
-        parsePrimitive(current_mesh, current_prim, parse_option, current_material_id, vertices, texcoords, normals, current_object_name, filename); // return value not used
-        if (!current_mesh.vertices.empty()) {
-          scene.meshes.emplace_back(current_mesh);
-          current_object_name = "";
-        }
+    flushPrimitive(true);
+    internTextures(scene);
 
-        // reset
-        current_prim = PrimitiveGroup();
-        current_mesh = Mesh();
+    return !input.failed() && !overflow;
+  }
 
-        token += 2;
-        current_object_name = parseString(&token);
-        continue;
-      }
+  // NOTE: Geometry entities other than "facets" (including "points", "lines", "curves", etc.) and smooth group are not supported.
+  // make sure to check loadObj function return value is true or not.
+  // when scratch is given, every parse temporary is bump allocated from it and released again on return,
+  // so one arena can be reused across a batch of loads. the returned scene always owns its memory.
+  // with a material cache, mtl files already parsed by an earlier call are copied instead of re-read.
+  // .obj.gz/.obj.zst are decompressed on a background thread while parsing, mtl files may be compressed too.
+  // with packed, every vertex is written once in the buffer layout and meshes only keep ranges of it.
+  // MERGE_MATERIALS assembles every group straight into the mesh of its material, Mesh::ranges keeps the groups
+  // (ignored with packed).
+  // with preloaded, the obj and its mtl files are parsed from memory when their paths are in the set.
+  // LARGE_INDICES parses face indices as 64 bit and moves a mesh to Mesh::indices64 once it passes 2^32 - 1 vertices.
+  // without it such a mesh, or an index past INT_MAX, makes the load fail.
+  bool loadObj(const std::string& path, Scene& scene, ParseOption parse_option, Arena* scratch = nullptr,
+               MaterialCache* material_cache = nullptr, VertexBuffer* packed = nullptr, const PreloadedFiles* preloaded = nullptr) {
+    if (parse_option & ParseOption::LARGE_INDICES) {
+      // the wide path is rare enough that one dynamic instantiation covers it
+      return loadObjWith<int64_t>(path, scene, DynamicParseOption(parse_option), parse_option, scratch, material_cache, packed, preloaded);
     }
-
-    bool ret = parsePrimitive(current_mesh, current_prim, parse_option, current_material_id, vertices, texcoords, normals, current_object_name, filename);
-    if (ret || !current_mesh.vertices.empty()) {
-      scene.meshes.emplace_back(current_mesh);
+    const ParseOption T = ParseOption::TRIANGULATE, F = ParseOption::FLIP_UV, C = ParseOption::CALC_TANGENT;
+    switch (static_cast<unsigned int>(parse_option) & static_cast<unsigned int>(T | F | C)) {
+      case 1: return loadObjWith<int>(path, scene, StaticParseOption<T>(), parse_option, scratch, material_cache, packed, preloaded);
+      case 2: return loadObjWith<int>(path, scene, StaticParseOption<F>(), parse_option, scratch, material_cache, packed, preloaded);
+      case 3: return loadObjWith<int>(path, scene, StaticParseOption<T | F>(), parse_option, scratch, material_cache, packed, preloaded);
+      case 4: return loadObjWith<int>(path, scene, StaticParseOption<C>(), parse_option, scratch, material_cache, packed, preloaded);
+      case 5: return loadObjWith<int>(path, scene, StaticParseOption<T | C>(), parse_option, scratch, material_cache, packed, preloaded);
+      case 6: return loadObjWith<int>(path, scene, StaticParseOption<F | C>(), parse_option, scratch, material_cache, packed, preloaded);
+      case 7: return loadObjWith<int>(path, scene, StaticParseOption<T | F | C>(), parse_option, scratch, material_cache, packed, preloaded);
+      default: return loadObjWith<int>(path, scene, StaticParseOption<ParseOption::NONE>(), parse_option, scratch, material_cache, packed, preloaded);
     }
+  }
 
-    return true;
+  // loadObj without the specialized instantiations, every flag is tested where it is used. kept as the baseline
+  // the specialized paths are measured against.
+  bool loadObjDynamic(const std::string& path, Scene& scene, ParseOption parse_option, Arena* scratch = nullptr,
+                      MaterialCache* material_cache = nullptr, VertexBuffer* packed = nullptr, const PreloadedFiles* preloaded = nullptr) {
+    if (parse_option & ParseOption::LARGE_INDICES) {
+      return loadObjWith<int64_t>(path, scene, DynamicParseOption(parse_option), parse_option, scratch, material_cache, packed, preloaded);
+    }
+    return loadObjWith<int>(path, scene, DynamicParseOption(parse_option), parse_option, scratch, material_cache, packed, preloaded);
   }
 }
 
@@ -0,0 +1,567 @@
+#ifndef MODEL_LOAD_OBJ_WRITER_H
+#define MODEL_LOAD_OBJ_WRITER_H
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "obj_loader.h"
+#include "thread_pool.h"
+#include "trace.h"
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace obj_loader {
+  namespace write_detail {
+    static const char digit_pairs[] =
+      "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+      "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+      "8081828384858687888990919293949596979899";
+
+    // exact powers of ten up to 1e22, larger ones are not representable in a double
+    static const double exact_pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                         1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    static const double inverse_pow10[] = {1e0, 1e-1, 1e-2, 1e-3, 1e-4, 1e-5, 1e-6, 1e-7, 1e-8, 1e-9};
+    static const uint64_t pow10_u64[] = {1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+                                         10000000ull, 100000000ull, 1000000000ull, 10000000000ull};
+
+    inline size_t digitCount(uint64_t v) {
+      size_t n = 1;
+      for (; v >= 100; v /= 100) n += 2;
+      return n + (v >= 10);
+    }
+
+    // decimal digits of v, returns the length. out needs 20 chars.
+    inline size_t formatUint(uint64_t v, char* out) {
+      const size_t n = digitCount(v);
+      char* p = out + n;
+      while (v >= 100) {
+        const size_t i = static_cast<size_t>(v % 100) * 2;
+        v /= 100;
+        *--p = digit_pairs[i + 1];
+        *--p = digit_pairs[i];
+      }
+      if (v >= 10) {
+        *--p = digit_pairs[v * 2 + 1];
+        *--p = digit_pairs[v * 2];
+      } else {
+        *--p = static_cast<char>('0' + v);
+      }
+      return n;
+    }
+
+    // v * 10^k in double. a single correctly rounded operation while |k| <= 22.
+    inline double scale10(double v, int k) {
+      while (k > 22) { v *= 1e22; k -= 22; }
+      while (k < -22) { v /= 1e22; k += 22; }
+      return k >= 0 ? v * exact_pow10[k] : v / exact_pow10[-k];
+    }
+
+    // whether the decimal digits * 10^exponent read back (strtod, then rounded to float) as value
+    inline bool readsBackAs(uint64_t digits, int exponent, float value) {
+      if (exponent >= -22 && exponent <= 22) {
+        // digits < 2^53 and the power is exact, so this is the correctly rounded double strtod would give
+        return static_cast<float>(scale10(static_cast<double>(digits), exponent)) == value;
+      }
+      char text[40];
+      snprintf(text, sizeof(text), "%llue%d", static_cast<unsigned long long>(digits), exponent);
+      return static_cast<float>(strtod(text, nullptr)) == value;
+    }
+
+    // Shortest decimal that reads back as the same float through atof/strtod (the loader's parseReal),
+    // so a load, write, load cycle is bit exact. Tries 1 to 9 significant digits; 9 always round trips.
+    // Plain notation for exponents in [-5, 9), otherwise d.ddde[-]x. out needs 24 chars.
+    inline size_t formatFloat(float value, char* out) {
+      char* p = out;
+      uint32_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      if (bits >> 31) *p++ = '-';
+      bits &= 0x7fffffffu;
+      if (bits == 0) {
+        *p++ = '0';
+        return static_cast<size_t>(p - out);
+      }
+      if (bits >= 0x7f800000u) {
+        memcpy(p, bits == 0x7f800000u ? "inf" : "nan", 3);
+        return static_cast<size_t>(p + 3 - out);
+      }
+
+      const float a = std::fabs(value);
+      const double v = a;
+      // decimal exponent of the first digit, from the binary one (log10(2) ~ 78913 / 2^18) and one correction
+      int e2;
+      std::frexp(v, &e2);
+      int e10 = ((e2 - 1) * 78913) >> 18;
+
+      // v scaled to 9 integer digits once, with half the float spacing around it in the same units.
+      // a candidate further from v than that cannot read back as v, so the exact check only runs near the end.
+      double factor = scale10(1.0, 8 - e10);
+      double scaled = v * factor;
+      if (scaled >= 1e9) {
+        e10++;
+        factor *= 0.1;
+        scaled = v * factor;
+      }
+      const double reach = std::ldexp(factor, std::max(e2, -125) - 25) * 1.000001;
+      uint64_t digits = 0;
+      int exponent = 0; // value == digits * 10^exponent
+      int count = 0;
+      for (int d = 1; d <= 9; d++) {
+        uint64_t c = static_cast<uint64_t>(scaled * inverse_pow10[9 - d] + 0.5);
+        if (d < 9 && std::fabs(static_cast<double>(c) * exact_pow10[9 - d] - scaled) > reach) continue;
+        int e = e10 - d + 1;
+        if (c >= pow10_u64[d]) { // rounded up to the next power of ten
+          c /= 10;
+          e++;
+        }
+        if (readsBackAs(c, e, a)) {
+          digits = c;
+          exponent = e;
+          count = d;
+          break;
+        }
+      }
+      if (count == 0) {
+        // scaling error at the last digit, let the c library pick the 9 digits
+        return static_cast<size_t>(p - out) + static_cast<size_t>(snprintf(p, 24, "%.9g", v));
+      }
+      while (digits % 10 == 0) {
+        digits /= 10;
+        exponent++;
+      }
+
+      char buf[20];
+      const int n = static_cast<int>(formatUint(digits, buf));
+      const int lead = exponent + n - 1; // exponent of the first digit
+      if (lead >= -5 && lead < 9) {
+        if (exponent >= 0) {
+          memcpy(p, buf, n);
+          p += n;
+          for (int i = 0; i < exponent; i++) *p++ = '0';
+        } else if (lead >= 0) {
+          memcpy(p, buf, lead + 1);
+          p += lead + 1;
+          *p++ = '.';
+          memcpy(p, buf + lead + 1, n - lead - 1);
+          p += n - lead - 1;
+        } else {
+          *p++ = '0';
+          *p++ = '.';
+          for (int i = -1; i > lead; i--) *p++ = '0';
+          memcpy(p, buf, n);
+          p += n;
+        }
+        return static_cast<size_t>(p - out);
+      }
+      *p++ = buf[0];
+      if (n > 1) {
+        *p++ = '.';
+        memcpy(p, buf + 1, n - 1);
+        p += n - 1;
+      }
+      *p++ = 'e';
+      if (lead < 0) *p++ = '-';
+      p += formatUint(static_cast<uint64_t>(lead < 0 ? -lead : lead), p);
+      return static_cast<size_t>(p - out);
+    }
+
+    // appends into a buffer sized up front for the block, so there is no per line bounds check
+    class LineWriter {
+    public:
+      LineWriter(std::vector<char>& buffer, size_t max_bytes) : buffer(buffer) {
+        buffer.resize(max_bytes);
+        p = buffer.data();
+      }
+      ~LineWriter() { buffer.resize(static_cast<size_t>(p - buffer.data())); }
+
+      void text(const char* s, size_t n) { memcpy(p, s, n); p += n; }
+      void put(char c) { *p++ = c; }
+      void real(float v) { p += formatFloat(v, p); }
+      void index(uint64_t v) { p += formatUint(v, p); }
+
+    private:
+      std::vector<char>& buffer;
+      char* p;
+    };
+
+    inline bool nonZero(float v) {
+      uint32_t bits;
+      memcpy(&bits, &v, sizeof(bits));
+      return bits != 0;
+    }
+
+    inline uint64_t indexAt(const Mesh& mesh, size_t i) {
+      return mesh.indices64.empty() ? mesh.indices[i] : mesh.indices64[i];
+    }
+
+    inline const char* textureKeyword(TextureType type) {
+      switch (type) {
+        case TextureType::AMBIENT: return "map_Ka";
+        case TextureType::DIFFUSE: return "map_Kd";
+        case TextureType::SPECULAR: return "map_Ks";
+        case TextureType::SPECULAR_HIGHLIGHT: return "map_Ns";
+        case TextureType::BUMP: return "map_bump";
+        case TextureType::DISPLACEMENT: return "disp";
+        case TextureType::ALPHA: return "map_d";
+        case TextureType::REFLECTION: return "refl";
+      }
+      return "map_Kd";
+    }
+
+    inline const char* textureFaceName(TextureFace face) {
+      switch (face) {
+        case TextureFace::TEX_3D_SPHERE: return "sphere";
+        case TextureFace::TEX_3D_CUBE_TOP: return "cube_top";
+        case TextureFace::TEX_3D_CUBE_BOTTOM: return "cube_bottom";
+        case TextureFace::TEX_3D_CUBE_FRONT: return "cube_front";
+        case TextureFace::TEX_3D_CUBE_BACK: return "cube_back";
+        case TextureFace::TEX_3D_CUBE_LEFT: return "cube_left";
+        case TextureFace::TEX_3D_CUBE_RIGHT: return "cube_right";
+        default: return nullptr;
+      }
+    }
+
+    inline void appendReal(std::string& out, float v) {
+      char buf[24];
+      out.append(buf, formatFloat(v, buf));
+    }
+
+    inline void appendReal3(std::string& out, const char* keyword, const vec3& v) {
+      out += keyword;
+      out += ' ';
+      appendReal(out, v.x);
+      out += ' ';
+      appendReal(out, v.y);
+      out += ' ';
+      appendReal(out, v.z);
+      out += '\n';
+    }
+
+    // whole buffer list as one file: a shared mapping filled in parallel where available, one stream otherwise
+    inline bool writeBlocks(const std::string& path, const std::vector<std::vector<char>>& blocks, size_t count, ThreadPool* pool) {
+      std::vector<size_t> offsets(count + 1, 0);
+      for (size_t i = 0; i < count; i++) offsets[i + 1] = offsets[i] + blocks[i].size();
+      const size_t total = offsets[count];
+#ifdef __linux__
+      int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if (fd < 0) {
+        return false;
+      }
+      if (total == 0) {
+        return ::close(fd) == 0;
+      }
+      if (ftruncate(fd, static_cast<off_t>(total)) == 0) {
+        void* mapped = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped != MAP_FAILED) {
+          char* dst = static_cast<char*>(mapped);
+          auto copy = [&](size_t i) {
+            if (!blocks[i].empty()) memcpy(dst + offsets[i], blocks[i].data(), blocks[i].size());
+          };
+          if (pool) pool->parallel_for(count, copy);
+          else for (size_t i = 0; i < count; i++) copy(i);
+          bool ok = munmap(mapped, total) == 0;
+          return (::close(fd) == 0) && ok;
+        }
+      }
+      // no mapping (e.g. a pipe or a full disk): plain writes in order
+      bool ok = true;
+      size_t done = 0;
+      for (size_t i = 0; i < count && ok; i++) {
+        size_t n = 0;
+        while (n < blocks[i].size()) {
+          ssize_t w = pwrite(fd, blocks[i].data() + n, blocks[i].size() - n, static_cast<off_t>(done + n));
+          if (w < 0 && errno == EINTR) continue;
+          if (w <= 0) {
+            ok = false;
+            break;
+          }
+          n += static_cast<size_t>(w);
+        }
+        done += n;
+      }
+      return (::close(fd) == 0) && ok;
+#else
+      (void)pool;
+      FILE* fp = fopen(path.c_str(), "wb");
+      if (!fp) {
+        return false;
+      }
+      bool ok = true;
+      for (size_t i = 0; i < count && ok; i++) {
+        ok = blocks[i].empty() || fwrite(blocks[i].data(), 1, blocks[i].size(), fp) == blocks[i].size();
+      }
+      return (fclose(fp) == 0) && ok;
+#endif
+    }
+  }
+
+  // Writes scenes as obj text. Each mesh is one `g` group of triangles with its own v/vt/vn records, so
+  // reloading with ParseOption::TRIANGULATE gives back the same vertices, indices, names and materials.
+  // Meshes are read as triangle lists: load the source with TRIANGULATE, and packed meshes (no vertices) are
+  // not supported. Vertex and face blocks are formatted in chunks on the pool into buffers the writer keeps,
+  // so one writer reused across files stops allocating once its buffers have grown.
+  class ObjWriter {
+  public:
+    explicit ObjWriter(ThreadPool* pool = nullptr, size_t chunk_size = 32 * 1024)
+      : pool(pool), chunk_size(chunk_size ? chunk_size : 1), blocks(), bytes(0) {}
+
+    // obj at path; with materials, their library is written next to it under the same stem (.mtl) and referenced
+    bool write(const Scene& scene, const std::string& path) {
+      OBJ_LOADER_TRACE_SCOPE("write obj");
+      std::string mtl_name;
+      if (!scene.materials.empty()) {
+        std::pair<std::string, std::string> parts = splitDelims(path, "\\/");
+        std::string stem = parts.second.substr(0, parts.second.find_last_of('.'));
+        mtl_name = stem + ".mtl";
+        if (!writeMaterials(scene.materials, parts.first + mtl_name)) {
+          return false;
+        }
+      }
+      const size_t mtl_bytes = mtl_name.empty() ? 0 : bytes;
+
+      struct Block {
+        enum Kind { TEXT, POSITION, TEXCOORD, NORMAL, FACE } kind;
+        size_t mesh, begin, end;
+        uint64_t v_base, vt_base, vn_base; // 1 based index of the first record of the mesh
+        bool uv, normal;
+      };
+      std::vector<Block> plan;
+      std::vector<std::string> texts;
+      auto text = [&](std::string s) {
+        Block block = Block();
+        block.kind = Block::TEXT;
+        block.mesh = texts.size();
+        texts.emplace_back(std::move(s));
+        plan.emplace_back(block);
+      };
+
+      std::string header = "# written by obj_loader\n";
+      if (!mtl_name.empty()) header += "mtllib " + mtl_name + "\n";
+      text(header);
+
+      uint64_t v_base = 1, vt_base = 1, vn_base = 1;
+      int material = -1;
+      for (size_t m = 0; m < scene.meshes.size(); m++) {
+        const Mesh& mesh = scene.meshes[m];
+        const size_t index_count = mesh.index_count();
+        if (mesh.vertices.empty() || index_count % 3 != 0) {
+          if (mesh.vertex_count != 0 || index_count % 3 != 0) return false;
+          continue;
+        }
+        Block block = Block();
+        block.mesh = m;
+        block.v_base = v_base;
+        block.vt_base = vt_base;
+        block.vn_base = vn_base;
+        // zero attributes are what the loader fills in for missing ones, so those blocks can be left out
+        for (const Vertex& vtx : mesh.vertices) {
+          block.uv = block.uv || write_detail::nonZero(vtx.texcoord.x) || write_detail::nonZero(vtx.texcoord.y);
+          block.normal = block.normal || write_detail::nonZero(vtx.normal.x) || write_detail::nonZero(vtx.normal.y) ||
+                         write_detail::nonZero(vtx.normal.z);
+          if (block.uv && block.normal) break;
+        }
+
+        std::string group = "g " + mesh.name + "\n";
+        if (mesh.material_id != material) {
+          const bool known = mesh.material_id >= 0 && mesh.material_id < static_cast<int>(scene.materials.size());
+          // a bare usemtl resets the material of the following faces to none
+          group += "usemtl " + (known ? scene.materials[mesh.material_id].name : std::string()) + "\n";
+          material = mesh.material_id;
+        }
+        text(group);
+
+        const size_t count = mesh.vertices.size();
+        for (int kind = Block::POSITION; kind <= Block::NORMAL; kind++) {
+          if ((kind == Block::TEXCOORD && !block.uv) || (kind == Block::NORMAL && !block.normal)) continue;
+          for (size_t begin = 0; begin < count; begin += chunk_size) {
+            block.kind = static_cast<Block::Kind>(kind);
+            block.begin = begin;
+            block.end = std::min(count, begin + chunk_size);
+            plan.emplace_back(block);
+          }
+        }
+        const size_t triangles = index_count / 3;
+        for (size_t begin = 0; begin < triangles; begin += chunk_size) {
+          block.kind = Block::FACE;
+          block.begin = begin;
+          block.end = std::min(triangles, begin + chunk_size);
+          plan.emplace_back(block);
+        }
+        v_base += count;
+        if (block.uv) vt_base += count;
+        if (block.normal) vn_base += count;
+      }
+
+      if (blocks.size() < plan.size()) blocks.resize(plan.size());
+      auto format = [&](size_t i) {
+        const Block& block = plan[i];
+        std::vector<char>& out = blocks[i];
+        if (block.kind == Block::TEXT) {
+          out.assign(texts[block.mesh].begin(), texts[block.mesh].end());
+          return;
+        }
+        const Mesh& mesh = scene.meshes[block.mesh];
+        const size_t n = block.end - block.begin;
+        switch (block.kind) {
+          case Block::POSITION: {
+            write_detail::LineWriter w(out, n * (2 + 3 * 24 + 1));
+            for (size_t k = block.begin; k < block.end; k++) {
+              const vec3& p = mesh.vertices[k].position;
+              w.text("v ", 2); w.real(p.x); w.put(' '); w.real(p.y); w.put(' '); w.real(p.z); w.put('\n');
+            }
+            break;
+          }
+          case Block::TEXCOORD: {
+            write_detail::LineWriter w(out, n * (3 + 2 * 24 + 1));
+            for (size_t k = block.begin; k < block.end; k++) {
+              const vec2& t = mesh.vertices[k].texcoord;
+              w.text("vt ", 3); w.real(t.x); w.put(' '); w.real(t.y); w.put('\n');
+            }
+            break;
+          }
+          case Block::NORMAL: {
+            write_detail::LineWriter w(out, n * (3 + 3 * 24 + 1));
+            for (size_t k = block.begin; k < block.end; k++) {
+              const vec3& nv = mesh.vertices[k].normal;
+              w.text("vn ", 3); w.real(nv.x); w.put(' '); w.real(nv.y); w.put(' '); w.real(nv.z); w.put('\n');
+            }
+            break;
+          }
+          default: {
+            write_detail::LineWriter w(out, n * (1 + 3 * (1 + 3 * 21)) + n);
+            for (size_t t = block.begin; t < block.end; t++) {
+              w.put('f');
+              for (size_t c = 0; c < 3; c++) {
+                const uint64_t idx = write_detail::indexAt(mesh, t * 3 + c);
+                w.put(' ');
+                w.index(block.v_base + idx);
+                if (block.uv || block.normal) {
+                  w.put('/');
+                  if (block.uv) w.index(block.vt_base + idx);
+                  if (block.normal) {
+                    w.put('/');
+                    w.index(block.vn_base + idx);
+                  }
+                }
+              }
+              w.put('\n');
+            }
+            break;
+          }
+        }
+      };
+      if (pool) pool->parallel_for(plan.size(), format);
+      else for (size_t i = 0; i < plan.size(); i++) format(i);
+
+      if (!write_detail::writeBlocks(path, blocks, plan.size(), pool)) {
+        return false;
+      }
+      bytes = mtl_bytes;
+      for (size_t i = 0; i < plan.size(); i++) bytes += blocks[i].size();
+      return true;
+    }
+
+    // mtl library with every field parseMtl reads; texture names are written as stored
+    bool writeMaterials(const std::vector<Material>& materials, const std::string& path) {
+      std::string out = "# written by obj_loader\n";
+      for (const Material& m : materials) {
+        out += "\nnewmtl " + m.name + "\n";
+        write_detail::appendReal3(out, "Ka", m.ambient);
+        write_detail::appendReal3(out, "Kd", m.diffuse);
+        write_detail::appendReal3(out, "Ks", m.specular);
+        write_detail::appendReal3(out, "Tf", m.transmittance);
+        write_detail::appendReal3(out, "Ke", m.emission);
+        out += "Ns ";
+        write_detail::appendReal(out, m.shininess);
+        out += "\nNi ";
+        write_detail::appendReal(out, m.ior);
+        out += "\nd ";
+        write_detail::appendReal(out, m.dissolve);
+        out += "\nillum " + std::to_string(m.illum) + "\n";
+        // fixed order, the map itself iterates in hash order
+        for (int t = static_cast<int>(TextureType::AMBIENT); t <= static_cast<int>(TextureType::REFLECTION); t++) {
+          auto it = m.texture_map.find(static_cast<TextureType>(t));
+          if (it == m.texture_map.end()) continue;
+          appendTexture(out, write_detail::textureKeyword(it->first), it->second);
+        }
+      }
+
+      if (blocks.empty()) blocks.resize(1);
+      blocks[0].assign(out.begin(), out.end());
+      if (!write_detail::writeBlocks(path, blocks, 1, nullptr)) {
+        return false;
+      }
+      bytes = out.size();
+      return true;
+    }
+
+    // bytes of the files written by the last call (obj and mtl)
+    size_t bytes_written() const { return bytes; }
+
+  private:
+    static void appendTexture(std::string& out, const char* keyword, const Texture& tex) {
+      const TextureOption& o = tex.option;
+      const TextureOption defaults;
+      out += keyword;
+      if (o.clamp != defaults.clamp) out += o.clamp ? " -clamp on" : " -clamp off";
+      if (o.blendu != defaults.blendu) out += o.blendu ? " -blendu on" : " -blendu off";
+      if (o.blendv != defaults.blendv) out += o.blendv ? " -blendv on" : " -blendv off";
+      if (o.bump_multiplier != defaults.bump_multiplier) {
+        out += " -bm ";
+        write_detail::appendReal(out, o.bump_multiplier);
+      }
+      if (o.sharpness != defaults.sharpness) {
+        out += " -boost ";
+        write_detail::appendReal(out, o.sharpness);
+      }
+      if (o.brightness != defaults.brightness || o.contrast != defaults.contrast) {
+        out += " -mm ";
+        write_detail::appendReal(out, o.brightness);
+        out += ' ';
+        write_detail::appendReal(out, o.contrast);
+      }
+      const struct { const char* flag; vec3 value, base; } triples[] = {
+        {" -o ", o.origin_offset, defaults.origin_offset}, {" -s ", o.scale, defaults.scale}, {" -t ", o.turbulence, defaults.turbulence}};
+      for (const auto& t : triples) {
+        if (t.value.x == t.base.x && t.value.y == t.base.y && t.value.z == t.base.z) continue;
+        out += t.flag;
+        write_detail::appendReal(out, t.value.x);
+        out += ' ';
+        write_detail::appendReal(out, t.value.y);
+        out += ' ';
+        write_detail::appendReal(out, t.value.z);
+      }
+      if (o.imfchan != defaults.imfchan) {
+        out += " -imfchan ";
+        out += o.imfchan;
+      }
+      if (const char* face = write_detail::textureFaceName(o.face_type)) {
+        out += " -type ";
+        out += face;
+      }
+      out += ' ';
+      out += tex.name;
+      out += '\n';
+    }
+
+    ThreadPool* pool;
+    size_t chunk_size; // vertices or triangles per formatted block
+    std::vector<std::vector<char>> blocks;
+    size_t bytes;
+  };
+
+  // one shot ObjWriter::write, see there
+  inline bool writeObj(const Scene& scene, const std::string& path, ThreadPool* pool = nullptr) {
+    ObjWriter writer(pool);
+    return writer.write(scene, path);
+  }
+}
+
+#endif //MODEL_LOAD_OBJ_WRITER_H
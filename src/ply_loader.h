@@ -0,0 +1,360 @@
+#ifndef MODEL_LOAD_PLY_LOADER_H
+#define MODEL_LOAD_PLY_LOADER_H
+
+#include <cstdint>
+#include "obj_loader.h"
+#include "mapped_file.h"
+
+namespace obj_loader {
+  namespace ply_detail {
+    enum class PlyType { INVALID, INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64 };
+
+    enum class PlyFormat { ASCII, BINARY_LE, BINARY_BE };
+
+    struct PlyProperty {
+      PlyProperty() : name(), type(PlyType::INVALID), count_type(PlyType::INVALID), is_list(false) {}
+      std::string name;
+      PlyType type; // element type for lists
+      PlyType count_type;
+      bool is_list;
+    };
+
+    struct PlyElement {
+      PlyElement() : name(), count(0), properties() {}
+      std::string name;
+      size_t count;
+      std::vector<PlyProperty> properties;
+    };
+
+    inline size_t typeSize(PlyType t) {
+      switch (t) {
+        case PlyType::INT8: case PlyType::UINT8: return 1;
+        case PlyType::INT16: case PlyType::UINT16: return 2;
+        case PlyType::INT32: case PlyType::UINT32: case PlyType::FLOAT32: return 4;
+        case PlyType::FLOAT64: return 8;
+        default: return 0;
+      }
+    }
+
+    inline PlyType parseType(const std::string& s) {
+      if (s == "char" || s == "int8") return PlyType::INT8;
+      if (s == "uchar" || s == "uint8") return PlyType::UINT8;
+      if (s == "short" || s == "int16") return PlyType::INT16;
+      if (s == "ushort" || s == "uint16") return PlyType::UINT16;
+      if (s == "int" || s == "int32") return PlyType::INT32;
+      if (s == "uint" || s == "uint32") return PlyType::UINT32;
+      if (s == "float" || s == "float32") return PlyType::FLOAT32;
+      if (s == "double" || s == "float64") return PlyType::FLOAT64;
+      return PlyType::INVALID;
+    }
+
+    inline bool parseHeader(const char* data, size_t size, PlyFormat& format, std::vector<PlyElement>& elements, size_t& header_end) {
+      const char* end_marker = "end_header";
+      const char* p = data;
+      const char* end = data + size;
+      bool has_format = false;
+      std::string line;
+
+      while (p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol) {
+          return false;
+        }
+        line.assign(p, eol);
+        p = eol + 1;
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+          line.erase(line.size() - 1);
+        }
+
+        std::istringstream ss(line);
+        std::string keyword;
+        ss >> keyword;
+        if (keyword == "ply" || keyword == "comment" || keyword == "obj_info" || keyword.empty()) {
+          continue;
+        }
+        if (keyword == "format") {
+          std::string name;
+          ss >> name;
+          if (name == "ascii") format = PlyFormat::ASCII;
+          else if (name == "binary_little_endian") format = PlyFormat::BINARY_LE;
+          else if (name == "binary_big_endian") format = PlyFormat::BINARY_BE;
+          else return false;
+          has_format = true;
+        } else if (keyword == "element") {
+          PlyElement element;
+          ss >> element.name >> element.count;
+          elements.emplace_back(element);
+        } else if (keyword == "property") {
+          if (elements.empty()) {
+            return false;
+          }
+          PlyProperty prop;
+          std::string type;
+          ss >> type;
+          if (type == "list") {
+            std::string count_type, item_type;
+            ss >> count_type >> item_type;
+            prop.is_list = true;
+            prop.count_type = parseType(count_type);
+            prop.type = parseType(item_type);
+            if (prop.count_type == PlyType::INVALID) {
+              return false;
+            }
+          } else {
+            prop.type = parseType(type);
+          }
+          if (prop.type == PlyType::INVALID) {
+            return false;
+          }
+          ss >> prop.name;
+          elements.back().properties.emplace_back(prop);
+        } else if (keyword == end_marker) {
+          header_end = static_cast<size_t>(p - data);
+          return has_format;
+        }
+      }
+
+      return false;
+    }
+
+    inline double readBinary(const char* p, PlyType t, bool swap) {
+      unsigned char b[8];
+      size_t n = typeSize(t);
+      memcpy(b, p, n);
+      if (swap) {
+        std::reverse(b, b + n);
+      }
+      switch (t) {
+        case PlyType::INT8: { int8_t v; memcpy(&v, b, 1); return v; }
+        case PlyType::UINT8: { uint8_t v; memcpy(&v, b, 1); return v; }
+        case PlyType::INT16: { int16_t v; memcpy(&v, b, 2); return v; }
+        case PlyType::UINT16: { uint16_t v; memcpy(&v, b, 2); return v; }
+        case PlyType::INT32: { int32_t v; memcpy(&v, b, 4); return v; }
+        case PlyType::UINT32: { uint32_t v; memcpy(&v, b, 4); return v; }
+        case PlyType::FLOAT32: { float v; memcpy(&v, b, 4); return v; }
+        case PlyType::FLOAT64: { double v; memcpy(&v, b, 8); return v; }
+        default: return 0.0;
+      }
+    }
+
+    // whitespace separated numbers over a buffer that is not null terminated
+    struct AsciiCursor {
+      const char* p;
+      const char* end;
+
+      bool next(double& value) {
+        while (p < end && (is_space(*p) || *p == '\r' || *p == '\n')) p++;
+        const char* start = p;
+        while (p < end && !is_space(*p) && *p != '\r' && *p != '\n') p++;
+        size_t len = static_cast<size_t>(p - start);
+        if (len == 0 || len >= 64) {
+          return false;
+        }
+        char buf[64];
+        memcpy(buf, start, len);
+        buf[len] = '\0';
+        value = atof(buf);
+        return true;
+      }
+    };
+
+    // slot of a vertex property: x y z nx ny nz u v, -1 when unused
+    inline int attributeSlot(const std::string& name) {
+      if (name == "x") return 0;
+      if (name == "y") return 1;
+      if (name == "z") return 2;
+      if (name == "nx") return 3;
+      if (name == "ny") return 4;
+      if (name == "nz") return 5;
+      if (name == "s" || name == "u" || name == "texture_u" || name == "texture_s") return 6;
+      if (name == "t" || name == "v" || name == "texture_v" || name == "texture_t") return 7;
+      return -1;
+    }
+
+    inline void storeAttribute(Vertex& v, int slot, float value) {
+      switch (slot) {
+        case 0: v.position.x = value; break;
+        case 1: v.position.y = value; break;
+        case 2: v.position.z = value; break;
+        case 3: v.normal.x = value; break;
+        case 4: v.normal.y = value; break;
+        case 5: v.normal.z = value; break;
+        case 6: v.texcoord.x = value; break;
+        case 7: v.texcoord.y = value; break;
+        default: break;
+      }
+    }
+
+    // fan triangulation of one polygon into mesh.indices
+    inline void emitPolygon(Mesh& mesh, const unsigned int* poly, size_t n, size_t vertex_count, bool& valid) {
+      for (size_t k = 0; k < n; k++) {
+        if (poly[k] >= vertex_count) {
+          valid = false;
+          return;
+        }
+      }
+      for (size_t k = 2; k < n; k++) {
+        mesh.indices.push_back(poly[0]);
+        mesh.indices.push_back(poly[k - 1]);
+        mesh.indices.push_back(poly[k]);
+      }
+    }
+  }
+
+  // NOTE: reads the "vertex" element (position, normal, texcoord) and the first list property of "face".
+  // polygons are fan triangulated, so the mesh is always an indexed triangle list.
+  bool loadPly(const std::string& path, Scene& scene, ParseOption parse_option) {
+    using namespace ply_detail;
+    MappedFile file(path);
+    if (!file.is_open() || file.size() < 3 || 0 != strncmp(file.data(), "ply", 3)) {
+      return false;
+    }
+
+    PlyFormat format = PlyFormat::ASCII;
+    std::vector<PlyElement> elements;
+    size_t header_end = 0;
+    if (!parseHeader(file.data(), file.size(), format, elements, header_end)) {
+      return false;
+    }
+
+    std::pair<std::string, std::string> pair = splitDelims(path, "\\/");
+    scene.base_dir = pair.first;
+    Mesh mesh;
+    mesh.name = pair.second;
+
+    const char* p = file.data() + header_end;
+    const char* end = file.data() + file.size();
+    const bool swap = format == PlyFormat::BINARY_BE;
+    std::vector<unsigned int> poly;
+    bool valid = true;
+
+    for (const PlyElement& element : elements) {
+      bool is_vertex = element.name == "vertex";
+      bool is_face = element.name == "face";
+      std::vector<int> slots(element.properties.size(), -1);
+      size_t index_list = element.properties.size(); // first list property of a face
+      size_t stride = 0;
+      size_t min_record = 0; // smallest possible record, a list counts as an empty one
+      bool fixed = true;
+      bool all_float = true;
+      for (size_t i = 0; i < element.properties.size(); i++) {
+        const PlyProperty& prop = element.properties[i];
+        if (is_vertex && !prop.is_list) slots[i] = attributeSlot(prop.name);
+        if (is_face && prop.is_list && index_list == element.properties.size()) index_list = i;
+        fixed = fixed && !prop.is_list;
+        all_float = all_float && prop.type == PlyType::FLOAT32;
+        stride += typeSize(prop.type);
+        min_record += prop.is_list ? typeSize(prop.count_type) : typeSize(prop.type);
+      }
+      // the header count is untrusted, check it against the bytes left before allocating.
+      // an ascii value needs at least one digit and one separator (the last one may end the file)
+      if (!element.properties.empty()) {
+        size_t remaining = static_cast<size_t>(end - p);
+        size_t max_count = format == PlyFormat::ASCII ? (remaining + 1) / (2 * element.properties.size()) : remaining / min_record;
+        if (element.count > max_count) {
+          return false;
+        }
+      }
+      if (is_vertex) {
+        mesh.vertices.resize(element.count);
+      }
+      if (is_face) {
+        mesh.indices.reserve(element.count * 3);
+      }
+
+      if (format != PlyFormat::ASCII) {
+        if (fixed && !is_vertex) {
+          // skip unknown fixed size element in one step
+          if (static_cast<size_t>(end - p) < stride * element.count) return false;
+          p += stride * element.count;
+          continue;
+        }
+
+        if (is_vertex && fixed && all_float && !swap) {
+          // bulk path: little endian float records at fixed offsets
+          if (static_cast<size_t>(end - p) < stride * element.count) return false;
+          for (size_t v = 0; v < element.count; v++, p += stride) {
+            Vertex& vtx = mesh.vertices[v];
+            for (size_t i = 0; i < slots.size(); i++) {
+              if (slots[i] < 0) continue;
+              float value;
+              memcpy(&value, p + i * 4, 4);
+              storeAttribute(vtx, slots[i], value);
+            }
+          }
+          continue;
+        }
+
+        for (size_t r = 0; r < element.count; r++) {
+          for (size_t i = 0; i < element.properties.size(); i++) {
+            const PlyProperty& prop = element.properties[i];
+            if (!prop.is_list) {
+              size_t n = typeSize(prop.type);
+              if (static_cast<size_t>(end - p) < n) return false;
+              if (slots[i] >= 0) storeAttribute(mesh.vertices[r], slots[i], static_cast<float>(readBinary(p, prop.type, swap)));
+              p += n;
+              continue;
+            }
+            size_t count_size = typeSize(prop.count_type);
+            if (static_cast<size_t>(end - p) < count_size) return false;
+            size_t n = static_cast<size_t>(readBinary(p, prop.count_type, swap));
+            p += count_size;
+            size_t item_size = typeSize(prop.type);
+            if (static_cast<size_t>(end - p) < n * item_size) return false;
+            if (is_face && i == index_list) {
+              poly.resize(n);
+              if (prop.type == PlyType::INT32 || prop.type == PlyType::UINT32) {
+                memcpy(poly.data(), p, n * 4);
+                if (swap) {
+                  for (unsigned int& idx : poly) idx = (idx >> 24) | ((idx >> 8) & 0xff00) | ((idx << 8) & 0xff0000) | (idx << 24);
+                }
+              } else {
+                for (size_t k = 0; k < n; k++) poly[k] = static_cast<unsigned int>(readBinary(p + k * item_size, prop.type, swap));
+              }
+              emitPolygon(mesh, poly.data(), n, mesh.vertices.size(), valid);
+            }
+            p += n * item_size;
+          }
+        }
+      } else {
+        AsciiCursor cursor = {p, end};
+        for (size_t r = 0; r < element.count; r++) {
+          for (size_t i = 0; i < element.properties.size(); i++) {
+            const PlyProperty& prop = element.properties[i];
+            double value;
+            if (!cursor.next(value)) return false;
+            if (!prop.is_list) {
+              if (slots[i] >= 0) storeAttribute(mesh.vertices[r], slots[i], static_cast<float>(value));
+              continue;
+            }
+            size_t n = static_cast<size_t>(value);
+            poly.resize(n);
+            for (size_t k = 0; k < n; k++) {
+              if (!cursor.next(value)) return false;
+              poly[k] = static_cast<unsigned int>(value);
+            }
+            if (is_face && i == index_list) {
+              emitPolygon(mesh, poly.data(), n, mesh.vertices.size(), valid);
+            }
+          }
+        }
+        p = cursor.p;
+      }
+      if (!valid) {
+        return false;
+      }
+    }
+
+    for (Vertex& v : mesh.vertices) {
+      if (parse_option & ParseOption::FLIP_UV) {
+        v.texcoord.y = 1.f - v.texcoord.y;
+      }
+      mesh.bounds.expand(v.position);
+    }
+    scene.bounds.merge(mesh.bounds);
+    scene.meshes.emplace_back(std::move(mesh));
+    return true;
+  }
+}
+
+#endif //MODEL_LOAD_PLY_LOADER_H
@@ -0,0 +1,57 @@
+#ifndef MODEL_LOAD_STL_LOADER_H
+#define MODEL_LOAD_STL_LOADER_H
+
+#include <cstdint>
+#include "obj_loader.h"
+#include "mapped_file.h"
+
+namespace obj_loader {
+  // NOTE: binary stl only. every facet gets its own three vertices carrying the facet normal.
+  bool loadStl(const std::string& path, Scene& scene, ParseOption parse_option) {
+    const size_t header_size = 80 + 4;
+    const size_t record_size = 50; // normal, 3 positions, uint16 attribute
+
+    MappedFile file(path);
+    if (!file.is_open() || file.size() < header_size) {
+      return false;
+    }
+
+    uint32_t count;
+    memcpy(&count, file.data() + 80, sizeof(count));
+    // an ascii file ("solid ...") will not match the record size exactly
+    if (file.size() != header_size + static_cast<size_t>(count) * record_size) {
+      return false;
+    }
+
+    std::pair<std::string, std::string> pair = splitDelims(path, "\\/");
+    scene.base_dir = pair.first;
+
+    Mesh mesh;
+    mesh.name = pair.second;
+    mesh.vertices.resize(static_cast<size_t>(count) * 3);
+    mesh.indices.resize(static_cast<size_t>(count) * 3);
+
+    const char* record = file.data() + header_size;
+    Vertex* out = mesh.vertices.data();
+    for (uint32_t i = 0; i < count; i++, record += record_size, out += 3) {
+      float f[12];
+      memcpy(f, record, sizeof(f));
+      vec3 normal(f[0], f[1], f[2]);
+      for (int k = 0; k < 3; k++) {
+        out[k].position = vec3(f[3 + k * 3], f[4 + k * 3], f[5 + k * 3]);
+        out[k].normal = normal;
+        mesh.bounds.expand(out[k].position);
+      }
+    }
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+      mesh.indices[i] = static_cast<unsigned int>(i);
+    }
+    (void)parse_option; // stl has no texcoords to flip nor tangent space to build
+
+    scene.bounds.merge(mesh.bounds);
+    scene.meshes.emplace_back(std::move(mesh));
+    return true;
+  }
+}
+
+#endif //MODEL_LOAD_STL_LOADER_H
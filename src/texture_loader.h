@@ -0,0 +1,480 @@
+#ifndef MODEL_LOAD_TEXTURE_LOADER_H
+#define MODEL_LOAD_TEXTURE_LOADER_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "batch_reader.h"
+#include "obj_loader.h"
+#include "thread_pool.h"
+#include "trace.h"
+#ifdef OBJ_LOADER_PNG
+#include <png.h>
+#endif
+#ifdef OBJ_LOADER_JPEG
+#include <csetjmp>
+#include <jpeglib.h>
+#endif
+
+namespace obj_loader {
+  enum class ImageFormat {
+    UNKNOWN,
+    PNG,  // needs OBJ_LOADER_PNG
+    JPEG, // needs OBJ_LOADER_JPEG
+    TGA,  // always built in: uncompressed and rle, 8/16/24/32 bit
+  };
+
+  // by signature, tga has none so it goes by extension. officebot ships png data named .tga.png.
+  inline ImageFormat imageFormatOf(const unsigned char* data, size_t size, const std::string& path) {
+    static const unsigned char png_signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (size >= 8 && 0 == memcmp(data, png_signature, 8)) return ImageFormat::PNG;
+    if (size >= 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff) return ImageFormat::JPEG;
+    if (path.size() >= 4) {
+      std::string ext = path.substr(path.size() - 4);
+      for (char& c : ext) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+      if (ext == ".tga") return ImageFormat::TGA;
+    }
+    return ImageFormat::UNKNOWN;
+  }
+
+  // one level of a mip chain inside Image::pixels
+  struct MipLevel {
+    MipLevel() : width(0), height(0), offset(0) {}
+    uint32_t width, height;
+    size_t offset; // bytes from the start of Image::pixels
+  };
+
+  // a decoded texture, always 8 bit rgba with the first row at the top. levels[0] is the image itself,
+  // generateMips appends the halved levels down to 1x1 behind it in the same buffer.
+  struct Image {
+    Image() : path(), width(0), height(0), pixels(), levels() {}
+    bool empty() const { return levels.empty(); }
+    const unsigned char* level(size_t i) const { return pixels.data() + levels[i].offset; }
+    std::string path;
+    uint32_t width, height;
+    std::vector<unsigned char> pixels;
+    std::vector<MipLevel> levels;
+  };
+
+  namespace image_detail {
+    inline void allocate(Image& image, uint32_t width, uint32_t height) {
+      image.width = width;
+      image.height = height;
+      image.pixels.assign(static_cast<size_t>(width) * height * 4, 0);
+      image.levels.assign(1, MipLevel());
+      image.levels[0].width = width;
+      image.levels[0].height = height;
+    }
+
+#ifdef OBJ_LOADER_PNG
+    inline bool decodePng(const unsigned char* data, size_t size, Image& image) {
+      png_image png;
+      memset(&png, 0, sizeof(png));
+      png.version = PNG_IMAGE_VERSION;
+      if (!png_image_begin_read_from_memory(&png, data, size)) {
+        return false;
+      }
+      png.format = PNG_FORMAT_RGBA;
+      allocate(image, png.width, png.height);
+      if (!png_image_finish_read(&png, nullptr, image.pixels.data(), 0, nullptr)) {
+        png_image_free(&png);
+        return false;
+      }
+      return true;
+    }
+#endif
+
+#ifdef OBJ_LOADER_JPEG
+    // libjpeg reports errors through error_exit, which must not return
+    struct JpegError {
+      jpeg_error_mgr base;
+      jmp_buf jump;
+    };
+
+    inline void jpegErrorExit(j_common_ptr info) {
+      longjmp(reinterpret_cast<JpegError*>(info->err)->jump, 1);
+    }
+
+    inline bool decodeJpeg(const unsigned char* data, size_t size, Image& image) {
+      jpeg_decompress_struct info;
+      JpegError error;
+      info.err = jpeg_std_error(&error.base);
+      error.base.error_exit = jpegErrorExit;
+      std::vector<unsigned char> row;
+      if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&info);
+        return false;
+      }
+      jpeg_create_decompress(&info);
+      jpeg_mem_src(&info, const_cast<unsigned char*>(data), static_cast<unsigned long>(size));
+      jpeg_read_header(&info, TRUE);
+      info.out_color_space = info.jpeg_color_space == JCS_GRAYSCALE ? JCS_GRAYSCALE : JCS_RGB;
+      jpeg_start_decompress(&info);
+      allocate(image, info.output_width, info.output_height);
+      const int components = info.output_components;
+      row.resize(static_cast<size_t>(info.output_width) * components);
+      while (info.output_scanline < info.output_height) {
+        unsigned char* dst = image.pixels.data() + static_cast<size_t>(info.output_scanline) * info.output_width * 4;
+        JSAMPROW rows[1] = {row.data()};
+        jpeg_read_scanlines(&info, rows, 1);
+        for (size_t x = 0; x < info.output_width; x++, dst += 4) {
+          const unsigned char* src = row.data() + x * components;
+          dst[0] = src[0];
+          dst[1] = components >= 3 ? src[1] : src[0];
+          dst[2] = components >= 3 ? src[2] : src[0];
+          dst[3] = 255;
+        }
+      }
+      jpeg_finish_decompress(&info);
+      jpeg_destroy_decompress(&info);
+      return true;
+    }
+#endif
+
+    // bgr(a) pixel of a tga to rgba
+    inline void tgaPixel(const unsigned char* src, unsigned int bytes, unsigned char* dst) {
+      switch (bytes) {
+        case 1:
+          dst[0] = dst[1] = dst[2] = src[0];
+          dst[3] = 255;
+          break;
+        case 2: {
+          unsigned int v = src[0] | (src[1] << 8); // a1 r5 g5 b5
+          dst[0] = static_cast<unsigned char>(((v >> 10) & 31) * 255 / 31);
+          dst[1] = static_cast<unsigned char>(((v >> 5) & 31) * 255 / 31);
+          dst[2] = static_cast<unsigned char>((v & 31) * 255 / 31);
+          dst[3] = 255;
+          break;
+        }
+        default:
+          dst[0] = src[2];
+          dst[1] = src[1];
+          dst[2] = src[0];
+          dst[3] = bytes == 4 ? src[3] : 255;
+          break;
+      }
+    }
+
+    inline bool decodeTga(const unsigned char* data, size_t size, Image& image) {
+      if (size < 18) {
+        return false;
+      }
+      const unsigned int type = data[2];
+      const bool rle = type == 10 || type == 11;
+      const bool gray = type == 3 || type == 11;
+      if (type != 2 && type != 3 && !rle) {
+        return false; // color mapped images are not supported
+      }
+      const uint32_t width = data[12] | (data[13] << 8);
+      const uint32_t height = data[14] | (data[15] << 8);
+      const unsigned int bpp = data[16];
+      const unsigned int bytes = bpp / 8;
+      if (width == 0 || height == 0 || (gray ? bpp != 8 : (bpp != 16 && bpp != 24 && bpp != 32))) {
+        return false;
+      }
+      const bool top_down = data[17] & 0x20;
+      const size_t colormap = data[1] ? static_cast<size_t>(data[5] | (data[6] << 8)) * ((data[7] + 7) / 8) : 0;
+      size_t pos = 18 + data[0] + colormap;
+
+      allocate(image, width, height);
+      const size_t count = static_cast<size_t>(width) * height;
+      size_t i = 0;
+      while (i < count) {
+        size_t run = 1;
+        bool repeat = false;
+        if (rle) {
+          if (pos >= size) return false;
+          const unsigned char header = data[pos++];
+          run = (header & 0x7f) + 1u;
+          repeat = header & 0x80;
+        }
+        if (pos + (repeat ? 1 : run) * bytes > size) return false;
+        for (size_t k = 0; k < run && i < count; k++, i++) {
+          size_t x = i % width, y = i / width;
+          if (!top_down) y = height - 1 - y;
+          tgaPixel(data + pos, bytes, image.pixels.data() + (y * width + x) * 4);
+          if (!repeat) pos += bytes;
+        }
+        if (repeat) pos += bytes;
+      }
+      return true;
+    }
+
+    inline uint64_t fnv1a(const void* data, size_t size, uint64_t h = 14695981039346656037ull) {
+      const unsigned char* p = static_cast<const unsigned char*>(data);
+      for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+      }
+      return h;
+    }
+  }
+
+  // decodes an encoded image held in memory into image.levels[0]. path only picks the format when the
+  // data has no signature. false for unknown formats and ones the build has no decoder for.
+  inline bool decodeImage(const unsigned char* data, size_t size, const std::string& path, Image& image) {
+    image = Image();
+    image.path = path;
+    switch (imageFormatOf(data, size, path)) {
+#ifdef OBJ_LOADER_PNG
+      case ImageFormat::PNG: return image_detail::decodePng(data, size, image);
+#endif
+#ifdef OBJ_LOADER_JPEG
+      case ImageFormat::JPEG: return image_detail::decodeJpeg(data, size, image);
+#endif
+      case ImageFormat::TGA: return image_detail::decodeTga(data, size, image);
+      default: return false;
+    }
+  }
+
+  // box filtered mip chain behind levels[0]. an odd edge repeats its last texel, values are averaged
+  // as stored (no srgb conversion).
+  inline void generateMips(Image& image) {
+    if (image.empty()) {
+      return;
+    }
+    image.levels.resize(1);
+    size_t total = image.pixels.size();
+    for (uint32_t w = image.width, h = image.height; w > 1 || h > 1;) {
+      w = std::max(w / 2, 1u);
+      h = std::max(h / 2, 1u);
+      total += static_cast<size_t>(w) * h * 4;
+    }
+    image.pixels.resize(total);
+
+    while (image.levels.back().width > 1 || image.levels.back().height > 1) {
+      const MipLevel src = image.levels.back();
+      MipLevel dst;
+      dst.width = std::max(src.width / 2, 1u);
+      dst.height = std::max(src.height / 2, 1u);
+      dst.offset = src.offset + static_cast<size_t>(src.width) * src.height * 4;
+      const unsigned char* in = image.pixels.data() + src.offset;
+      unsigned char* out = image.pixels.data() + dst.offset;
+      for (uint32_t y = 0; y < dst.height; y++) {
+        const unsigned char* row0 = in + static_cast<size_t>(std::min(2 * y, src.height - 1)) * src.width * 4;
+        const unsigned char* row1 = in + static_cast<size_t>(std::min(2 * y + 1, src.height - 1)) * src.width * 4;
+        for (uint32_t x = 0; x < dst.width; x++) {
+          const size_t x0 = static_cast<size_t>(std::min(2 * x, src.width - 1)) * 4;
+          const size_t x1 = static_cast<size_t>(std::min(2 * x + 1, src.width - 1)) * 4;
+          for (int c = 0; c < 4; c++) {
+            out[c] = static_cast<unsigned char>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+          }
+          out += 4;
+        }
+      }
+      image.levels.push_back(dst);
+    }
+  }
+
+  // Decoded textures (with their mips) stored under a directory, one file per source image. An entry is
+  // keyed by the source path and only used while the source still has the size and mtime (to the nanosecond where
+  // the platform has it) it was decoded from.
+  // Entries are written to a temporary name and renamed, so concurrent loads never read a partial file.
+  class TextureDiskCache {
+  public:
+    explicit TextureDiskCache(const std::string& dir) : dir(dir.empty() || dir.back() == '/' ? dir : dir + "/") {}
+
+    bool load(const std::string& source, Image& image) const {
+      Header expected;
+      if (!describe(source, expected)) {
+        return false;
+      }
+      FILE* fp = fopen(entryPath(source).c_str(), "rb");
+      if (!fp) {
+        return false;
+      }
+      Header header;
+      bool ok = fread(&header, sizeof(header), 1, fp) == 1 && 0 == memcmp(header.magic, expected.magic, 4) &&
+                header.version == expected.version && header.source_size == expected.source_size &&
+                header.source_mtime == expected.source_mtime && header.source_mtime_nsec == expected.source_mtime_nsec &&
+                header.path_hash == expected.path_hash && header.level_count > 0;
+      if (ok) {
+        image = Image();
+        image.path = source;
+        image.width = header.width;
+        image.height = header.height;
+        image.levels.resize(header.level_count);
+        image.pixels.resize(static_cast<size_t>(header.pixel_bytes));
+        for (MipLevel& level : image.levels) {
+          uint64_t fields[3] = {0, 0, 0};
+          ok = ok && fread(fields, sizeof(fields), 1, fp) == 1;
+          level.width = static_cast<uint32_t>(fields[0]);
+          level.height = static_cast<uint32_t>(fields[1]);
+          level.offset = static_cast<size_t>(fields[2]);
+          ok = ok && level.offset + static_cast<size_t>(level.width) * level.height * 4 <= image.pixels.size();
+        }
+        ok = ok && fread(image.pixels.data(), 1, image.pixels.size(), fp) == image.pixels.size();
+      }
+      fclose(fp);
+      if (!ok) {
+        image = Image();
+      }
+      return ok;
+    }
+
+    bool store(const std::string& source, const Image& image) const {
+      Header header;
+      if (image.empty() || !describe(source, header)) {
+        return false;
+      }
+      header.width = image.width;
+      header.height = image.height;
+      header.level_count = static_cast<uint32_t>(image.levels.size());
+      header.pixel_bytes = image.pixels.size();
+
+      const std::string path = entryPath(source);
+      // unique across the processes and threads sharing the directory
+      const std::string temp = path + ".tmp" + std::to_string(static_cast<long>(getpid())) + "_" + std::to_string(reinterpret_cast<uintptr_t>(&image));
+      FILE* fp = fopen(temp.c_str(), "wb");
+      if (!fp) {
+        return false;
+      }
+      bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+      for (const MipLevel& level : image.levels) {
+        uint64_t fields[3] = {level.width, level.height, level.offset};
+        ok = ok && fwrite(fields, sizeof(fields), 1, fp) == 1;
+      }
+      ok = ok && fwrite(image.pixels.data(), 1, image.pixels.size(), fp) == image.pixels.size();
+      ok = (fclose(fp) == 0) && ok;
+      ok = ok && std::rename(temp.c_str(), path.c_str()) == 0;
+      if (!ok) {
+        std::remove(temp.c_str());
+      }
+      return ok;
+    }
+
+    // file the entry of source lives in, whether it exists or not
+    std::string entryPath(const std::string& source) const {
+      char name[32];
+      snprintf(name, sizeof(name), "%016llx.tex", static_cast<unsigned long long>(image_detail::fnv1a(source.data(), source.size())));
+      return dir + name;
+    }
+
+  private:
+    struct Header {
+      Header() : version(2), width(0), height(0), level_count(0), source_mtime_nsec(0), path_hash(0), source_size(0), source_mtime(0), pixel_bytes(0) {
+        memcpy(magic, "OLTX", 4);
+      }
+      char magic[4];
+      uint32_t version;
+      uint32_t width, height;
+      uint32_t level_count;
+      uint32_t source_mtime_nsec; // sub second part of the mtime, also keeps the 64 bit fields aligned
+      uint64_t path_hash;
+      uint64_t source_size;
+      int64_t source_mtime;
+      uint64_t pixel_bytes;
+    };
+
+    static bool describe(const std::string& source, Header& header) {
+      struct stat st;
+      if (stat(source.c_str(), &st) != 0) {
+        return false;
+      }
+      header.path_hash = image_detail::fnv1a(source.data(), source.size());
+      header.source_size = static_cast<uint64_t>(st.st_size);
+      header.source_mtime = static_cast<int64_t>(st.st_mtime);
+#if defined(_WIN32)
+      header.source_mtime_nsec = 0;
+#elif defined(__APPLE__)
+      header.source_mtime_nsec = static_cast<uint32_t>(st.st_mtimespec.tv_nsec);
+#else
+      header.source_mtime_nsec = static_cast<uint32_t>(st.st_mtim.tv_nsec);
+#endif
+      return true;
+    }
+
+    std::string dir;
+  };
+
+  struct TextureLoadStats {
+    TextureLoadStats() : decoded(0), cache_hits(0), failed(0), source_bytes(0) {}
+    size_t decoded, cache_hits, failed;
+    size_t source_bytes; // encoded bytes read for the decoded textures
+  };
+
+  // Decodes every path into images[i], each distinct path once; repeated paths get a copy. Textures are
+  // independent jobs on pool when one is given. With a cache, entries that are still valid skip the decode
+  // and freshly decoded textures are stored. A texture that cannot be read or decoded is left empty.
+  inline TextureLoadStats loadTextures(const std::vector<std::string>& paths, std::vector<Image>& images, ThreadPool* pool = nullptr,
+                                       const TextureDiskCache* cache = nullptr, bool mipmaps = true) {
+    OBJ_LOADER_TRACE_SCOPE("textures");
+    images.assign(paths.size(), Image());
+    std::unordered_map<std::string, size_t> first;
+    std::vector<size_t> unique;
+    for (size_t i = 0; i < paths.size(); i++) {
+      if (first.emplace(paths[i], i).second) unique.push_back(i);
+    }
+
+    struct Result {
+      Result() : cached(false), bytes(0) {}
+      bool cached;
+      size_t bytes;
+    };
+    std::vector<Result> results(paths.size());
+    auto decode = [&](size_t i) {
+      OBJ_LOADER_TRACE_SCOPE("decode texture");
+      Image& image = images[i];
+      if (cache && cache->load(paths[i], image)) {
+        const bool complete = image.levels.size() > 1 || (image.width == 1 && image.height == 1);
+        if (!mipmaps) {
+          image.levels.resize(1);
+          image.pixels.resize(static_cast<size_t>(image.width) * image.height * 4);
+        }
+        if (!mipmaps || complete) {
+          results[i].cached = true;
+          return;
+        }
+      }
+      std::vector<char> data;
+      if (!readWholeFile(paths[i], data) ||
+          !decodeImage(reinterpret_cast<const unsigned char*>(data.data()), data.size(), paths[i], image)) {
+        image = Image();
+        return;
+      }
+      results[i].bytes = data.size();
+      if (mipmaps) {
+        generateMips(image);
+      }
+      if (cache) {
+        cache->store(paths[i], image);
+      }
+    };
+
+    if (pool) {
+      // only waits for these textures, so it can run next to other batches or from a pool task
+      pool->parallel_for(unique.size(), [&](size_t k) { decode(unique[k]); });
+    } else {
+      for (size_t i : unique) decode(i);
+    }
+
+    TextureLoadStats stats;
+    for (size_t i : unique) {
+      if (images[i].empty()) stats.failed++;
+      else if (results[i].cached) stats.cache_hits++;
+      else stats.decoded++;
+      stats.source_bytes += results[i].bytes;
+    }
+    for (size_t i = 0; i < paths.size(); i++) {
+      size_t source = first[paths[i]];
+      if (source != i) images[i] = images[source];
+    }
+    return stats;
+  }
+
+  // the textures of a loaded scene, images[i] belongs to scene.textures[i] (Texture::id)
+  inline TextureLoadStats loadTextures(const Scene& scene, std::vector<Image>& images, ThreadPool* pool = nullptr,
+                                       const TextureDiskCache* cache = nullptr, bool mipmaps = true) {
+    return loadTextures(scene.textures, images, pool, cache, mipmaps);
+  }
+}
+
+#endif //MODEL_LOAD_TEXTURE_LOADER_H
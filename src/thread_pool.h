@@ -0,0 +1,137 @@
+#ifndef MODEL_LOAD_THREAD_POOL_H
+#define MODEL_LOAD_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed size worker pool. parallel_for lets the calling thread work too and only waits for its own items,
+// so it may be nested inside a task.
+class ThreadPool {
+public:
+  explicit ThreadPool(unsigned int count = std::thread::hardware_concurrency())
+    : workers(), tasks(), mutex(), cv(), idle_cv(), active(0), stopping(false) {
+    for (unsigned int i = 0; i < count; i++) {
+      workers.emplace_back([this] { run(); });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    cv.notify_all();
+    for (auto& t : workers) {
+      t.join();
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+  void submit(std::function<void()> task) {
+    if (workers.empty()) {
+      task();
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.emplace_back(std::move(task));
+    }
+    cv.notify_one();
+  }
+
+  // blocks until the queue is drained and no task is running
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle_cv.wait(lock, [this] { return tasks.empty() && active == 0; });
+  }
+
+  // calls fn(i) for every i in [0, count)
+  template <typename F>
+  void parallel_for(size_t count, const F& fn) {
+    if (count == 0) {
+      return;
+    }
+    if (workers.empty() || count == 1) {
+      for (size_t i = 0; i < count; i++) fn(i);
+      return;
+    }
+
+    struct State {
+      std::atomic<size_t> next;
+      std::atomic<size_t> done;
+      std::mutex mutex;
+      std::condition_variable cv;
+    };
+    std::shared_ptr<State> state = std::make_shared<State>();
+    state->next = 0;
+    state->done = 0;
+
+    // helpers may start after every item is taken; they then leave without touching fn
+    auto work = [state, count, &fn] {
+      size_t finished = 0;
+      for (size_t i = state->next++; i < count; i = state->next++) {
+        fn(i);
+        finished++;
+      }
+      if (finished && state->done.fetch_add(finished) + finished == count) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->cv.notify_all();
+      }
+    };
+
+    size_t helpers = std::min<size_t>(workers.size(), count - 1);
+    for (size_t i = 0; i < helpers; i++) {
+      submit(work);
+    }
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&state, count] { return state->done.load() == count; });
+  }
+
+private:
+  void run() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (stopping && tasks.empty()) {
+          return;
+        }
+        task = std::move(tasks.front());
+        tasks.pop_front();
+        active++;
+      }
+      task();
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        active--;
+        if (tasks.empty() && active == 0) {
+          idle_cv.notify_all();
+        }
+      }
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::condition_variable idle_cv;
+  unsigned int active;
+  bool stopping;
+};
+
+#endif //MODEL_LOAD_THREAD_POOL_H
@@ -0,0 +1,218 @@
+#ifndef MODEL_LOAD_TRACE_H
+#define MODEL_LOAD_TRACE_H
+
+// scoped timeline events for the loader stages, written as chrome trace json (chrome://tracing, ui.perfetto.dev).
+// only built with OBJ_LOADER_TRACE defined, otherwise OBJ_LOADER_TRACE_SCOPE expands to nothing.
+
+#ifdef OBJ_LOADER_TRACE
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace obj_loader {
+  // name must outlive the trace, scopes only take string literals
+  struct TraceEvent {
+    const char* name;
+    uint64_t begin; // ns since the tracer was created
+    uint64_t end;
+  };
+
+  // events of one thread. only the owning thread appends; blocks are published with a release store
+  // of their count, so the trace can be read while other threads keep recording.
+  class TraceBuffer {
+  public:
+    static const size_t block_size = 4096;
+
+    struct Block {
+      Block() : count(0), next(nullptr) {}
+      TraceEvent events[block_size];
+      std::atomic<size_t> count;
+      std::atomic<Block*> next;
+    };
+
+    explicit TraceBuffer(unsigned int tid) : tid(tid), name(), head(new Block()), tail(head.get()) {}
+
+    ~TraceBuffer() {
+      Block* block = head->next.load();
+      while (block) {
+        Block* next = block->next.load();
+        delete block;
+        block = next;
+      }
+    }
+
+    void append(const char* event, uint64_t begin, uint64_t end) {
+      size_t n = tail->count.load(std::memory_order_relaxed);
+      if (n == block_size) {
+        Block* next = tail->next.load(std::memory_order_relaxed);
+        if (!next) {
+          next = new Block();
+          tail->next.store(next, std::memory_order_release);
+        }
+        tail = next;
+        n = 0;
+      }
+      TraceEvent& e = tail->events[n];
+      e.name = event;
+      e.begin = begin;
+      e.end = end;
+      tail->count.store(n + 1, std::memory_order_release);
+    }
+
+    template <typename F>
+    void visit(const F& fn) const {
+      for (const Block* block = head.get(); block; block = block->next.load(std::memory_order_acquire)) {
+        size_t n = block->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; i++) fn(block->events[i]);
+        if (n < block_size) break;
+      }
+    }
+
+    // keeps the blocks for reuse. the owning thread must not be inside a scope.
+    void clear() {
+      for (Block* block = head.get(); block; block = block->next.load()) block->count.store(0);
+      tail = head.get();
+    }
+
+    const unsigned int tid;
+    std::string name;
+
+  private:
+    std::unique_ptr<Block> head;
+    Block* tail;
+  };
+
+  // process wide event sink. every thread gets its own buffer on its first event, the registry lock is
+  // only taken then and when the trace is written. buffers live as long as the tracer, so events of
+  // pool threads that have already exited are still written.
+  class Tracer {
+  public:
+    static Tracer& instance() {
+      static Tracer tracer;
+      return tracer;
+    }
+
+    // recording starts disabled, a scope then costs one relaxed load
+    void enable(bool on) { active.store(on, std::memory_order_relaxed); }
+    bool enabled() const { return active.load(std::memory_order_relaxed); }
+
+    uint64_t now() const {
+      return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+    }
+
+    void record(const char* name, uint64_t begin, uint64_t end) { local().append(name, begin, end); }
+
+    // label shown for the calling thread in the viewer
+    void nameThread(const std::string& name) {
+      TraceBuffer& buffer = local();
+      std::lock_guard<std::mutex> lock(mutex);
+      buffer.name = name;
+    }
+
+    size_t event_count() const {
+      std::lock_guard<std::mutex> lock(mutex);
+      size_t count = 0;
+      for (const auto& buffer : buffers) buffer->visit([&count](const TraceEvent&) { count++; });
+      return count;
+    }
+
+    // drops every recorded event. no thread may be inside a scope meanwhile.
+    void clear() {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (const auto& buffer : buffers) buffer->clear();
+    }
+
+    // complete ("X") events in microseconds, one metadata event per thread for its name
+    void write(std::ostream& os) const {
+      std::lock_guard<std::mutex> lock(mutex);
+      os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+      bool first = true;
+      char line[256];
+      for (const auto& buffer : buffers) {
+        std::string name = buffer->name.empty() ? "thread " + std::to_string(buffer->tid) : buffer->name;
+        snprintf(line, sizeof(line), "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                 first ? "" : ",", buffer->tid, escape(name).c_str());
+        os << line;
+        first = false;
+        buffer->visit([&](const TraceEvent& e) {
+          snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"obj_loader\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                   e.name, buffer->tid, e.begin / 1000.0, (e.end - e.begin) / 1000.0);
+          os << line;
+        });
+      }
+      os << "\n]}\n";
+    }
+
+    bool write(const std::string& path) const {
+      std::ofstream ofs(path);
+      if (!ofs) {
+        return false;
+      }
+      write(ofs);
+      return static_cast<bool>(ofs);
+    }
+
+  private:
+    Tracer() : epoch(std::chrono::steady_clock::now()), active(false), mutex(), buffers(), next_tid(1) {}
+
+    TraceBuffer& local() {
+      thread_local TraceBuffer* buffer = nullptr;
+      if (!buffer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers.emplace_back(new TraceBuffer(next_tid++));
+        buffer = buffers.back().get();
+      }
+      return *buffer;
+    }
+
+    static std::string escape(const std::string& s) {
+      std::string out;
+      for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) out += c;
+      }
+      return out;
+    }
+
+    const std::chrono::steady_clock::time_point epoch;
+    std::atomic<bool> active;
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    unsigned int next_tid;
+  };
+
+  // records [construction, destruction) under name when the tracer is enabled
+  class TraceScope {
+  public:
+    explicit TraceScope(const char* name) : name(Tracer::instance().enabled() ? name : nullptr), begin(this->name ? Tracer::instance().now() : 0) {}
+    ~TraceScope() {
+      if (name) {
+        Tracer& tracer = Tracer::instance();
+        tracer.record(name, begin, tracer.now());
+      }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+  private:
+    const char* name;
+    uint64_t begin;
+  };
+}
+
+#define OBJ_LOADER_TRACE_CONCAT_(a, b) a##b
+#define OBJ_LOADER_TRACE_CONCAT(a, b) OBJ_LOADER_TRACE_CONCAT_(a, b)
+#define OBJ_LOADER_TRACE_SCOPE(name) ::obj_loader::TraceScope OBJ_LOADER_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#else
+#define OBJ_LOADER_TRACE_SCOPE(name) do {} while (0)
+#endif
+
+#endif //MODEL_LOAD_TRACE_H
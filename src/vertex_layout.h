@@ -0,0 +1,207 @@
+#ifndef MODEL_LOAD_VERTEX_LAYOUT_H
+#define MODEL_LOAD_VERTEX_LAYOUT_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include "common.h"
+
+namespace obj_loader {
+  enum class VertexAttribute {
+    POSITION,
+    NORMAL,
+    TEXCOORD,
+    TANGENT,
+  };
+
+  enum class ComponentType {
+    FLOAT32,
+    FLOAT16,
+    SNORM16,
+    UNORM16,
+    SNORM8,
+    UNORM8,
+  };
+
+  // layouts with a dedicated emitter; anything else is CUSTOM and goes through the per element loop
+  enum class VertexFormat {
+    CUSTOM,
+    P3F_N3F_T2F, // float3 position, float3 normal, float2 uv: 32 bytes
+    P3F_T2F_N3F, // float3 position, float2 uv, float3 normal: 32 bytes
+    P3F_N4B_T2H, // float3 position, snorm8x4 normal, half2 uv: 20 bytes
+    P3F,         // float3 position only, for depth passes: 12 bytes
+  };
+
+  struct VertexElement {
+    VertexAttribute attribute;
+    ComponentType type;
+    unsigned int components;
+    unsigned int offset;
+  };
+
+  inline unsigned int componentSize(ComponentType type) {
+    switch (type) {
+      case ComponentType::FLOAT32: return 4;
+      case ComponentType::FLOAT16: case ComponentType::SNORM16: case ComponentType::UNORM16: return 2;
+      default: return 1;
+    }
+  }
+
+  struct VertexLayout {
+    VertexLayout() : format(VertexFormat::CUSTOM), elements(), stride(0) {}
+
+    static VertexLayout make(VertexFormat format) {
+      VertexLayout layout;
+      switch (format) {
+        case VertexFormat::P3F_N3F_T2F:
+          layout.add(VertexAttribute::POSITION, ComponentType::FLOAT32, 3).add(VertexAttribute::NORMAL, ComponentType::FLOAT32, 3)
+                .add(VertexAttribute::TEXCOORD, ComponentType::FLOAT32, 2);
+          break;
+        case VertexFormat::P3F_T2F_N3F:
+          layout.add(VertexAttribute::POSITION, ComponentType::FLOAT32, 3).add(VertexAttribute::TEXCOORD, ComponentType::FLOAT32, 2)
+                .add(VertexAttribute::NORMAL, ComponentType::FLOAT32, 3);
+          break;
+        case VertexFormat::P3F_N4B_T2H:
+          layout.add(VertexAttribute::POSITION, ComponentType::FLOAT32, 3).add(VertexAttribute::NORMAL, ComponentType::SNORM8, 4)
+                .add(VertexAttribute::TEXCOORD, ComponentType::FLOAT16, 2);
+          break;
+        case VertexFormat::P3F:
+          layout.add(VertexAttribute::POSITION, ComponentType::FLOAT32, 3);
+          break;
+        default:
+          break;
+      }
+      layout.format = format;
+      return layout;
+    }
+
+    // packs the element right after the previous one. a layout built this way is CUSTOM,
+    // set elements/offsets/stride by hand for padding or a different order in memory.
+    VertexLayout& add(VertexAttribute attribute, ComponentType type, unsigned int components) {
+      VertexElement element = {attribute, type, components, stride};
+      elements.push_back(element);
+      stride += componentSize(type) * components;
+      format = VertexFormat::CUSTOM;
+      return *this;
+    }
+
+    VertexFormat format;
+    std::vector<VertexElement> elements;
+    unsigned int stride;
+  };
+
+  // vertices of a whole scene in one caller owned layout, meshes refer to ranges of it
+  struct VertexBuffer {
+    VertexBuffer() : layout(), data() {}
+    explicit VertexBuffer(const VertexLayout& layout) : layout(layout), data() {}
+    size_t vertex_count() const { return layout.stride ? data.size() / layout.stride : 0; }
+    VertexLayout layout;
+    std::vector<unsigned char> data;
+  };
+
+  inline uint16_t toHalf(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    int exponent = static_cast<int>((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = x & 0x7fffff;
+    if (exponent <= 0) {
+      return static_cast<uint16_t>(sign); // flush denormals to zero
+    }
+    if (exponent >= 31) {
+      return static_cast<uint16_t>(sign | 0x7c00 | (((x >> 23) & 0xff) == 0xff && mantissa ? 0x200 : 0));
+    }
+    // round to nearest even on the dropped bits, a carry may bump the exponent which is still correct
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+    return static_cast<uint16_t>(half);
+  }
+
+  inline int8_t toSnorm8(float f) {
+    f = f < -1.f ? -1.f : (f > 1.f ? 1.f : f);
+    return static_cast<int8_t>(std::lround(f * 127.f));
+  }
+
+  inline int16_t toSnorm16(float f) {
+    f = f < -1.f ? -1.f : (f > 1.f ? 1.f : f);
+    return static_cast<int16_t>(std::lround(f * 32767.f));
+  }
+
+  inline uint8_t toUnorm8(float f) {
+    f = f < 0.f ? 0.f : (f > 1.f ? 1.f : f);
+    return static_cast<uint8_t>(std::lround(f * 255.f));
+  }
+
+  inline uint16_t toUnorm16(float f) {
+    f = f < 0.f ? 0.f : (f > 1.f ? 1.f : f);
+    return static_cast<uint16_t>(std::lround(f * 65535.f));
+  }
+
+  // writes one vertex in the layout. the specializations know their layout at compile time,
+  // so the emit loop of a primitive has no per attribute branches.
+  template <VertexFormat F>
+  struct VertexEmitter {
+    static void emit(const VertexLayout& layout, unsigned char* dst, const vec3& p, const vec3& n, const vec2& uv, const vec3& t) {
+      for (const VertexElement& e : layout.elements) {
+        float src[4] = {0.f, 0.f, 0.f, 0.f};
+        switch (e.attribute) {
+          case VertexAttribute::POSITION: src[0] = p.x; src[1] = p.y; src[2] = p.z; break;
+          case VertexAttribute::NORMAL: src[0] = n.x; src[1] = n.y; src[2] = n.z; break;
+          case VertexAttribute::TEXCOORD: src[0] = uv.x; src[1] = uv.y; break;
+          case VertexAttribute::TANGENT: src[0] = t.x; src[1] = t.y; src[2] = t.z; src[3] = 1.f; break;
+        }
+        unsigned char* out = dst + e.offset;
+        for (unsigned int c = 0; c < e.components && c < 4; c++) {
+          switch (e.type) {
+            case ComponentType::FLOAT32: memcpy(out + c * 4, &src[c], 4); break;
+            case ComponentType::FLOAT16: { uint16_t v = toHalf(src[c]); memcpy(out + c * 2, &v, 2); break; }
+            case ComponentType::SNORM16: { int16_t v = toSnorm16(src[c]); memcpy(out + c * 2, &v, 2); break; }
+            case ComponentType::UNORM16: { uint16_t v = toUnorm16(src[c]); memcpy(out + c * 2, &v, 2); break; }
+            case ComponentType::SNORM8: out[c] = static_cast<unsigned char>(toSnorm8(src[c])); break;
+            case ComponentType::UNORM8: out[c] = toUnorm8(src[c]); break;
+          }
+        }
+      }
+    }
+  };
+
+  template <>
+  struct VertexEmitter<VertexFormat::P3F_N3F_T2F> {
+    static void emit(const VertexLayout&, unsigned char* dst, const vec3& p, const vec3& n, const vec2& uv, const vec3&) {
+      float v[8] = {p.x, p.y, p.z, n.x, n.y, n.z, uv.x, uv.y};
+      memcpy(dst, v, sizeof(v));
+    }
+  };
+
+  template <>
+  struct VertexEmitter<VertexFormat::P3F_T2F_N3F> {
+    static void emit(const VertexLayout&, unsigned char* dst, const vec3& p, const vec3& n, const vec2& uv, const vec3&) {
+      float v[8] = {p.x, p.y, p.z, uv.x, uv.y, n.x, n.y, n.z};
+      memcpy(dst, v, sizeof(v));
+    }
+  };
+
+  template <>
+  struct VertexEmitter<VertexFormat::P3F_N4B_T2H> {
+    static void emit(const VertexLayout&, unsigned char* dst, const vec3& p, const vec3& n, const vec2& uv, const vec3&) {
+      float position[3] = {p.x, p.y, p.z};
+      int8_t normal[4] = {toSnorm8(n.x), toSnorm8(n.y), toSnorm8(n.z), 0};
+      uint16_t texcoord[2] = {toHalf(uv.x), toHalf(uv.y)};
+      memcpy(dst, position, 12);
+      memcpy(dst + 12, normal, 4);
+      memcpy(dst + 16, texcoord, 4);
+    }
+  };
+
+  template <>
+  struct VertexEmitter<VertexFormat::P3F> {
+    static void emit(const VertexLayout&, unsigned char* dst, const vec3& p, const vec3&, const vec2&, const vec3&) {
+      float position[3] = {p.x, p.y, p.z};
+      memcpy(dst, position, 12);
+    }
+  };
+}
+
+#endif //MODEL_LOAD_VERTEX_LAYOUT_H